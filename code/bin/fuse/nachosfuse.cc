@@ -0,0 +1,329 @@
+/// A FUSE client for the Nachos file system.
+///
+/// FUSE (Filesystem in Userspace) is a mechanism for integrating custom
+/// file systems from userspace in POSIX operating systems.  This program
+/// allows the user to mount Nachos' file system in a directory and then
+/// access it using all the standard tools (e.g. commands like `ls`, `cp`
+/// and `cat`, or graphical file managers).
+///
+/// The client does not run Nachos: it maps the `DISK` file, which contains
+/// the whole simulated disk, and reads and writes files and directories on
+/// it directly (cf. `DiskImage`).  Reads are copies out of the mapping, so
+/// the host page cache holds the disk, and the kernel is told to keep its
+/// own cache of file contents across opens.
+///
+/// Nachos must not be running on the same disk while it is mounted.
+/// Changes are not journaled: unmount cleanly before starting Nachos.
+///
+/// By default the disk is `DISK` in the directory where the client is
+/// executed; it is recommended to set up a symbolic link to the original in
+/// the `filesys` directory.  If you launch the client with `make mount`,
+/// the link gets created automatically.  Another disk can be given with
+/// `--disk=PATH`.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#define FUSE_USE_VERSION 26
+#include <fuse.h>
+
+#include "bin/image/disk_image.hh"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+
+static DiskImage image;
+
+/// FUSE may call from several threads; `DiskImage` wants one at a time.
+static pthread_mutex_t imageLock = PTHREAD_MUTEX_INITIALIZER;
+
+/// The disk keeps no times, so every file shows the time of the mount.
+static time_t mountTime;
+
+class ImageGuard {
+public:
+    ImageGuard() { pthread_mutex_lock(&imageLock); }
+    ~ImageGuard() { pthread_mutex_unlock(&imageLock); }
+};
+
+/// The header sector of an open file is kept as its handle.
+static int
+FileFor(const char *path, struct fuse_file_info *fi)
+{
+    if (fi != nullptr)
+        return fi->fh;
+    bool isDirectory;
+    int file = image.Resolve(path, &isDirectory);
+    if (file >= 0 && isDirectory)
+        return -EISDIR;
+    return file;
+}
+
+static int
+do_getattr(const char *path, struct stat *st)
+{
+    ImageGuard guard;
+    bool isDirectory;
+    int sector = image.Resolve(path, &isDirectory);
+    if (sector < 0)
+        return sector;
+
+    memset(st, 0, sizeof *st);
+    st->st_ino = sector;
+    st->st_uid = getuid();
+    st->st_gid = getgid();
+    st->st_atime = st->st_mtime = st->st_ctime = mountTime;
+    st->st_blksize = SECTOR_SIZE;
+    if (isDirectory) {
+        st->st_mode = S_IFDIR | 0755;
+        st->st_nlink = 2;
+    } else {
+        st->st_mode = S_IFREG | 0644;
+        st->st_nlink = 1;
+        st->st_size = image.Length(sector);
+    }
+    st->st_blocks = (blkcnt_t) image.NumDataSectors(sector) * SECTOR_SIZE
+                    / 512;
+    return 0;
+}
+
+struct ReaddirState {
+    void *buffer;
+    fuse_fill_dir_t fill;
+};
+
+static int
+FillEntry(void *arg, const char *name, unsigned sector, bool isDirectory)
+{
+    auto *state = (ReaddirState *) arg;
+    struct stat st;
+    memset(&st, 0, sizeof st);
+    st.st_ino = sector;
+    st.st_mode = isDirectory ? S_IFDIR : S_IFREG;
+    return state->fill(state->buffer, name, &st, 0);
+}
+
+static int
+do_readdir(const char *path, void *buffer, fuse_fill_dir_t fill,
+           off_t offset, struct fuse_file_info *fi)
+{
+    ImageGuard guard;
+    bool isDirectory;
+    int sector = image.Resolve(path, &isDirectory);
+    if (sector < 0)
+        return sector;
+    if (!isDirectory)
+        return -ENOTDIR;
+
+    fill(buffer, ".", nullptr, 0);
+    fill(buffer, "..", nullptr, 0);
+    ReaddirState state = { buffer, fill };
+    return image.List(sector, FillEntry, &state);
+}
+
+static int
+do_open(const char *path, struct fuse_file_info *fi)
+{
+    ImageGuard guard;
+    int file = FileFor(path, nullptr);
+    if (file < 0)
+        return file;
+    fi->fh = file;
+    fi->keep_cache = 1;
+    return 0;
+}
+
+static int
+do_create(const char *path, mode_t mode, struct fuse_file_info *fi)
+{
+    ImageGuard guard;
+    int file = image.Create(path, false);
+    if (file < 0)
+        return file;
+    fi->fh = file;
+    fi->keep_cache = 1;
+    return 0;
+}
+
+static int
+do_read(const char *path, char *buffer, size_t size, off_t offset,
+        struct fuse_file_info *fi)
+{
+    ImageGuard guard;
+    int file = FileFor(path, fi);
+    if (file < 0)
+        return file;
+    if ((unsigned long long) offset >= MAX_FILE_SIZE)
+        return 0;
+    return image.ReadAt(file, buffer, size, offset);
+}
+
+static int
+do_write(const char *path, const char *buffer, size_t size, off_t offset,
+         struct fuse_file_info *fi)
+{
+    ImageGuard guard;
+    int file = FileFor(path, fi);
+    if (file < 0)
+        return file;
+    if ((unsigned long long) offset + size > MAX_FILE_SIZE)
+        return -EFBIG;
+    return image.WriteAt(file, buffer, size, offset);
+}
+
+static int
+do_truncate(const char *path, off_t size)
+{
+    ImageGuard guard;
+    int file = FileFor(path, nullptr);
+    if (file < 0)
+        return file;
+    if ((unsigned long long) size > MAX_FILE_SIZE)
+        return -EFBIG;
+    return image.Truncate(file, size);
+}
+
+static int
+do_ftruncate(const char *path, off_t size, struct fuse_file_info *fi)
+{
+    ImageGuard guard;
+    if ((unsigned long long) size > MAX_FILE_SIZE)
+        return -EFBIG;
+    return image.Truncate(fi->fh, size);
+}
+
+static int
+do_unlink(const char *path)
+{
+    ImageGuard guard;
+    return image.Remove(path, false);
+}
+
+static int
+do_mkdir(const char *path, mode_t mode)
+{
+    ImageGuard guard;
+    int sector = image.Create(path, true);
+    return sector < 0 ? sector : 0;
+}
+
+static int
+do_rmdir(const char *path)
+{
+    ImageGuard guard;
+    return image.Remove(path, true);
+}
+
+static int
+do_rename(const char *from, const char *to)
+{
+    ImageGuard guard;
+    return image.Rename(from, to);
+}
+
+static int
+do_statfs(const char *path, struct statvfs *st)
+{
+    ImageGuard guard;
+    memset(st, 0, sizeof *st);
+    st->f_bsize = st->f_frsize = SECTOR_SIZE;
+    st->f_blocks = image.GetNumSectors();
+    st->f_bfree = st->f_bavail = image.CountFree();
+    st->f_files = image.GetNumSectors();
+    st->f_ffree = st->f_favail = image.CountFree();
+    st->f_namemax = FILE_NAME_MAX_LEN;
+    return 0;
+}
+
+static int
+do_fsync(const char *path, int dataOnly, struct fuse_file_info *fi)
+{
+    ImageGuard guard;
+    return image.Sync();
+}
+
+/// Times and permissions are not kept; accept changes and forget them, so
+/// that tools like `cp -p` and `touch` do not fail.
+static int
+do_utimens(const char *path, const struct timespec tv[2])
+{
+    return 0;
+}
+
+static int
+do_chmod(const char *path, mode_t mode)
+{
+    return 0;
+}
+
+static int
+do_chown(const char *path, uid_t uid, gid_t gid)
+{
+    return 0;
+}
+
+static void
+do_destroy(void *data)
+{
+    ImageGuard guard;
+    image.Sync();
+}
+
+struct Options {
+    const char *disk;
+};
+
+static const struct fuse_opt OPTIONS[] = {
+    { "--disk=%s", offsetof(Options, disk), 0 },
+    FUSE_OPT_END
+};
+
+int
+main(int argc, char *argv[])
+{
+    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+    Options options = { "DISK" };
+    if (fuse_opt_parse(&args, &options, OPTIONS, nullptr) == -1)
+        return 1;
+
+    int status = image.Open(options.disk);
+    if (status < 0) {
+        fprintf(stderr, "%s: cannot open a Nachos disk: %s\n",
+                options.disk, strerror(-status));
+        return 1;
+    }
+    mountTime = time(nullptr);
+
+    struct fuse_operations operations;
+    memset(&operations, 0, sizeof operations);
+    operations.getattr   = do_getattr;
+    operations.readdir   = do_readdir;
+    operations.open      = do_open;
+    operations.create    = do_create;
+    operations.read      = do_read;
+    operations.write     = do_write;
+    operations.truncate  = do_truncate;
+    operations.ftruncate = do_ftruncate;
+    operations.unlink    = do_unlink;
+    operations.mkdir     = do_mkdir;
+    operations.rmdir     = do_rmdir;
+    operations.rename    = do_rename;
+    operations.statfs    = do_statfs;
+    operations.fsync     = do_fsync;
+    operations.utimens   = do_utimens;
+    operations.chmod     = do_chmod;
+    operations.chown     = do_chown;
+    operations.destroy   = do_destroy;
+
+    status = fuse_main(args.argc, args.argv, &operations, nullptr);
+    fuse_opt_free_args(&args);
+    return status;
+}
@@ -0,0 +1,923 @@
+/// Routines to access a Nachos disk image from the host.
+///
+/// The image file is the one kept by `Disk`: a magic number followed by the
+/// sectors.  All of it is mapped, so reading a file is copying from its
+/// data sectors, and the host page cache does the caching.
+///
+/// The layout code follows `FileHeader`, `Directory` and `Journal`, which
+/// cannot be used here as they read the disk through the simulated machine.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "disk_image.hh"
+#include "filesys/file_system.hh"
+#include "filesys/raw_journal.hh"
+#include "lib/bitmap.hh"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+/// Same as in `machine/disk.cc`.
+static const unsigned DISK_MAGIC = 0x456789AB;
+static const unsigned DISK_MAGIC_SIZE = sizeof (int);
+
+/// Same as in `filesys/file_header.cc` and `filesys/file_system.cc`.
+static const unsigned EXTEND_BATCH_SECTORS = 4;
+static const unsigned NUM_DIR_ENTRIES = 10;
+
+static const unsigned ENTRY_SIZE = sizeof (DirectoryEntry);
+
+/// Number of index blocks needed by a file of `numSectors` data sectors.
+static unsigned
+IndexSectorsFor(unsigned numSectors)
+{
+    if (numSectors <= NUM_DIRECT)
+        return 0;
+    if (numSectors <= NUM_DIRECT + NUM_INDIRECT)
+        return 1;
+    return 2 + DivRoundUp(numSectors - NUM_DIRECT - NUM_INDIRECT,
+                          NUM_INDIRECT);
+}
+
+DiskImage::DiskImage()
+{
+    fd = -1;
+    mapping = nullptr;
+    mapSize = 0;
+    super = nullptr;
+    numSectors = 0;
+    freeMap = nullptr;
+    numFree = 0;
+    nextFree = 0;
+}
+
+DiskImage::~DiskImage()
+{
+    if (mapping != nullptr) {
+        msync(mapping, mapSize, MS_SYNC);
+        munmap(mapping, mapSize);
+    }
+    if (fd != -1)
+        close(fd);
+    delete [] freeMap;
+}
+
+/// Map `mapSize` bytes of the image file.
+int
+DiskImage::Map()
+{
+    void *p = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                   fd, 0);
+    if (p == MAP_FAILED)
+        return -errno;
+    mapping = (char *) p;
+    return 0;
+}
+
+/// * `path` is the image file, usually called `DISK`.
+int
+DiskImage::Open(const char *path)
+{
+    ASSERT(path != nullptr);
+    ASSERT(mapping == nullptr);
+
+    fd = open(path, O_RDWR);
+    if (fd == -1)
+        return -errno;
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+        return -errno;
+    if ((unsigned long) st.st_size < DISK_MAGIC_SIZE + SECTOR_SIZE)
+        return -EINVAL;
+    mapSize = st.st_size;
+    int status = Map();
+    if (status < 0)
+        return status;
+
+    if (*(unsigned *) mapping != DISK_MAGIC)
+        return -EINVAL;
+    super = (const RawSuperBlock *) SectorData(SUPER_BLOCK_SECTOR);
+    if (super->magic != SUPER_BLOCK_MAGIC
+          || super->sectorSize != SECTOR_SIZE
+          || super->sectorsPerTrack != SECTORS_PER_TRACK
+          || DISK_MAGIC_SIZE + (unsigned long) super->numSectors * SECTOR_SIZE
+               > mapSize
+          || super->freeMapSize
+               != DivRoundUp(super->numSectors, BITS_IN_WORD)
+                  * sizeof (unsigned)
+          || super->journalSector + super->journalSize > super->numSectors)
+        return -EINVAL;
+    numSectors = super->numSectors;
+
+    ReplayJournal();
+    if (Length(FREE_MAP_SECTOR) != super->freeMapSize)
+        return -EINVAL;
+    freeMap = new unsigned [super->freeMapSize / sizeof (unsigned)];
+    ReadAt(FREE_MAP_SECTOR, (char *) freeMap, super->freeMapSize, 0);
+    for (unsigned s = 0; s < numSectors; s++)
+        if (IsFree(s))
+            numFree++;
+    return 0;
+}
+
+/// The layout is the one `FileSystem::FileSystem` leaves when formatting,
+/// described by the superblock as in `SuperBlock::Describe`.
+///
+/// * `path` is the image file to create.
+/// * `count` is the number of sectors of the new disk.
+int
+DiskImage::Format(const char *path, unsigned count)
+{
+    ASSERT(path != nullptr);
+    ASSERT(mapping == nullptr);
+
+    unsigned freeMapSize = DivRoundUp(count, BITS_IN_WORD)
+                           * sizeof (unsigned);
+    if (count <= JOURNAL_SIZE + DIRECTORY_SECTOR
+          || freeMapSize > MAX_FILE_SIZE)
+        return -EINVAL;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1)
+        return -errno;
+    mapSize = DISK_MAGIC_SIZE + (unsigned long) count * SECTOR_SIZE;
+    if (ftruncate(fd, mapSize) == -1)
+        return -errno;
+    int status = Map();
+    if (status < 0)
+        return status;
+
+    *(unsigned *) mapping = DISK_MAGIC;
+    auto *raw = (RawSuperBlock *) SectorData(SUPER_BLOCK_SECTOR);
+    raw->magic = SUPER_BLOCK_MAGIC;
+    raw->sectorSize = SECTOR_SIZE;
+    raw->sectorsPerTrack = SECTORS_PER_TRACK;
+    raw->numSectors = count;
+    raw->freeMapSize = freeMapSize;
+    raw->journalSector = count - JOURNAL_SIZE;
+    raw->journalSize = JOURNAL_SIZE;
+    super = raw;
+    numSectors = count;
+
+    freeMap = new unsigned [freeMapSize / sizeof (unsigned)];
+    memset(freeMap, 0, freeMapSize);
+    numFree = numSectors;
+    const unsigned reserved[] = {
+        SUPER_BLOCK_SECTOR, FREE_MAP_SECTOR, DIRECTORY_SECTOR
+    };
+    for (unsigned s : reserved) {
+        SetFree(s, false);
+        numFree--;
+    }
+    for (unsigned i = 0; i < JOURNAL_SIZE; i++) {
+        SetFree(super->journalSector + i, false);
+        numFree--;
+    }
+
+    auto *journalHeader
+      = (RawJournalHeader *) SectorData(super->journalSector);
+    journalHeader->magic = JOURNAL_MAGIC;
+
+    // The free map file is empty until it has all its sectors, so nothing
+    // is written through to it before that.
+    RawFileHeader *mapHeader = Header(FREE_MAP_SECTOR);
+    bool allocated = Grow(mapHeader, DivRoundUp(freeMapSize, SECTOR_SIZE));
+    ASSERT(allocated);
+    mapHeader->numBytes = freeMapSize;
+    status = MakeDirectory(DIRECTORY_SECTOR, DIRECTORY_SECTOR);
+    ASSERT(status == 0);
+    WriteAt(FREE_MAP_SECTOR, (char *) freeMap, freeMapSize, 0);
+    return 0;
+}
+
+int
+DiskImage::Sync()
+{
+    ASSERT(mapping != nullptr);
+
+    return msync(mapping, mapSize, MS_SYNC) == -1 ? -errno : 0;
+}
+
+unsigned
+DiskImage::GetNumSectors() const
+{
+    return numSectors;
+}
+
+unsigned
+DiskImage::CountFree() const
+{
+    return numFree;
+}
+
+char *
+DiskImage::SectorData(unsigned sector) const
+{
+    ASSERT(sector < numSectors || super == nullptr);
+
+    return mapping + DISK_MAGIC_SIZE + (unsigned long) sector * SECTOR_SIZE;
+}
+
+RawFileHeader *
+DiskImage::Header(unsigned sector) const
+{
+    return (RawFileHeader *) SectorData(sector);
+}
+
+/// Where the number of the `i`-th data sector of `h` is kept: in the header
+/// itself, in the indirect block, or in a second level block.
+unsigned *
+DiskImage::DataSectorSlot(const RawFileHeader *h, unsigned i) const
+{
+    ASSERT(h != nullptr);
+    ASSERT(i < MAX_FILE_SECTORS);
+
+    if (i < NUM_DIRECT)
+        return (unsigned *) &h->dataSectors[i];
+    i -= NUM_DIRECT;
+    if (i < NUM_INDIRECT) {
+        auto *b = (RawIndirectBlock *) SectorData(h->indirectSector);
+        return &b->dataSectors[i];
+    }
+    i -= NUM_INDIRECT;
+    auto *d = (RawIndirectBlock *) SectorData(h->doubleIndirectSector);
+    auto *b = (RawIndirectBlock *) SectorData(
+        d->dataSectors[i / NUM_INDIRECT]);
+    return &b->dataSectors[i % NUM_INDIRECT];
+}
+
+/// The free map is kept in memory, as the words of a `Bitmap`, with a set
+/// bit for every sector in use.
+bool
+DiskImage::IsFree(unsigned sector) const
+{
+    ASSERT(sector < numSectors);
+
+    return !(freeMap[sector / BITS_IN_WORD] & 1u << sector % BITS_IN_WORD);
+}
+
+/// Every change is written through to the free map file, once the file is
+/// there; formatting writes it whole when done.
+void
+DiskImage::SetFree(unsigned sector, bool free)
+{
+    ASSERT(sector < numSectors);
+
+    unsigned w = sector / BITS_IN_WORD;
+    if (free)
+        freeMap[w] &= ~(1u << sector % BITS_IN_WORD);
+    else
+        freeMap[w] |= 1u << sector % BITS_IN_WORD;
+    unsigned offset = w * sizeof (unsigned);
+    if (offset < Length(FREE_MAP_SECTOR))
+        WriteAt(FREE_MAP_SECTOR, (char *) &freeMap[w], sizeof (unsigned),
+                offset);
+}
+
+/// Take a free sector and zero it, so that index blocks start out empty
+/// and nothing left over from a removed file shows through.  Return -1 if
+/// the disk is full.
+int
+DiskImage::Allocate()
+{
+    if (numFree == 0)
+        return -1;
+    for (unsigned n = 0; n < numSectors; n++) {
+        unsigned s = (nextFree + n) % numSectors;
+        if (!IsFree(s))
+            continue;
+        SetFree(s, false);
+        numFree--;
+        nextFree = s + 1;
+        memset(SectorData(s), 0, SECTOR_SIZE);
+        return s;
+    }
+    ASSERT(false);  // `numFree` is wrong.
+    return -1;
+}
+
+void
+DiskImage::Release(unsigned sector)
+{
+    ASSERT(!IsFree(sector));
+
+    SetFree(sector, true);
+    numFree++;
+}
+
+/// Same as `FileHeader::Grow`: allocate data sectors, and the index blocks
+/// they need, until `h` has `count` of them.  Return false, allocating
+/// nothing, if there is not enough free space.
+bool
+DiskImage::Grow(RawFileHeader *h, unsigned count)
+{
+    ASSERT(h != nullptr);
+    ASSERT(count >= h->numSectors);
+
+    if (count > MAX_FILE_SECTORS)
+        return false;
+    unsigned newIndex = IndexSectorsFor(count)
+                        - IndexSectorsFor(h->numSectors);
+    if (numFree < count - h->numSectors + newIndex)
+        return false;
+
+    for (unsigned i = h->numSectors; i < count; i++) {
+        if (i == NUM_DIRECT)
+            h->indirectSector = Allocate();
+        else if (i >= NUM_DIRECT + NUM_INDIRECT) {
+            unsigned j = i - NUM_DIRECT - NUM_INDIRECT;
+            if (j == 0)
+                h->doubleIndirectSector = Allocate();
+            if (j % NUM_INDIRECT == 0) {
+                auto *d = (RawIndirectBlock *)
+                    SectorData(h->doubleIndirectSector);
+                d->dataSectors[j / NUM_INDIRECT] = Allocate();
+            }
+        }
+        *DataSectorSlot(h, i) = Allocate();
+    }
+    h->numSectors = count;
+    return true;
+}
+
+/// The reverse of `Grow`: free data sectors from the end, and every index
+/// block left empty, until `h` has `count` of them.
+void
+DiskImage::Shrink(RawFileHeader *h, unsigned count)
+{
+    ASSERT(h != nullptr);
+    ASSERT(count <= h->numSectors);
+
+    for (unsigned i = h->numSectors; i-- > count; ) {
+        Release(*DataSectorSlot(h, i));
+        if (i == NUM_DIRECT)
+            Release(h->indirectSector);
+        else if (i >= NUM_DIRECT + NUM_INDIRECT) {
+            unsigned j = i - NUM_DIRECT - NUM_INDIRECT;
+            if (j % NUM_INDIRECT == 0) {
+                auto *d = (RawIndirectBlock *)
+                    SectorData(h->doubleIndirectSector);
+                Release(d->dataSectors[j / NUM_INDIRECT]);
+            }
+            if (j == 0)
+                Release(h->doubleIndirectSector);
+        }
+    }
+    h->numSectors = count;
+    if (count <= NUM_DIRECT)
+        h->indirectSector = 0;
+    if (count <= NUM_DIRECT + NUM_INDIRECT)
+        h->doubleIndirectSector = 0;
+}
+
+/// Make sure `h` has sectors for `size` bytes, reserving a few more the way
+/// `FileHeader::Extend` does.
+int
+DiskImage::Reserve(RawFileHeader *h, unsigned size)
+{
+    ASSERT(h != nullptr);
+
+    unsigned needed = DivRoundUp(size, SECTOR_SIZE);
+    if (needed <= h->numSectors)
+        return 0;
+    if (needed > MAX_FILE_SECTORS)
+        return -EFBIG;
+    unsigned batch = h->numSectors + EXTEND_BATCH_SECTORS;
+    if (batch < needed)
+        batch = needed;
+    if (batch > MAX_FILE_SECTORS)
+        batch = MAX_FILE_SECTORS;
+    if (!Grow(h, batch) && !Grow(h, needed))
+        return -ENOSPC;
+    return 0;
+}
+
+/// Unlike growing by writing, no extra sectors are reserved: a file
+/// written whole right after gets its sectors in a row and no slack.
+///
+/// * `file` is the header sector of the file.
+/// * `size` is the number of bytes to make room for.
+int
+DiskImage::Preallocate(unsigned file, unsigned size)
+{
+    RawFileHeader *h = Header(file);
+    unsigned needed = DivRoundUp(size, SECTOR_SIZE);
+    if (needed > MAX_FILE_SECTORS)
+        return -EFBIG;
+    if (needed <= h->numSectors)
+        return 0;
+    return Grow(h, needed) ? 0 : -ENOSPC;
+}
+
+/// Same as `Journal::Replay`.  The logged sectors are contiguous in the
+/// mapping, so the checksum can be taken in place.
+void
+DiskImage::ReplayJournal()
+{
+    auto *header = (RawJournalHeader *) SectorData(super->journalSector);
+    if (header->magic != JOURNAL_MAGIC || header->numSectors == 0
+          || header->numSectors > JOURNAL_CAPACITY)
+        return;
+
+    auto *map = (const RawJournalMap *) SectorData(super->journalSector + 1);
+    const char *logged = SectorData(super->journalSector + 1
+                                    + JOURNAL_MAP_SECTORS);
+    unsigned sum = header->sequence;
+    for (unsigned i = 0; i < header->numSectors; i++)
+        sum = (sum << 1 | sum >> 31) ^ map->homes[i];
+    const unsigned *words = (const unsigned *) logged;
+    unsigned numWords = header->numSectors * SECTOR_SIZE / sizeof (unsigned);
+    for (unsigned i = 0; i < numWords; i++)
+        sum = (sum << 1 | sum >> 31) ^ words[i];
+    if (sum != header->checksum)
+        return;
+
+    for (unsigned i = 0; i < header->numSectors; i++) {
+        ASSERT(map->homes[i] < super->journalSector);
+        memcpy(SectorData(map->homes[i]), logged + i * SECTOR_SIZE,
+               SECTOR_SIZE);
+    }
+    header->numSectors = 0;
+    header->checksum = 0;
+}
+
+unsigned
+DiskImage::Length(unsigned file) const
+{
+    return Header(file)->numBytes;
+}
+
+unsigned
+DiskImage::NumDataSectors(unsigned file) const
+{
+    return Header(file)->numSectors;
+}
+
+/// * `file` is the header sector of the file.
+/// * `into` is the buffer to hold the data.
+/// * `numBytes` is the number of bytes wanted.
+/// * `position` is where to start, in bytes from the beginning of the file.
+int
+DiskImage::ReadAt(unsigned file, char *into, unsigned numBytes,
+                  unsigned position) const
+{
+    ASSERT(into != nullptr);
+
+    const RawFileHeader *h = Header(file);
+    if (position >= h->numBytes)
+        return 0;
+    if (numBytes > h->numBytes - position)
+        numBytes = h->numBytes - position;
+
+    for (unsigned done = 0; done < numBytes; ) {
+        unsigned offset = (position + done) % SECTOR_SIZE;
+        unsigned chunk = SECTOR_SIZE - offset;
+        if (chunk > numBytes - done)
+            chunk = numBytes - done;
+        unsigned sector = *DataSectorSlot(h, (position + done) / SECTOR_SIZE);
+        memcpy(into + done, SectorData(sector) + offset, chunk);
+        done += chunk;
+    }
+    return numBytes;
+}
+
+/// Writing past the end fills the gap with zeros.
+///
+/// * `file` is the header sector of the file.
+/// * `from` is the data to write.
+/// * `numBytes` is the number of bytes to write.
+/// * `position` is where to start, in bytes from the beginning of the file.
+int
+DiskImage::WriteAt(unsigned file, const char *from, unsigned numBytes,
+                   unsigned position)
+{
+    ASSERT(from != nullptr);
+
+    RawFileHeader *h = Header(file);
+    if (numBytes == 0)
+        return 0;
+    if (position > MAX_FILE_SIZE || numBytes > MAX_FILE_SIZE - position)
+        return -EFBIG;
+    unsigned end = position + numBytes;
+    if (end > h->numBytes) {
+        int status = Reserve(h, end);
+        if (status < 0)
+            return status;
+        if (position > h->numBytes) {
+            status = Truncate(file, position);
+            ASSERT(status == 0);  // The sectors are there already.
+        }
+    }
+
+    for (unsigned done = 0; done < numBytes; ) {
+        unsigned offset = (position + done) % SECTOR_SIZE;
+        unsigned chunk = SECTOR_SIZE - offset;
+        if (chunk > numBytes - done)
+            chunk = numBytes - done;
+        unsigned sector = *DataSectorSlot(h, (position + done) / SECTOR_SIZE);
+        memcpy(SectorData(sector) + offset, from + done, chunk);
+        done += chunk;
+    }
+    if (end > h->numBytes)
+        h->numBytes = end;
+    return numBytes;
+}
+
+/// Sectors reserved beyond the end may hold old data, so growing zeroes
+/// the new part explicitly.
+int
+DiskImage::Truncate(unsigned file, unsigned size)
+{
+    RawFileHeader *h = Header(file);
+    if (size < h->numBytes) {
+        h->numBytes = size;
+        Shrink(h, DivRoundUp(size, SECTOR_SIZE));
+        return 0;
+    }
+    int status = Reserve(h, size);
+    if (status < 0)
+        return status;
+    while (h->numBytes < size) {
+        unsigned offset = h->numBytes % SECTOR_SIZE;
+        unsigned chunk = SECTOR_SIZE - offset;
+        if (chunk > size - h->numBytes)
+            chunk = size - h->numBytes;
+        unsigned sector = *DataSectorSlot(h, h->numBytes / SECTOR_SIZE);
+        memset(SectorData(sector) + offset, 0, chunk);
+        h->numBytes += chunk;
+    }
+    return 0;
+}
+
+/// Same as `FileSystem::Resolve`, one path component at a time, starting
+/// from the root directory.
+///
+/// * `path` is the absolute path to look up.
+/// * `isDirectory`, if not null, is set to whether it names a directory.
+int
+DiskImage::Resolve(const char *path, bool *isDirectory) const
+{
+    ASSERT(path != nullptr);
+
+    unsigned sector = DIRECTORY_SECTOR;
+    bool directory = true;
+    while (*path != '\0') {
+        while (*path == '/')
+            path++;
+        unsigned length = strcspn(path, "/");
+        if (length == 0)
+            break;
+        if (length > FILE_NAME_MAX_LEN)
+            return -ENAMETOOLONG;
+        if (!directory)
+            return -ENOTDIR;
+        if (length == 1 && path[0] == '.') {
+            path += length;
+            continue;
+        }
+
+        char name[FILE_NAME_MAX_LEN + 1];
+        memcpy(name, path, length);
+        name[length] = '\0';
+        Table table;
+        FetchTable(sector, &table);
+        int i = FindIn(&table, name);
+        if (i != -1) {
+            sector = table.entries[i].sector;
+            directory = table.entries[i].isDirectory;
+        }
+        delete [] table.entries;
+        if (i == -1)
+            return -ENOENT;
+        path += length;
+    }
+    if (isDirectory != nullptr)
+        *isDirectory = directory;
+    return sector;
+}
+
+/// Return the directory that would hold `path`, and copy its last component
+/// into `name`.
+int
+DiskImage::FindParent(const char *path, char *name) const
+{
+    ASSERT(path != nullptr);
+    ASSERT(name != nullptr);
+
+    unsigned end = strlen(path);
+    while (end > 0 && path[end - 1] == '/')
+        end--;
+    unsigned start = end;
+    while (start > 0 && path[start - 1] != '/')
+        start--;
+    unsigned length = end - start;
+    if (length == 0
+          || (length == 1 && path[start] == '.')
+          || (length == 2 && !strncmp(path + start, "..", 2)))
+        return -EINVAL;
+    if (length > FILE_NAME_MAX_LEN || start > PATH_NAME_MAX_LEN)
+        return -ENAMETOOLONG;
+    memcpy(name, path + start, length);
+    name[length] = '\0';
+
+    char parent[PATH_NAME_MAX_LEN + 2];
+    memcpy(parent, path, start);
+    parent[start] = '\0';
+    bool isDirectory;
+    int sector = Resolve(parent, &isDirectory);
+    if (sector >= 0 && !isDirectory)
+        return -ENOTDIR;
+    return sector;
+}
+
+/// The caller must delete `table->entries`.
+void
+DiskImage::FetchTable(unsigned directory, Table *table) const
+{
+    ASSERT(table != nullptr);
+
+    table->size = Length(directory) / ENTRY_SIZE;
+    ASSERT(table->size > 0);
+    table->entries = new DirectoryEntry [table->size];
+    ReadAt(directory, (char *) table->entries, table->size * ENTRY_SIZE, 0);
+    table->numEntries = 0;
+    for (unsigned i = 0; i < table->size; i++)
+        if (table->entries[i].inUse)
+            table->numEntries++;
+}
+
+/// Same as `Directory::FindIndex`.
+int
+DiskImage::FindIn(const Table *table, const char *name) const
+{
+    unsigned i = HashFileName(name) % table->size;
+    for (unsigned n = 0; n < table->size && table->entries[i].inUse; n++) {
+        if (!strncmp(table->entries[i].name, name, FILE_NAME_MAX_LEN))
+            return i;
+        i = (i + 1) % table->size;
+    }
+    return -1;
+}
+
+/// Same as `Directory::Add`, doubling the table when it gets three quarters
+/// full, up to `MAX_DIR_ENTRIES`, followed by `Directory::WriteBack`.  On
+/// failure, the directory is left as it was on disk.
+int
+DiskImage::AddTo(unsigned directory, Table *table, const char *name,
+                 unsigned sector, bool isDirectory)
+{
+    ASSERT(table != nullptr);
+    ASSERT(name != nullptr);
+
+    if (4 * (table->numEntries + 1) > 3 * table->size) {
+        if (2 * table->size > MAX_DIR_ENTRIES)
+            return -ENOSPC;
+        DirectoryEntry *old = table->entries;
+        unsigned oldSize = table->size;
+        table->size *= 2;
+        table->entries = new DirectoryEntry [table->size];
+        memset(table->entries, 0, table->size * ENTRY_SIZE);
+        for (unsigned i = 0; i < oldSize; i++) {
+            if (!old[i].inUse)
+                continue;
+            unsigned j = HashFileName(old[i].name) % table->size;
+            while (table->entries[j].inUse)
+                j = (j + 1) % table->size;
+            table->entries[j] = old[i];
+        }
+        delete [] old;
+    }
+
+    unsigned i = HashFileName(name) % table->size;
+    while (table->entries[i].inUse)
+        i = (i + 1) % table->size;
+    DirectoryEntry *e = &table->entries[i];
+    memset(e, 0, ENTRY_SIZE);
+    e->inUse = true;
+    e->isDirectory = isDirectory;
+    e->sector = sector;
+    strncpy(e->name, name, FILE_NAME_MAX_LEN);
+    table->numEntries++;
+
+    int status = WriteAt(directory, (char *) table->entries,
+                         table->size * ENTRY_SIZE, 0);
+    return status < 0 ? status : 0;
+}
+
+/// Same as `Directory::Remove`: entries after the removed one are moved
+/// back when they would become unreachable.
+void
+DiskImage::RemoveFrom(unsigned directory, Table *table, unsigned i)
+{
+    ASSERT(table != nullptr);
+    ASSERT(i < table->size);
+
+    unsigned size = table->size;
+    DirectoryEntry *entries = table->entries;
+    unsigned hole = i;
+    for (unsigned j = (hole + 1) % size; entries[j].inUse;
+         j = (j + 1) % size) {
+        unsigned home = HashFileName(entries[j].name) % size;
+        bool reachable = hole < j ? hole < home && home <= j
+                                  : hole < home || home <= j;
+        if (!reachable) {
+            entries[hole] = entries[j];
+            hole = j;
+        }
+    }
+    entries[hole].inUse = false;
+    table->numEntries--;
+    int status = WriteAt(directory, (char *) entries, size * ENTRY_SIZE, 0);
+    ASSERT(status >= 0);  // The directory does not grow.
+}
+
+/// Is `directory` the same as `descendant`, or above it?
+bool
+DiskImage::IsAncestor(unsigned directory, unsigned descendant) const
+{
+    for (unsigned n = 0; n < numSectors; n++) {
+        if (descendant == directory)
+            return true;
+        if (descendant == DIRECTORY_SECTOR)
+            return false;
+        Table table;
+        FetchTable(descendant, &table);
+        int i = FindIn(&table, PARENT_DIRECTORY_NAME);
+        ASSERT(i != -1);
+        descendant = table.entries[i].sector;
+        delete [] table.entries;
+    }
+    return false;
+}
+
+/// Write an empty directory, holding just the parent entry, into the file
+/// with header at `sector`.  The table has the size of those created by
+/// Nachos.
+int
+DiskImage::MakeDirectory(unsigned sector, unsigned parent)
+{
+    Table contents;
+    contents.size = NUM_DIR_ENTRIES;
+    contents.numEntries = 0;
+    contents.entries = new DirectoryEntry [contents.size];
+    memset(contents.entries, 0, contents.size * ENTRY_SIZE);
+    int status = AddTo(sector, &contents, PARENT_DIRECTORY_NAME, parent,
+                       true);
+    delete [] contents.entries;
+    return status;
+}
+
+/// Files start empty; directories, with just the parent entry.
+int
+DiskImage::Create(const char *path, bool isDirectory)
+{
+    char name[FILE_NAME_MAX_LEN + 1];
+    int parent = FindParent(path, name);
+    if (parent < 0)
+        return parent;
+
+    Table table;
+    FetchTable(parent, &table);
+    int status = 0;
+    int sector = -1;
+    if (FindIn(&table, name) != -1)
+        status = -EEXIST;
+    else if ((sector = Allocate()) == -1)
+        status = -ENOSPC;
+    else if (isDirectory)
+        status = MakeDirectory(sector, parent);
+    if (status == 0)
+        status = AddTo(parent, &table, name, sector, isDirectory);
+    if (status < 0 && sector != -1) {
+        Shrink(Header(sector), 0);
+        Release(sector);
+    }
+    delete [] table.entries;
+    return status < 0 ? status : sector;
+}
+
+int
+DiskImage::Remove(const char *path, bool isDirectory)
+{
+    char name[FILE_NAME_MAX_LEN + 1];
+    int parent = FindParent(path, name);
+    if (parent < 0)
+        return parent;
+
+    Table table;
+    FetchTable(parent, &table);
+    int status = 0;
+    int i = FindIn(&table, name);
+    if (i == -1)
+        status = -ENOENT;
+    else if (table.entries[i].isDirectory != isDirectory)
+        status = isDirectory ? -ENOTDIR : -EISDIR;
+    else if (isDirectory) {
+        Table contents;
+        FetchTable(table.entries[i].sector, &contents);
+        if (contents.numEntries > 1)
+            status = -ENOTEMPTY;
+        delete [] contents.entries;
+    }
+    if (status == 0) {
+        unsigned sector = table.entries[i].sector;
+        RemoveFrom(parent, &table, i);
+        Shrink(Header(sector), 0);
+        Release(sector);
+    }
+    delete [] table.entries;
+    return status;
+}
+
+/// The new entry is added before the old one is removed, so running out of
+/// space leaves `from` in place; a file replaced at `to` is gone by then.
+int
+DiskImage::Rename(const char *from, const char *to)
+{
+    char fromName[FILE_NAME_MAX_LEN + 1];
+    char toName[FILE_NAME_MAX_LEN + 1];
+    int fromParent = FindParent(from, fromName);
+    if (fromParent < 0)
+        return fromParent;
+    int toParent = FindParent(to, toName);
+    if (toParent < 0)
+        return toParent;
+
+    Table table;
+    FetchTable(fromParent, &table);
+    int i = FindIn(&table, fromName);
+    DirectoryEntry moved;
+    if (i != -1)
+        moved = table.entries[i];
+    delete [] table.entries;
+    if (i == -1)
+        return -ENOENT;
+    if (moved.isDirectory && IsAncestor(moved.sector, toParent))
+        return -EINVAL;
+
+    bool isDirectory;
+    int target = Resolve(to, &isDirectory);
+    if (target == (int) moved.sector)
+        return 0;
+    if (target >= 0) {
+        if (isDirectory && !moved.isDirectory)
+            return -EISDIR;
+        if (!isDirectory && moved.isDirectory)
+            return -ENOTDIR;
+        int status = Remove(to, isDirectory);
+        if (status < 0)
+            return status;
+    }
+
+    FetchTable(toParent, &table);
+    int status = AddTo(toParent, &table, toName, moved.sector,
+                       moved.isDirectory);
+    delete [] table.entries;
+    if (status < 0)
+        return status;
+
+    FetchTable(fromParent, &table);
+    i = FindIn(&table, fromName);
+    ASSERT(i != -1);
+    RemoveFrom(fromParent, &table, i);
+    delete [] table.entries;
+
+    if (moved.isDirectory && fromParent != toParent) {
+        FetchTable(moved.sector, &table);
+        i = FindIn(&table, PARENT_DIRECTORY_NAME);
+        ASSERT(i != -1);
+        table.entries[i].sector = toParent;
+        WriteAt(moved.sector, (char *) table.entries,
+                table.size * ENTRY_SIZE, 0);
+        delete [] table.entries;
+    }
+    return 0;
+}
+
+/// * `directory` is the header sector of the directory.
+/// * `fill` is called with `arg` and each entry.
+int
+DiskImage::List(unsigned directory, Filler fill, void *arg) const
+{
+    ASSERT(fill != nullptr);
+
+    Table table;
+    FetchTable(directory, &table);
+    for (unsigned i = 0; i < table.size; i++) {
+        const DirectoryEntry *e = &table.entries[i];
+        if (!e->inUse || !strcmp(e->name, PARENT_DIRECTORY_NAME))
+            continue;
+        if (fill(arg, e->name, e->sector, e->isDirectory) != 0)
+            break;
+    }
+    delete [] table.entries;
+    return 0;
+}
@@ -0,0 +1,159 @@
+/// Access to a Nachos disk image from the host.
+///
+/// Host tools use this instead of running Nachos: the image is mapped into
+/// memory, and files and directories are read and written in place,
+/// following the same on-disk layout as the kernel (cf. `filesys`).
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_BIN_IMAGE_DISKIMAGE__HH
+#define NACHOS_BIN_IMAGE_DISKIMAGE__HH
+
+
+#include "filesys/directory_entry.hh"
+#include "filesys/raw_file_header.hh"
+#include "filesys/raw_super_block.hh"
+
+
+/// An open disk image.
+///
+/// Operations return 0 or a positive result on success, and a negated
+/// `errno` value on failure, the way FUSE expects.  Files are named by the
+/// sector of their header, as returned by `Resolve`.
+///
+/// Changes go straight to their place on the image, without the journal;
+/// a committed journal group left behind by Nachos is replayed when the
+/// image is opened.  Nachos must not be running on the same image at the
+/// same time.
+///
+/// There is no locking: callers from several threads must serialize.
+class DiskImage {
+public:
+
+    DiskImage();
+
+    /// Unmap the image, writing it back first.
+    ~DiskImage();
+
+    /// Map the image at `path`, which must hold a formatted file system.
+    int Open(const char *path);
+
+    /// Create an image at `path` with `numSectors` sectors, replacing any
+    /// file there, and format it.
+    int Format(const char *path, unsigned numSectors);
+
+    /// Write every change back to the image file.
+    int Sync();
+
+    unsigned GetNumSectors() const;
+
+    /// Number of sectors still free.
+    unsigned CountFree() const;
+
+    /// Return the header sector of the file or directory at `path`, an
+    /// absolute path, and set `isDirectory` accordingly.
+    int Resolve(const char *path, bool *isDirectory) const;
+
+    /// Length in bytes of the file with header at `file`.
+    unsigned Length(unsigned file) const;
+
+    /// Number of data sectors, including those reserved beyond the end.
+    unsigned NumDataSectors(unsigned file) const;
+
+    /// Copy up to `numBytes` bytes from `position` of `file` into `into`.
+    /// Return the number of bytes read.
+    int ReadAt(unsigned file, char *into, unsigned numBytes,
+               unsigned position) const;
+
+    /// Write `numBytes` bytes from `from` at `position` of `file`, growing
+    /// it if needed.  Return the number of bytes written.
+    int WriteAt(unsigned file, const char *from, unsigned numBytes,
+                unsigned position);
+
+    /// Give `file` exactly the sectors needed to hold `size` bytes.
+    int Preallocate(unsigned file, unsigned size);
+
+    /// Set the length of `file` to `size`, freeing or zeroing the sectors
+    /// past or up to the new end.
+    int Truncate(unsigned file, unsigned size);
+
+    /// Create an empty file or directory at `path`.  Return its sector.
+    int Create(const char *path, bool isDirectory);
+
+    /// Remove the file, or the empty directory, at `path`.
+    int Remove(const char *path, bool isDirectory);
+
+    /// Move `from` to `to`, replacing `to` if it is a file.
+    int Rename(const char *from, const char *to);
+
+    /// Called by `List` for every entry; a non-zero result stops it.
+    typedef int (*Filler)(void *arg, const char *name, unsigned sector,
+                          bool isDirectory);
+
+    /// Call `fill` for every entry of the directory with header at
+    /// `directory`, except for the parent.
+    int List(unsigned directory, Filler fill, void *arg) const;
+
+private:
+    int Map();
+
+    char *SectorData(unsigned sector) const;
+
+    RawFileHeader *Header(unsigned sector) const;
+
+    unsigned *DataSectorSlot(const RawFileHeader *h, unsigned i) const;
+
+    bool IsFree(unsigned sector) const;
+
+    void SetFree(unsigned sector, bool free);
+
+    int Allocate();
+
+    void Release(unsigned sector);
+
+    bool Grow(RawFileHeader *h, unsigned count);
+
+    void Shrink(RawFileHeader *h, unsigned count);
+
+    int Reserve(RawFileHeader *h, unsigned size);
+
+    void ReplayJournal();
+
+    int MakeDirectory(unsigned sector, unsigned parent);
+
+    int FindParent(const char *path, char *name) const;
+
+    /// A directory read into memory, as a table of entries.
+    struct Table {
+        DirectoryEntry *entries;
+        unsigned size;
+        unsigned numEntries;
+    };
+
+    void FetchTable(unsigned directory, Table *table) const;
+
+    int FindIn(const Table *table, const char *name) const;
+
+    int AddTo(unsigned directory, Table *table, const char *name,
+              unsigned sector, bool isDirectory);
+
+    void RemoveFrom(unsigned directory, Table *table, unsigned i);
+
+    bool IsAncestor(unsigned directory, unsigned descendant) const;
+
+    int fd;
+    char *mapping;
+    unsigned long mapSize;
+
+    const RawSuperBlock *super;
+    unsigned numSectors;
+    unsigned *freeMap;  ///< Words of the free map; a set bit is a sector
+                        ///< in use.
+    unsigned numFree;
+    unsigned nextFree;  ///< Where the next search for a free sector starts.
+};
+
+
+#endif
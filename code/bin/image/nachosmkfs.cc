@@ -0,0 +1,191 @@
+/// Build a Nachos disk image from host files, without running Nachos.
+///
+/// Usage:
+///
+///     nachosmkfs [-o IMAGE] [-t TRACKS] MANIFEST
+///
+/// The image (`DISK` by default) is created anew, with `TRACKS` tracks
+/// (`NUM_TRACKS` by default), formatted, and filled with what the manifest
+/// lists.  The manifest, or the standard input if it is `-`, has one entry
+/// per line:
+///
+///     HOST_FILE  NACHOS_PATH    copy a host file into Nachos;
+///     NACHOS_PATH/              make a directory.
+///
+/// Blank lines and lines starting with `#` are skipped.  Directories on the
+/// way to a Nachos path are made as needed.
+///
+/// Everything is created first, and only then are the files filled in, in
+/// the order given, each with exactly the sectors it needs.  That way the
+/// directories do not grow in between, and every file gets a single run of
+/// sectors, only broken by its index blocks.  The result is what the file
+/// system check expects, and is ready to be used with `-dm`, or mounted
+/// with `nachosfuse`.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "disk_image.hh"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+
+/// One file to copy.
+struct Entry {
+    char *hostPath;
+    unsigned file;  ///< Header sector in the image.
+};
+
+static void
+Usage(const char *program)
+{
+    fprintf(stderr, "Usage: %s [-o IMAGE] [-t TRACKS] MANIFEST\n", program);
+    exit(2);
+}
+
+static void
+Fail(const char *what, int status)
+{
+    fprintf(stderr, "nachosmkfs: %s: %s\n", what, strerror(-status));
+    exit(1);
+}
+
+/// Make every directory on the way to `path`, leaving it alone.
+static void
+MakeParents(DiskImage *image, const char *path)
+{
+    char prefix[PATH_NAME_MAX_LEN + 1];
+    for (const char *p = strchr(path + 1, '/'); p != nullptr;
+         p = strchr(p + 1, '/')) {
+        unsigned length = p - path;
+        if (length > PATH_NAME_MAX_LEN)
+            Fail(path, -ENAMETOOLONG);
+        memcpy(prefix, path, length);
+        prefix[length] = '\0';
+        int status = image->Create(prefix, true);
+        if (status < 0 && status != -EEXIST)
+            Fail(prefix, status);
+    }
+}
+
+/// Read the whole host file at `path`.  The caller must delete the result.
+static char *
+ReadHostFile(const char *path, unsigned *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr)
+        Fail(path, -errno);
+    fseek(f, 0, SEEK_END);
+    long length = ftell(f);
+    if (length < 0)
+        Fail(path, -errno);
+    if ((unsigned long) length > MAX_FILE_SIZE)
+        Fail(path, -EFBIG);
+    fseek(f, 0, SEEK_SET);
+    char *data = new char [length + 1];
+    if (fread(data, 1, length, f) != (size_t) length)
+        Fail(path, -EIO);
+    fclose(f);
+    *size = length;
+    return data;
+}
+
+int
+main(int argc, char *argv[])
+{
+    const char *imagePath = "DISK";
+    unsigned numTracks = NUM_TRACKS;
+    int option;
+    while ((option = getopt(argc, argv, "o:t:")) != -1) {
+        if (option == 'o')
+            imagePath = optarg;
+        else if (option == 't' && atoi(optarg) > 0)
+            numTracks = atoi(optarg);
+        else
+            Usage(argv[0]);
+    }
+    if (optind != argc - 1)
+        Usage(argv[0]);
+
+    const char *manifestPath = argv[optind];
+    FILE *manifest = strcmp(manifestPath, "-") == 0
+                     ? stdin : fopen(manifestPath, "r");
+    if (manifest == nullptr)
+        Fail(manifestPath, -errno);
+
+    DiskImage image;
+    int status = image.Format(imagePath, numTracks * SECTORS_PER_TRACK);
+    if (status < 0)
+        Fail(imagePath, status);
+
+    // First pass: make the directories and empty files.
+    Entry *entries = nullptr;
+    unsigned numEntries = 0, capacity = 0;
+    char line[2 * PATH_NAME_MAX_LEN + 2];
+    for (unsigned lineNumber = 1; fgets(line, sizeof line, manifest);
+         lineNumber++) {
+        char first[PATH_NAME_MAX_LEN + 1], second[PATH_NAME_MAX_LEN + 1];
+        int fields = sscanf(line, "%255s %255s", first, second);
+        if (fields <= 0 || first[0] == '#')
+            continue;
+
+        char path[PATH_NAME_MAX_LEN + 2];
+        const char *nachosPath = fields == 1 ? first : second;
+        snprintf(path, sizeof path, "%s%s",
+                 nachosPath[0] == '/' ? "" : "/", nachosPath);
+        MakeParents(&image, path);
+        if (fields == 1) {
+            unsigned length = strlen(path);
+            if (path[length - 1] != '/') {
+                fprintf(stderr, "nachosmkfs: %s:%u: directories must end "
+                                "with `/`.\n", manifestPath, lineNumber);
+                return 1;
+            }
+            continue;  // Made along with its parents.
+        }
+
+        status = image.Create(path, false);
+        if (status < 0)
+            Fail(path, status);
+        if (numEntries == capacity) {
+            capacity = capacity == 0 ? 16 : 2 * capacity;
+            Entry *grown = new Entry [capacity];
+            if (entries != nullptr)
+                memcpy(grown, entries, numEntries * sizeof *entries);
+            delete [] entries;
+            entries = grown;
+        }
+        entries[numEntries].hostPath = strdup(first);
+        entries[numEntries].file = status;
+        numEntries++;
+    }
+    if (manifest != stdin)
+        fclose(manifest);
+
+    // Second pass: fill in the files.
+    for (unsigned i = 0; i < numEntries; i++) {
+        unsigned size;
+        char *data = ReadHostFile(entries[i].hostPath, &size);
+        status = image.Preallocate(entries[i].file, size);
+        if (status == 0)
+            status = image.WriteAt(entries[i].file, data, size, 0);
+        if (status < 0)
+            Fail(entries[i].hostPath, status);
+        delete [] data;
+        free(entries[i].hostPath);
+    }
+    delete [] entries;
+
+    status = image.Sync();
+    if (status < 0)
+        Fail(imagePath, status);
+    printf("%s: %u files, %u of %u sectors free.\n",
+           imagePath, numEntries, image.CountFree(), image.GetNumSectors());
+    return 0;
+}
@@ -9,10 +9,11 @@
 /// ReadFrom/WriteBack to fetch the contents of the directory from disk, and
 /// to write back any modifications back to disk.
 ///
-/// Also, this implementation has the restriction that the size of the
-/// directory cannot expand.  In other words, once all the entries in the
-/// directory are used, no more files can be created.  Fixing this is one of
-/// the parts to the assignment.
+/// Entries are placed by hashing the file name, and collisions are resolved
+/// by linear probing, so a lookup usually touches a single entry.  The
+/// table is kept at most three quarters full; when it gets fuller, its size
+/// is doubled and every entry is rehashed, up to `MAX_DIR_ENTRIES`.  The
+/// directory file grows along with it.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2018 Docentes de la Universidad Nacional de Rosario.
@@ -38,6 +39,9 @@ Directory::Directory(unsigned size)
     raw.tableSize = size;
     for (unsigned i = 0; i < raw.tableSize; i++)
         raw.table[i].inUse = false;
+    numEntries = 0;
+    dirtyLow = 0;
+    dirtyHigh = raw.tableSize - 1;
 }
 
 /// De-allocate directory data structure.
@@ -46,87 +50,201 @@ Directory::~Directory()
     delete [] raw.table;
 }
 
-/// Read the contents of the directory from disk.
+/// Read the contents of the directory from disk.  The table takes the size
+/// of the file.
 ///
 /// * `file` is file containing the directory contents.
 void
 Directory::FetchFrom(OpenFile *file)
 {
     ASSERT(file != nullptr);
+
+    unsigned size = file->Length() / sizeof (DirectoryEntry);
+    ASSERT(size > 0);
+    if (size != raw.tableSize) {
+        delete [] raw.table;
+        raw.table = new DirectoryEntry [size];
+        raw.tableSize = size;
+    }
     file->ReadAt((char *) raw.table,
                  raw.tableSize * sizeof (DirectoryEntry), 0);
+
+    numEntries = 0;
+    for (unsigned i = 0; i < raw.tableSize; i++)
+        if (raw.table[i].inUse)
+            numEntries++;
+    ASSERT(numEntries < raw.tableSize);
+    dirtyLow = raw.tableSize;
+    dirtyHigh = 0;
 }
 
-/// Write any modifications to the directory back to disk.
+/// Write any modifications to the directory back to disk.  Only the range
+/// of entries that changed is written.
+///
+/// If the table grew, the file has to grow too; that is tried first, by
+/// writing the last entry, so that a full disk leaves the old directory
+/// intact.  Return false in that case.
 ///
 /// * `file` is a file to contain the new directory contents.
-void
+bool
 Directory::WriteBack(OpenFile *file)
 {
     ASSERT(file != nullptr);
-    file->WriteAt((char *) raw.table,
-                  raw.tableSize * sizeof (DirectoryEntry), 0);
+
+    if (dirtyLow > dirtyHigh)
+        return true;
+
+    const unsigned entrySize = sizeof (DirectoryEntry);
+    if (file->Length() < raw.tableSize * entrySize) {
+        unsigned last = raw.tableSize - 1;
+        if (file->WriteAt((char *) &raw.table[last], entrySize,
+                          last * entrySize) != (int) entrySize)
+            return false;
+    }
+    file->WriteAt((char *) &raw.table[dirtyLow],
+                  (dirtyHigh - dirtyLow + 1) * entrySize,
+                  dirtyLow * entrySize);
+    dirtyLow = raw.tableSize;
+    dirtyHigh = 0;
+    return true;
+}
+
+void
+Directory::MarkDirty(unsigned i)
+{
+    if (i < dirtyLow)
+        dirtyLow = i;
+    if (i > dirtyHigh)
+        dirtyHigh = i;
 }
 
 /// Look up file name in directory, and return its location in the table of
 /// directory entries.  Return -1 if the name is not in the directory.
 ///
+/// Probing starts at the entry the name hashes to, and stops at the first
+/// unused one.
+///
 /// * `name` is the file name to look up.
 int
 Directory::FindIndex(const char *name)
 {
     ASSERT(name != nullptr);
 
-    for (unsigned i = 0; i < raw.tableSize; i++)
-        if (raw.table[i].inUse
-              && !strncmp(raw.table[i].name, name, FILE_NAME_MAX_LEN))
+    unsigned i = HashFileName(name) % raw.tableSize;
+    for (unsigned n = 0; n < raw.tableSize && raw.table[i].inUse; n++) {
+        if (!strncmp(raw.table[i].name, name, FILE_NAME_MAX_LEN))
             return i;
+        i = (i + 1) % raw.tableSize;
+    }
     return -1;  // name not in directory
 }
 
+/// Return the first unused entry probing from where `name` hashes to.  The
+/// table is never full, so there always is one.
+///
+/// * `name` is the file name to be placed.
+unsigned
+Directory::FreeIndexFor(const char *name) const
+{
+    ASSERT(name != nullptr);
+
+    unsigned i = HashFileName(name) % raw.tableSize;
+    while (raw.table[i].inUse)
+        i = (i + 1) % raw.tableSize;
+    return i;
+}
+
+void
+Directory::Grow()
+{
+    DirectoryEntry *oldTable = raw.table;
+    unsigned oldSize = raw.tableSize;
+
+    DEBUG('f', "Growing directory from %u to %u entries.\n",
+          oldSize, 2 * oldSize);
+    raw.tableSize = 2 * oldSize;
+    raw.table = new DirectoryEntry [raw.tableSize];
+    for (unsigned i = 0; i < raw.tableSize; i++)
+        raw.table[i].inUse = false;
+    for (unsigned i = 0; i < oldSize; i++)
+        if (oldTable[i].inUse)
+            raw.table[FreeIndexFor(oldTable[i].name)] = oldTable[i];
+    delete [] oldTable;
+
+    dirtyLow = 0;
+    dirtyHigh = raw.tableSize - 1;
+}
+
 /// Look up file name in directory, and return the disk sector number where
 /// the file's header is stored.  Return -1 if the name is not in the
 /// directory.
 ///
 /// * `name` is the file name to look up.
+/// * `isDirectory`, if not null, is set to whether the entry found is a
+///   directory.
 int
-Directory::Find(const char *name)
+Directory::Find(const char *name, bool *isDirectory)
 {
     ASSERT(name != nullptr);
 
     int i = FindIndex(name);
-    if (i != -1)
-        return raw.table[i].sector;
-    return -1;
+    if (i == -1)
+        return -1;
+    if (isDirectory != nullptr)
+        *isDirectory = raw.table[i].isDirectory;
+    return raw.table[i].sector;
+}
+
+/// Return the size the table will have once one more entry is added, or 0
+/// if it is as big as it can get and has no room for it.
+unsigned
+Directory::SizeForAdd() const
+{
+    if (4 * (numEntries + 1) <= 3 * raw.tableSize)
+        return raw.tableSize;
+    if (2 * raw.tableSize > MAX_DIR_ENTRIES)
+        return 0;
+    return 2 * raw.tableSize;
 }
 
 /// Add a file into the directory.  Return true if successful; return false
 /// if the file name is already in the directory, or if the directory is
-/// completely full, and has no more space for additional file names.
+/// full.
 ///
 /// * `name` is the name of the file being added.
 /// * `newSector` is the disk sector containing the added file's header.
+/// * `isDirectory` tells whether the file added is a directory.
 bool
-Directory::Add(const char *name, int newSector)
+Directory::Add(const char *name, int newSector, bool isDirectory)
 {
     ASSERT(name != nullptr);
 
     if (FindIndex(name) != -1)
         return false;
 
-    for (unsigned i = 0; i < raw.tableSize; i++)
-        if (!raw.table[i].inUse) {
-            raw.table[i].inUse = true;
-            strncpy(raw.table[i].name, name, FILE_NAME_MAX_LEN);
-            raw.table[i].sector = newSector;
-            return true;
-        }
-    return false;  // no space.  Fix when we have extensible files.
+    unsigned size = SizeForAdd();
+    if (size == 0)
+        return false;
+    if (size > raw.tableSize)
+        Grow();
+
+    unsigned i = FreeIndexFor(name);
+    raw.table[i].inUse = true;
+    raw.table[i].isDirectory = isDirectory;
+    strncpy(raw.table[i].name, name, FILE_NAME_MAX_LEN);
+    raw.table[i].sector = newSector;
+    numEntries++;
+    MarkDirty(i);
+    return true;
 }
 
 /// Remove a file name from the directory.   Return true if successful;
 /// return false if the file is not in the directory.
 ///
+/// Instead of leaving a mark behind, the entries following the removed one
+/// in its probe run are moved back into the gap when they would otherwise
+/// become unreachable.
+///
 /// * `name` is the file name to be removed.
 bool
 Directory::Remove(const char *name)
@@ -136,17 +254,74 @@ Directory::Remove(const char *name)
     int i = FindIndex(name);
     if (i == -1)
         return false;  // name not in directory
-    raw.table[i].inUse = false;
+
+    unsigned size = raw.tableSize;
+    unsigned hole = i;
+    for (unsigned j = (hole + 1) % size; raw.table[j].inUse;
+         j = (j + 1) % size) {
+        unsigned home = HashFileName(raw.table[j].name) % size;
+        bool reachable = hole < j ? hole < home && home <= j
+                                  : hole < home || home <= j;
+        if (!reachable) {
+            raw.table[hole] = raw.table[j];
+            MarkDirty(hole);
+            hole = j;
+        }
+    }
+    raw.table[hole].inUse = false;
+    MarkDirty(hole);
+    numEntries--;
     return true;
 }
 
-/// List all the file names in the directory.
+bool
+Directory::IsEmpty() const
+{
+    for (unsigned i = 0; i < raw.tableSize; i++)
+        if (raw.table[i].inUse
+              && strcmp(raw.table[i].name, PARENT_DIRECTORY_NAME) != 0)
+            return false;
+    return true;
+}
+
+/// List all the file names in the directory.  Directories are marked with a
+/// trailing `'/'`.
 void
 Directory::List() const
 {
     for (unsigned i = 0; i < raw.tableSize; i++)
-        if (raw.table[i].inUse)
-            printf("%s\n", raw.table[i].name);
+        if (raw.table[i].inUse
+              && strcmp(raw.table[i].name, PARENT_DIRECTORY_NAME) != 0)
+            printf("%s%s\n", raw.table[i].name,
+                   raw.table[i].isDirectory ? "/" : "");
+}
+
+/// Same as above, but the names go into `buffer`, one per line.  Return the
+/// number of bytes used; names that do not fit are left out.
+///
+/// * `buffer` is where to put the names.
+/// * `size` is the room available in `buffer`.
+unsigned
+Directory::List(char *buffer, unsigned size) const
+{
+    ASSERT(buffer != nullptr);
+
+    unsigned used = 0;
+    for (unsigned i = 0; i < raw.tableSize; i++) {
+        const DirectoryEntry *e = &raw.table[i];
+        if (!e->inUse || strcmp(e->name, PARENT_DIRECTORY_NAME) == 0)
+            continue;
+        unsigned length = strlen(e->name);
+        unsigned needed = length + (e->isDirectory ? 2 : 1);
+        if (used + needed > size)
+            break;
+        memcpy(&buffer[used], e->name, length);
+        if (e->isDirectory)
+            buffer[used + length++] = '/';
+        buffer[used + length] = '\n';
+        used += needed;
+    }
+    return used;
 }
 
 /// List all the file names in the directory, their `FileHeader` locations,
@@ -161,10 +336,14 @@ Directory::Print() const
         if (raw.table[i].inUse) {
             printf("\nDirectory entry.\n"
                    "    Name: %s\n"
-                   "    Sector: %u\n",
-                   raw.table[i].name, raw.table[i].sector);
-            hdr->FetchFrom(raw.table[i].sector);
-            hdr->Print();
+                   "    Sector: %u\n"
+                   "    Directory: %s\n",
+                   raw.table[i].name, raw.table[i].sector,
+                   raw.table[i].isDirectory ? "yes" : "no");
+            if (hdr->FetchFrom(raw.table[i].sector))
+                hdr->Print();
+            else
+                printf("    Broken file header.\n");
         }
     printf("\n");
     delete hdr;
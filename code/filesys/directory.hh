@@ -3,6 +3,7 @@
 /// A directory is a table of pairs: *<file name, sector #>*, giving the name
 /// of each file in the directory, and where to find its file header (the
 /// data structure describing where to find the file's data blocks) on disk.
+/// The table is hashed by file name, and grows as it fills up.
 ///
 /// We assume mutual exclusion is provided by the caller.
 ///
@@ -40,14 +41,24 @@ public:
     /// Initialize directory contents from disk.
     void FetchFrom(OpenFile *file);
 
-    /// Write modifications to directory contents back to disk.
-    void WriteBack(OpenFile *file);
+    /// Write modifications to directory contents back to disk.  Return
+    /// false, leaving the disk untouched, if there is no room for the
+    /// directory to grow.
+    bool WriteBack(OpenFile *file);
 
-    /// Find the sector number of the `FileHeader` for file: `name`.
-    int Find(const char *name);
+    /// Find the sector number of the `FileHeader` for file: `name`, and
+    /// tell whether it is a directory.
+    int Find(const char *name, bool *isDirectory = nullptr);
+
+    /// Size of the table once one more file is added, or 0 if the
+    /// directory is full.
+    unsigned SizeForAdd() const;
 
     /// Add a file name into the directory.
-    bool Add(const char *name, int newSector);
+    bool Add(const char *name, int newSector, bool isDirectory = false);
+
+    /// Tell whether the directory holds nothing but its parent entry.
+    bool IsEmpty() const;
 
     /// Remove a file from the directory.
     bool Remove(const char *name);
@@ -55,6 +66,9 @@ public:
     /// Print the names of all the files in the directory.
     void List() const;
 
+    /// Copy the names of all the files in the directory into `buffer`.
+    unsigned List(char *buffer, unsigned size) const;
+
     /// Verbose print of the contents of the directory -- all the file names
     /// and their contents.
     void Print() const;
@@ -68,8 +82,22 @@ public:
 private:
     RawDirectory raw;
 
+    unsigned numEntries;  ///< Number of entries in use.
+
+    /// Range of entries changed since the last `FetchFrom`/`WriteBack`;
+    /// empty when `dirtyLow > dirtyHigh`.
+    unsigned dirtyLow, dirtyHigh;
+
     /// Find the index into the directory table corresponding to `name`.
     int FindIndex(const char *name);
+
+    /// Find the entry where `name` should be added.
+    unsigned FreeIndexFor(const char *name) const;
+
+    /// Double the size of the table, rehashing all the entries.
+    void Grow();
+
+    void MarkDirty(unsigned i);
 };
 
 
@@ -10,6 +10,17 @@
 /// For simplicity, we assume file names are <= 9 characters long.
 const unsigned FILE_NAME_MAX_LEN = 64;
 
+/// Maximum length of a path: names separated by `'/'`.
+const unsigned PATH_NAME_MAX_LEN = 255;
+
+/// Largest size of a directory table, in entries.  Tables start with 10
+/// entries and double as they fill up; growing one rewrites all of it, which
+/// has to fit in a single journal commit (cf. `JOURNAL_SIZE`).
+const unsigned MAX_DIR_ENTRIES = 320;
+
+/// Name of the entry every directory has pointing to its parent.
+static const char PARENT_DIRECTORY_NAME[] = "..";
+
 /// The following class defines a "directory entry", representing a file in
 /// the directory.  Each entry gives the name of the file, and where the
 /// file's header is to be found on disk.
@@ -20,11 +31,24 @@ class DirectoryEntry {
 public:
     /// Is this directory entry in use?
     bool inUse;
+    /// Is the entry a directory itself?
+    bool isDirectory;
     /// Location on disk to find the `FileHeader` for this file.
     unsigned sector;
     /// Text name for file, with +1 for the trailing `'\0'`.
     char name[FILE_NAME_MAX_LEN + 1];
 };
 
+/// Hash a file name into a directory or cache slot.  Only the characters
+/// that take part in name comparisons are looked at.
+inline unsigned
+HashFileName(const char *name)
+{
+    unsigned hash = 2166136261u;  // FNV-1a.
+    for (unsigned i = 0; i < FILE_NAME_MAX_LEN && name[i] != '\0'; i++)
+        hash = (hash ^ (unsigned char) name[i]) * 16777619u;
+    return hash;
+}
+
 
 #endif
@@ -4,9 +4,16 @@
 /// The file header is used to locate where on disk the file's data is
 /// stored.  We implement this as a fixed size table of pointers -- each
 /// entry in the table points to the disk sector containing that portion of
-/// the file data (in other words, there are no indirect or doubly indirect
-/// blocks). The table size is chosen so that the file header will be just
-/// big enough to fit in one disk sector,
+/// the file data -- followed by a single indirect and a double indirect
+/// index block for the sectors that do not fit in the table.  The table size
+/// is chosen so that the file header will be just big enough to fit in one
+/// disk sector.
+///
+/// The index blocks are read along with the header and kept in memory, so
+/// `ByteToSector` is a couple of array lookups.
+///
+/// Files can grow after creation (see `Extend`); sectors are then reserved a
+/// few at a time, so a file may own some sectors past its end.
 ///
 /// Unlike in a real system, we do not keep track of file permissions,
 /// ownership, last modification date, etc., in the file header.
@@ -27,24 +34,118 @@
 #include "threads/system.hh"
 
 
+/// Number of index blocks needed to address `numSectors` data sectors.
+static unsigned
+IndexSectorsFor(unsigned numSectors)
+{
+    if (numSectors <= NUM_DIRECT)
+        return 0;
+    if (numSectors <= NUM_DIRECT + NUM_INDIRECT)
+        return 1;
+    return 2 + DivRoundUp(numSectors - NUM_DIRECT - NUM_INDIRECT,
+                          NUM_INDIRECT);
+}
+
+FileHeader::FileHeader()
+{
+    memset(&raw, 0, sizeof raw);
+    for (unsigned i = 0; i < NUM_INDIRECT; i++)
+        secondLevel[i] = nullptr;
+}
+
+FileHeader::~FileHeader()
+{
+    for (unsigned i = 0; i < NUM_INDIRECT; i++)
+        delete secondLevel[i];
+}
+
+/// Number of data sectors reserved at once when a file grows, so that the
+/// header and the free map are written once per batch instead of once per
+/// sector.
+static const unsigned EXTEND_BATCH_SECTORS = 4;
+
 /// Initialize a fresh file header for a newly created file.  Allocate data
 /// blocks for the file out of the map of free disk blocks.  Return false if
 /// there are not enough free blocks to accomodate the new file.
 ///
 /// * `freeMap` is the bit map of free disk sectors.
-/// * `fileSize` is the bit map of free disk sectors.
+/// * `fileSize` is the size of the new file in bytes.
 bool
 FileHeader::Allocate(Bitmap *freeMap, unsigned fileSize)
 {
     ASSERT(freeMap != nullptr);
 
+    raw.numBytes = 0;
+    raw.numSectors = 0;
+    if (!Grow(freeMap, DivRoundUp(fileSize, SECTOR_SIZE)))
+        return false;
     raw.numBytes = fileSize;
-    raw.numSectors = DivRoundUp(fileSize, SECTOR_SIZE);
-    if (freeMap->CountClear() < raw.numSectors)
-        return false;  // Not enough space.
+    return true;
+}
 
-    for (unsigned i = 0; i < raw.numSectors; i++)
-        raw.dataSectors[i] = freeMap->Find();
+/// Grow the file to `newSize` bytes, reserving more sectors if needed (see
+/// `Reserve`).
+///
+/// Return false, leaving the header untouched, if there is not enough free
+/// space.
+///
+/// * `freeMap` is the bit map of free disk sectors.
+/// * `newSize` is the new length of the file in bytes.
+bool
+FileHeader::Extend(Bitmap *freeMap, unsigned newSize)
+{
+    ASSERT(newSize >= raw.numBytes);
+
+    if (!Reserve(freeMap, newSize))
+        return false;
+    raw.numBytes = newSize;
+    return true;
+}
+
+/// Make sure the file has data sectors for `newSize` bytes, without
+/// changing its length.  If the sectors already allocated do not suffice,
+/// reserve at least `EXTEND_BATCH_SECTORS` more, so that small appends do
+/// not need to go to the free map every time.  The extra sectors stay
+/// allocated to the file beyond its end.
+///
+/// Return false, leaving the header untouched, if there is not enough free
+/// space.
+///
+/// * `freeMap` is the bit map of free disk sectors.
+/// * `newSize` is the length in bytes the file must be able to reach.
+bool
+FileHeader::Reserve(Bitmap *freeMap, unsigned newSize)
+{
+    ASSERT(freeMap != nullptr);
+
+    unsigned needed = DivRoundUp(newSize, SECTOR_SIZE);
+    if (needed <= raw.numSectors)
+        return true;
+
+    // Reserve a whole batch if there is room for it, otherwise settle for
+    // what is strictly needed.
+    if (needed > MAX_FILE_SECTORS)
+        return false;
+    unsigned batch = raw.numSectors + EXTEND_BATCH_SECTORS;
+    if (batch < needed)
+        batch = needed;
+    if (batch > MAX_FILE_SECTORS)
+        batch = MAX_FILE_SECTORS;
+    return Grow(freeMap, batch) || Grow(freeMap, needed);
+}
+
+/// Grow the file to `newSize` bytes if that fits in the data sectors already
+/// allocated.  Return false otherwise.
+///
+/// * `newSize` is the new length of the file in bytes.
+bool
+FileHeader::ExtendInPlace(unsigned newSize)
+{
+    ASSERT(newSize >= raw.numBytes);
+
+    if (newSize > raw.numSectors * SECTOR_SIZE)
+        return false;
+    raw.numBytes = newSize;
     return true;
 }
 
@@ -57,27 +158,104 @@ FileHeader::Deallocate(Bitmap *freeMap)
     ASSERT(freeMap != nullptr);
 
     for (unsigned i = 0; i < raw.numSectors; i++) {
-        ASSERT(freeMap->Test(raw.dataSectors[i]));  // ought to be marked!
-        freeMap->Clear(raw.dataSectors[i]);
+        unsigned sector = *DataSectorSlot(i);
+        ASSERT(freeMap->Test(sector));  // ought to be marked!
+        freeMap->Clear(sector);
+        journal->Forget(sector);
+    }
+    for (unsigned i = 0; i < NumIndexSectors(); i++) {
+        unsigned sector = GetIndexSector(i);
+        ASSERT(freeMap->Test(sector));
+        freeMap->Clear(sector);
+        journal->Forget(sector);
     }
 }
 
-/// Fetch contents of file header from disk.
+/// Fetch contents of file header from disk, along with its index blocks.
+///
+/// Nothing on disk is trusted: an index block is only read once its sector
+/// number is known to be on the disk.  Return false, leaving an empty
+/// header, if the header is broken: if it has more sectors than a file can
+/// have, fewer than its size needs, or any sector number past the end of
+/// the disk.
 ///
 /// * `sector` is the disk sector containing the file header.
-void
+bool
 FileHeader::FetchFrom(unsigned sector)
 {
-    synchDisk->ReadSector(sector, (char *) this);
+    const unsigned diskSectors = superBlock->GetNumSectors();
+
+    journal->ReadSector(sector, (char *) &raw);
+    if (raw.numSectors > MAX_FILE_SECTORS
+          || DivRoundUp(raw.numBytes, SECTOR_SIZE) > raw.numSectors) {
+        DEBUG('f', "File header %u has %u bytes in %u sectors.\n",
+              sector, raw.numBytes, raw.numSectors);
+        memset(&raw, 0, sizeof raw);
+        return false;
+    }
+
+    unsigned numIndex = NumIndexSectors();
+    for (unsigned i = 0; i < numIndex; i++) {
+        unsigned s = GetIndexSector(i);
+        if (s >= diskSectors) {
+            DEBUG('f', "File header %u has index block %u at sector %u.\n",
+                  sector, i, s);
+            memset(&raw, 0, sizeof raw);
+            return false;
+        }
+        if (i == 0)
+            journal->ReadSector(s, (char *) &indirect);
+        else if (i == 1)
+            journal->ReadSector(s, (char *) &doubleIndirect);
+        else {
+            if (secondLevel[i - 2] == nullptr)
+                secondLevel[i - 2] = new RawIndirectBlock;
+            journal->ReadSector(s, (char *) secondLevel[i - 2]);
+        }
+    }
+
+    for (unsigned i = 0; i < raw.numSectors; i++)
+        if (*DataSectorSlot(i) >= diskSectors) {
+            DEBUG('f', "File header %u has data sector %u at sector %u.\n",
+                  sector, i, *DataSectorSlot(i));
+            memset(&raw, 0, sizeof raw);
+            return false;
+        }
+    return true;
 }
 
-/// Write the modified contents of the file header back to disk.
+/// Write the modified contents of the file header back to disk, along with
+/// its index blocks.
 ///
 /// * `sector` is the disk sector to contain the file header.
 void
 FileHeader::WriteBack(unsigned sector)
 {
-    synchDisk->WriteSector(sector, (char *) this);
+    journal->WriteMetadata(sector, (char *) &raw);
+
+    unsigned numIndex = NumIndexSectors();
+    if (numIndex > 0)
+        journal->WriteMetadata(raw.indirectSector, (char *) &indirect);
+    if (numIndex > 1)
+        journal->WriteMetadata(raw.doubleIndirectSector,
+                               (char *) &doubleIndirect);
+    for (unsigned i = 2; i < numIndex; i++)
+        journal->WriteMetadata(doubleIndirect.dataSectors[i - 2],
+                               (char *) secondLevel[i - 2]);
+}
+
+/// A file may have a batch of sectors reserved past its end, and their index
+/// blocks are written too.
+///
+/// * `fileSize` is the length of the file in bytes.
+unsigned
+FileHeader::MetadataSectorsFor(unsigned fileSize)
+{
+    unsigned numSectors = DivRoundUp(fileSize, SECTOR_SIZE)
+                          + EXTEND_BATCH_SECTORS;
+    if (numSectors > MAX_FILE_SECTORS)
+        numSectors = MAX_FILE_SECTORS;
+    return 1 + IndexSectorsFor(numSectors);
 }
 
 /// Return which disk sector is storing a particular byte within the file.
@@ -87,9 +265,9 @@ FileHeader::WriteBack(unsigned sector)
 ///
 /// * `offset` is the location within the file of the byte in question.
 unsigned
-FileHeader::ByteToSector(unsigned offset)
+FileHeader::ByteToSector(unsigned offset) const
 {
-    return raw.dataSectors[offset / SECTOR_SIZE];
+    return *DataSectorSlot(offset / SECTOR_SIZE);
 }
 
 /// Return the number of bytes in the file.
@@ -99,6 +277,14 @@ FileHeader::FileLength() const
     return raw.numBytes;
 }
 
+/// Return the number of bytes the file can grow to without allocating more
+/// data sectors.
+unsigned
+FileHeader::ReservedLength() const
+{
+    return raw.numSectors * SECTOR_SIZE;
+}
+
 /// Print the contents of the file header, and the contents of all the data
 /// blocks pointed to by the file header.
 void
@@ -111,10 +297,13 @@ FileHeader::Print()
            "    Block numbers: ",
            raw.numBytes);
     for (unsigned i = 0; i < raw.numSectors; i++)
-        printf("%u ", raw.dataSectors[i]);
+        printf("%u ", *DataSectorSlot(i));
+    printf("\n    Index blocks: ");
+    for (unsigned i = 0; i < NumIndexSectors(); i++)
+        printf("%u ", GetIndexSector(i));
     printf("\n    Contents:\n");
     for (unsigned i = 0, k = 0; i < raw.numSectors; i++) {
-        synchDisk->ReadSector(raw.dataSectors[i], data);
+        journal->ReadSector(*DataSectorSlot(i), data);
         for (unsigned j = 0; j < SECTOR_SIZE && k < raw.numBytes; j++, k++) {
             if ('\040' <= data[j] && data[j] <= '\176')  // isprint(data[j])
                 printf("%c", data[j]);
@@ -131,3 +320,103 @@ FileHeader::GetRaw() const
 {
     return &raw;
 }
+
+unsigned
+FileHeader::NumIndexSectors() const
+{
+    return IndexSectorsFor(raw.numSectors);
+}
+
+unsigned
+FileHeader::GetIndexSector(unsigned i) const
+{
+    ASSERT(i < NumIndexSectors());
+
+    if (i == 0)
+        return raw.indirectSector;
+    if (i == 1)
+        return raw.doubleIndirectSector;
+    return doubleIndirect.dataSectors[i - 2];
+}
+
+/// Locate the slot holding the `i`-th data sector, be it in the header
+/// itself, in the single indirect block or in a second level block.
+///
+/// * `i` is the index of the data sector within the file.
+unsigned *
+FileHeader::DataSectorSlot(unsigned i)
+{
+    ASSERT(i < MAX_FILE_SECTORS);
+
+    if (i < NUM_DIRECT)
+        return &raw.dataSectors[i];
+    i -= NUM_DIRECT;
+    if (i < NUM_INDIRECT)
+        return &indirect.dataSectors[i];
+    i -= NUM_INDIRECT;
+    ASSERT(secondLevel[i / NUM_INDIRECT] != nullptr);
+    return &secondLevel[i / NUM_INDIRECT]->dataSectors[i % NUM_INDIRECT];
+}
+
+const unsigned *
+FileHeader::DataSectorSlot(unsigned i) const
+{
+    return const_cast<FileHeader *>(this)->DataSectorSlot(i);
+}
+
+/// Allocate data sectors, and the index blocks they need, until the file
+/// has `numSectors` of them.  Return false, allocating nothing, if there is
+/// not enough free space.
+///
+/// * `freeMap` is the bit map of free disk sectors.
+/// * `numSectors` is the new number of data sectors.
+bool
+FileHeader::Grow(Bitmap *freeMap, unsigned numSectors)
+{
+    ASSERT(freeMap != nullptr);
+    ASSERT(numSectors >= raw.numSectors);
+
+    if (numSectors > MAX_FILE_SECTORS)
+        return false;  // Too big, even with indirection.
+    unsigned newIndex = IndexSectorsFor(numSectors) - NumIndexSectors();
+    if (freeMap->CountClear() < numSectors - raw.numSectors + newIndex)
+        return false;  // Not enough space.
+
+    for (unsigned i = raw.numSectors; i < numSectors; i++) {
+        AllocateIndexFor(freeMap, i);
+        *DataSectorSlot(i) = freeMap->Find();
+    }
+    raw.numSectors = numSectors;
+    return true;
+}
+
+/// Allocate the index blocks that data sector `i` depends on, when `i` is
+/// the first data sector that needs each of them.  Sectors are assumed to be
+/// allocated in increasing order.
+///
+/// * `freeMap` is the bit map of free disk sectors.
+/// * `i` is the index of the data sector about to be allocated.
+void
+FileHeader::AllocateIndexFor(Bitmap *freeMap, unsigned i)
+{
+    ASSERT(freeMap != nullptr);
+
+    if (i < NUM_DIRECT)
+        return;
+    if (i == NUM_DIRECT) {
+        raw.indirectSector = freeMap->Find();
+        return;
+    }
+    if (i < NUM_DIRECT + NUM_INDIRECT)
+        return;
+
+    unsigned j = i - NUM_DIRECT - NUM_INDIRECT;
+    if (j == 0)
+        raw.doubleIndirectSector = freeMap->Find();
+    if (j % NUM_INDIRECT == 0) {
+        unsigned k = j / NUM_INDIRECT;
+        if (secondLevel[k] == nullptr)
+            secondLevel[k] = new RawIndirectBlock;
+        doubleIndirect.dataSectors[k] = freeMap->Find();
+    }
+}
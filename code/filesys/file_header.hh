@@ -25,35 +25,61 @@
 /// The file header data structure can be stored in memory or on disk.  When
 /// it is on disk, it is stored in a single sector -- this means that we
 /// assume the size of this data structure to be the same as one disk sector.
-/// Without indirect addressing, this limits the maximum file length to just
-/// under 4K bytes.
+/// The first `NUM_DIRECT` data sectors are listed in the header itself; the
+/// rest are reached through a single indirect and a double indirect index
+/// block, which lifts the maximum file length to `MAX_FILE_SIZE`.
 ///
-/// There is no constructor; rather the file header can be initialized
-/// by allocating blocks for the file (if it is a new file), or by
-/// reading it from disk.
+/// While the header is in memory, the index blocks are kept in memory too,
+/// so that translating an offset never needs to touch the disk.
+///
+/// The constructor leaves an empty header; it can then be initialized by
+/// allocating blocks for the file (if it is a new file), or by reading it
+/// from disk.
 class FileHeader {
 public:
 
+    FileHeader();
+
+    ~FileHeader();
+
     /// Initialize a file header, including allocating space on disk for the
     /// file data.
     bool Allocate(Bitmap *bitMap, unsigned fileSize);
 
+    /// Grow the file to `newSize` bytes, allocating more data blocks if the
+    /// ones already reserved are not enough.
+    bool Extend(Bitmap *freeMap, unsigned newSize);
+
+    /// Grow the file to `newSize` bytes only if no new blocks are needed.
+    bool ExtendInPlace(unsigned newSize);
+
+    /// Allocate data blocks for the file to reach `newSize` bytes, leaving
+    /// its length alone.
+    bool Reserve(Bitmap *freeMap, unsigned newSize);
+
     /// De-allocate this file's data blocks.
     void Deallocate(Bitmap *bitMap);
 
-    /// Initialize file header from disk.
-    void FetchFrom(unsigned sectorNumber);
+    /// Initialize file header from disk.  Return false if it is broken.
+    bool FetchFrom(unsigned sectorNumber);
 
     /// Write modifications to file header back to disk.
     void WriteBack(unsigned sectorNumber);
 
+    /// Most sectors written back for a file of `fileSize` bytes: the header
+    /// and its index blocks.
+    static unsigned MetadataSectorsFor(unsigned fileSize);
+
     /// Convert a byte offset into the file to the disk sector containing the
     /// byte.
-    unsigned ByteToSector(unsigned offset);
+    unsigned ByteToSector(unsigned offset) const;
 
     /// Return the length of the file in bytes
     unsigned FileLength() const;
 
+    /// Return how many bytes the data blocks allocated to the file can hold.
+    unsigned ReservedLength() const;
+
     /// Print the contents of the file.
     void Print();
 
@@ -63,8 +89,33 @@ public:
     /// system at a low level.
     const RawFileHeader *GetRaw() const;
 
+    /// Number of index blocks used by the file, and the sector holding the
+    /// `i`-th of them (single indirect first, then double indirect, then
+    /// the second level blocks).
+    ///
+    /// NOTE: same as `GetRaw`, only meant for low level routines.
+    unsigned NumIndexSectors() const;
+    unsigned GetIndexSector(unsigned i) const;
+
 private:
     RawFileHeader raw;
+
+    /// Cached index blocks.  Second level blocks are allocated on demand.
+    RawIndirectBlock indirect;
+    RawIndirectBlock doubleIndirect;
+    RawIndirectBlock *secondLevel[NUM_INDIRECT];
+
+    /// Slot holding the sector number of the `i`-th data sector.
+    unsigned *DataSectorSlot(unsigned i);
+    const unsigned *DataSectorSlot(unsigned i) const;
+
+    /// Allocate the index blocks needed before data sector `i` can be
+    /// recorded, if `i` is the first one to need them.
+    void AllocateIndexFor(Bitmap *freeMap, unsigned i);
+
+    /// Allocate data and index blocks until the file has `numSectors` data
+    /// sectors.
+    bool Grow(Bitmap *freeMap, unsigned numSectors);
 };
 
 
@@ -5,36 +5,61 @@
 /// * a file header, stored in a sector on disk (the size of the file header
 ///   data structure is arranged to be precisely the size of 1 disk sector);
 /// * a number of data blocks;
-/// * an entry in the file system directory.
+/// * an entry in some directory of the file system.
 ///
 /// The file system consists of several data structures:
+/// * A superblock, telling the size of the disk and where the structures
+///   that depend on it are (cf. `super_block.hh`).
 /// * A bitmap of free disk sectors (cf. `bitmap.h`).
-/// * A directory of file names and file headers.
+/// * A tree of directories of file names and file headers.  Besides
+///   regular files, a directory may list other directories, and always
+///   lists its parent under the name `..`.
 ///
-/// Both the bitmap and the directory are represented as normal files.  Their
-/// file headers are located in specific sectors (sector 0 and sector 1), so
-/// that the file system can find them on bootup.
+/// Both the bitmap and the directories are represented as normal files.
+/// The file headers of the bitmap and of the root directory are located in
+/// specific sectors (sector 1 and sector 2), so that the file system can
+/// find them on bootup.
+///
+/// Files are named by paths of names separated by `/`.  Paths starting with
+/// `/` are resolved from the root directory, and any other from the current
+/// directory of the running thread.  Every step of a path walk goes through
+/// a cache of names, so that directories on the way are not read again and
+/// again.
 ///
 /// The file system assumes that the bitmap and directory files are kept
-/// “open” continuously while Nachos is running.
+/// “open” continuously while Nachos is running.  The bitmap is also kept in
+/// memory all along, so it is only read once, at start up.
 ///
 /// For those operations (such as `Create`, `Remove`) that modify the
 /// directory and/or bitmap, if the operation succeeds, the changes are
-/// written immediately back to disk (the two files are kept open during all
-/// this time).  If the operation fails, and we have modified part of the
-/// directory and/or bitmap, we simply discard the changed version, without
-/// writing it back to disk.
+/// handed to the journal (the two files are kept open during all this
+/// time); only the sectors of the bitmap that actually changed are written.
+/// If the operation fails, and we have modified part of the directory, we
+/// simply discard the changed version, without writing it back; changes to
+/// the in-memory bitmap are undone.
+///
+/// The journal (cf. `journal.hh`) commits the changes of several operations
+/// at once, in a way that survives a crash at any point: after a restart,
+/// each operation is either entirely on disk or not at all.  The journal
+/// lives in the last sectors of the disk, which are marked as used.
+///
+/// Operations on names, and any change to the free map, are serialized by
+/// one lock for the whole file system.  Reading and writing file contents
+/// is only serialized per file: each open file shares a reader-writer lock
+/// with every other `OpenFile` on the same header, so that any number of
+/// threads may read a file while nobody writes it.  Locks are always taken
+/// in this order: the lock of a regular file, the file system lock, the
+/// lock of a directory, and the lock of the open file table.
 ///
 /// Our implementation at this point has the following restrictions:
 ///
-/// * there is no synchronization for concurrent accesses;
-/// * files have a fixed size, set when the file is created;
-/// * files cannot be bigger than about 3KB in size;
-/// * there is no hierarchical directory structure, and only a limited number
-///   of files can be added to the system;
-/// * there is no attempt to make the system robust to failures (if Nachos
-///   exits in the middle of an operation that modifies the file system, it
-///   may corrupt the disk).
+/// * files grow when written past their end, but never shrink;
+/// * files cannot be bigger than `MAX_FILE_SIZE` (about 135KB, using
+///   single and double indirect index blocks);
+/// * directories cannot hold more than three quarters of `MAX_DIR_ENTRIES`
+///   files, so that adding one always fits in a journal commit;
+/// * the contents of regular files are not journaled, so after a crash a
+///   file may show sectors that were allocated but never written.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2018 Docentes de la Universidad Nacional de Rosario.
@@ -46,24 +71,72 @@
 #include "directory.hh"
 #include "directory_entry.hh"
 #include "file_header.hh"
+#include "name_cache.hh"
 #include "lib/bitmap.hh"
 #include "machine/disk.hh"
+#include "threads/system.hh"
 
 
-/// Sectors containing the file headers for the bitmap of free sectors, and
-/// the directory of files.  These file headers are placed in well-known
-/// sectors, so that they can be located on boot-up.
-static const unsigned FREE_MAP_SECTOR = 0;
-static const unsigned DIRECTORY_SECTOR = 1;
-
-/// Initial file sizes for the bitmap and directory; until the file system
-/// supports extensible files, the directory size sets the maximum number of
-/// files that can be loaded onto the disk.
-static const unsigned FREE_MAP_FILE_SIZE = NUM_SECTORS / BITS_IN_BYTE;
+/// Initial file size for the directory.  The directory grows as files are
+/// added to it.  The size of the bitmap follows from the size of the disk
+/// (cf. `SuperBlock`).
 static const unsigned NUM_DIR_ENTRIES = 10;
 static const unsigned DIRECTORY_FILE_SIZE = sizeof (DirectoryEntry)
                                             * NUM_DIR_ENTRIES;
 
+/// Most sectors of metadata written by each operation, so that the journal
+/// can commit the operation whole (cf. `Journal::Begin`).  Counting high is
+/// harmless, beyond committing a little earlier than needed.
+
+static unsigned
+FreeMapSectors()
+{
+    return DivRoundUp(superBlock->GetFreeMapSize(), SECTOR_SIZE);
+}
+
+/// A directory with a table of `tableSize` entries, header included.
+static unsigned
+DirectorySectors(unsigned tableSize)
+{
+    unsigned size = tableSize * sizeof (DirectoryEntry);
+    return DivRoundUp(size, SECTOR_SIZE) + FileHeader::MetadataSectorsFor(size);
+}
+
+/// Adding a file of `initialSize` bytes to a directory whose table ends up
+/// with `tableSize` entries.  If the table grows, all of it is written;
+/// otherwise only the new entry, which may straddle two sectors.
+static unsigned
+AddFootprint(unsigned tableSize, bool grows, unsigned initialSize,
+             bool isDirectory)
+{
+    unsigned sectors = grows ? DirectorySectors(tableSize) : 2;
+    sectors += FileHeader::MetadataSectorsFor(initialSize) + FreeMapSectors();
+    if (isDirectory)
+        sectors += DivRoundUp(DIRECTORY_FILE_SIZE, SECTOR_SIZE);
+    return sectors;
+}
+
+/// Closing a file may write its header back, or free all of it.
+static unsigned
+CloseFootprint()
+{
+    return FileHeader::MetadataSectorsFor(MAX_FILE_SIZE) + FreeMapSectors();
+}
+
+/// What the last check found, so that the next one can look only at what
+/// changed since.
+struct CheckState {
+    bool valid;  ///< Did the last check succeed?
+    unsigned numSectors;  ///< Size of the arrays below.
+    int *owner;  ///< Header owning each sector, or `NO_OWNER`.
+    int *parent;  ///< Directory listing each header, or -1.
+    bool *isDirectory;  ///< For each header.
+    unsigned low;  ///< Range of sectors looked at by the current check.
+    unsigned high;
+};
+
+static const int NO_OWNER = -1;
+
 /// Initialize the file system.  If `format == true`, the disk has nothing on
 /// it, and we need to initialize the disk to contain an empty directory, and
 /// a bitmap of free sectors (with almost but not all of the sectors marked
@@ -76,8 +149,24 @@ static const unsigned DIRECTORY_FILE_SIZE = sizeof (DirectoryEntry)
 FileSystem::FileSystem(bool format)
 {
     DEBUG('f', "Initializing the file system.\n");
+    lock = new Lock("file system");
+    nameCache = new NameCache;
+    numSectors = superBlock->GetNumSectors();
+    checkState = new CheckState;
+    checkState->valid = false;
+    checkState->numSectors = numSectors;
+    checkState->owner = new int [numSectors];
+    checkState->parent = new int [numSectors];
+    checkState->isDirectory = new bool [numSectors];
+
+    // The biggest operations must fit in the journal, whatever the size of
+    // the free map.
+    ASSERT(AddFootprint(MAX_DIR_ENTRIES, true, DIRECTORY_FILE_SIZE, true)
+             <= JOURNAL_CAPACITY);
+    ASSERT(CloseFootprint() <= JOURNAL_CAPACITY);
+
     if (format) {
-        Bitmap     *freeMap   = new Bitmap(NUM_SECTORS);
+        freeMap = new Bitmap(numSectors);
         Directory  *directory = new Directory(NUM_DIR_ENTRIES);
         FileHeader *mapHeader = new FileHeader;
         FileHeader *dirHeader = new FileHeader;
@@ -86,13 +175,16 @@ FileSystem::FileSystem(bool format)
 
         // First, allocate space for FileHeaders for the directory and bitmap
         // (make sure no one else grabs these!)
+        freeMap->Mark(SUPER_BLOCK_SECTOR);
         freeMap->Mark(FREE_MAP_SECTOR);
         freeMap->Mark(DIRECTORY_SECTOR);
+        for (unsigned i = 0; i < JOURNAL_SIZE; i++)
+            freeMap->Mark(superBlock->GetJournalSector() + i);
 
         // Second, allocate space for the data blocks containing the contents
         // of the directory and bitmap files.  There better be enough space!
 
-        ASSERT(mapHeader->Allocate(freeMap, FREE_MAP_FILE_SIZE));
+        ASSERT(mapHeader->Allocate(freeMap, superBlock->GetFreeMapSize()));
         ASSERT(dirHeader->Allocate(freeMap, DIRECTORY_FILE_SIZE));
 
         // Flush the bitmap and directory `FileHeader`s back to disk.
@@ -108,8 +200,8 @@ FileSystem::FileSystem(bool format)
         // The file system operations assume these two files are left open
         // while Nachos is running.
 
-        freeMapFile   = new OpenFile(FREE_MAP_SECTOR);
-        directoryFile = new OpenFile(DIRECTORY_SECTOR);
+        freeMapFile   = new OpenFile(FREE_MAP_SECTOR, true);
+        directoryFile = new OpenFile(DIRECTORY_SECTOR, true);
 
         // Once we have the files “open”, we can write the initial version of
         // each file back to disk.  The directory at this point is completely
@@ -119,38 +211,52 @@ FileSystem::FileSystem(bool format)
 
         DEBUG('f', "Writing bitmap and directory back to disk.\n");
         freeMap->WriteBack(freeMapFile);     // flush changes to disk
-        directory->WriteBack(directoryFile);
+        directory->Add(PARENT_DIRECTORY_NAME, DIRECTORY_SECTOR, true);
+        ASSERT(directory->WriteBack(directoryFile));
 
         if (debug.IsEnabled('f')) {
             freeMap->Print();
             directory->Print();
-
-            delete freeMap;
-            delete directory;
-            delete mapHeader;
-            delete dirHeader;
         }
+        delete directory;
+        delete mapHeader;
+        delete dirHeader;
+        journal->Commit();
     } else {
         // If we are not formatting the disk, just open the files
         // representing the bitmap and directory; these are left open while
-        // Nachos is running.
-        freeMapFile   = new OpenFile(FREE_MAP_SECTOR);
-        directoryFile = new OpenFile(DIRECTORY_SECTOR);
+        // Nachos is running.  The bitmap stays in memory from now on.
+        freeMapFile   = new OpenFile(FREE_MAP_SECTOR, true);
+        directoryFile = new OpenFile(DIRECTORY_SECTOR, true);
+        freeMap = new Bitmap(numSectors);
+        freeMap->FetchFrom(freeMapFile);
     }
 }
 
 FileSystem::~FileSystem()
 {
+    DropDirectory(currentThread->GetCurrentDirectory());
+    currentThread->SetCurrentDirectory(DIRECTORY_SECTOR);
+    delete nameCache;
+    delete [] checkState->owner;
+    delete [] checkState->parent;
+    delete [] checkState->isDirectory;
+    delete checkState;
+    journal->Begin(FreeMapSectors());
+    freeMap->WriteBack(freeMapFile);
+    delete freeMap;
     delete freeMapFile;
     delete directoryFile;
+    delete lock;
 }
 
 /// Create a file in the Nachos file system (similar to UNIX `create`).
-/// Since we cannot increase the size of files dynamically, we have to give
-/// Create the initial size of the file.
+/// Files grow as they are written, but `initialSize` lets the caller
+/// allocate space up front.
 ///
 /// The steps to create a file are:
-/// 1. Make sure the file does not already exist.
+/// 1. Find the directory where the file goes, and make sure the file does
+///    not already exist there.
 /// 2. Allocate a sector for the file header.
 /// 3. Allocate space on disk for the data blocks for the file.
 /// 4. Add the name to the directory.
@@ -160,84 +266,138 @@ FileSystem::~FileSystem()
 /// Return true if everything goes ok, otherwise, return false.
 ///
 /// Create fails if:
+/// * some directory along the path does not exist;
 /// * file is already in directory;
+/// * the directory is full;
+/// * the file is too big to be allocated in a single journal commit;
 /// * no free space for file header;
-/// * no free entry for file in directory;
+/// * no free space for the directory to grow;
 /// * no free space for data blocks for the file.
 ///
 /// Note that this implementation assumes there is no concurrent access to
 /// the file system!
 ///
-/// * `name` is the name of file to be created.
+/// * `name` is the path of file to be created.
 /// * `initialSize` is the size of file to be created.
 bool
 FileSystem::Create(const char *name, unsigned initialSize)
 {
     ASSERT(name != nullptr);
 
+    DEBUG('f', "Creating file %s, size %u\n", name, initialSize);
+    return AddEntry(name, initialSize, false);
+}
+
+/// Create a directory (similar to UNIX `mkdir`).  It is created just like a
+/// file, and starts with a single entry pointing back to its parent.
+///
+/// * `path` is the path of the directory to be created.
+bool
+FileSystem::MakeDirectory(const char *path)
+{
+    ASSERT(path != nullptr);
+
+    DEBUG('f', "Creating directory %s\n", path);
+    return AddEntry(path, DIRECTORY_FILE_SIZE, true);
+}
+
+/// Common part of `Create` and `MakeDirectory`.
+bool
+FileSystem::AddEntry(const char *path, unsigned initialSize,
+                     bool isDirectory)
+{
+    char        name[FILE_NAME_MAX_LEN + 1];
     Directory  *directory;
-    Bitmap     *freeMap;
     FileHeader *header;
     int         sector;
     bool        success;
 
-    DEBUG('f', "Creating file %s, size %u\n", name, initialSize);
+    lock->Acquire();
+    int dir = FindParent(path, name);
+    if (dir == -1 || IsSpecialName(name)) {
+        lock->Release();
+        return false;
+    }
 
+    OpenFile *dirFile = OpenDirectoryFile(dir);
     directory = new Directory(NUM_DIR_ENTRIES);
-    directory->FetchFrom(directoryFile);
+    directory->FetchFrom(dirFile);
 
+    unsigned tableSize = directory->SizeForAdd();
+    unsigned footprint
+      = AddFootprint(tableSize, tableSize > directory->GetRaw()->tableSize,
+                     initialSize, isDirectory);
     if (directory->Find(name) != -1)
         success = false;  // File is already in directory.
+    else if (tableSize == 0)
+        success = false;  // The directory cannot grow anymore.
+    else if (footprint > JOURNAL_CAPACITY)
+        success = false;  // Too big to be allocated in one commit.
     else {
-        freeMap = new Bitmap(NUM_SECTORS);
-        freeMap->FetchFrom(freeMapFile);
+        journal->Begin(footprint);
         sector = freeMap->Find();  // Find a sector to hold the file header.
         if (sector == -1)
             success = false;  // No free block for file header.
-        else if (!directory->Add(name, sector))
-            success = false;  // No space in directory.
         else {
+            directory->Add(name, sector, isDirectory);
             header = new FileHeader;
-            if (!header->Allocate(freeMap, initialSize))
+            if (!header->Allocate(freeMap, initialSize)) {
+                freeMap->Clear(sector);
                 success = false;  // No space on disk for data.
-            else {
+            } else if (!directory->WriteBack(dirFile)) {
+                header->Deallocate(freeMap);
+                freeMap->Clear(sector);
+                success = false;  // No space for the directory to grow.
+            } else {
                 success = true;
                 // Everthing worked, flush all changes back to disk.
                 header->WriteBack(sector);
-                directory->WriteBack(directoryFile);
+                if (isDirectory) {
+                    Directory *contents = new Directory(NUM_DIR_ENTRIES);
+                    OpenFile *file = new OpenFile(sector, true);
+                    contents->Add(PARENT_DIRECTORY_NAME, dir, true);
+                    bool written = contents->WriteBack(file);
+                    ASSERT(written);  // It fits in the space allocated.
+                    delete file;
+                    delete contents;
+                }
                 freeMap->WriteBack(freeMapFile);
+                nameCache->Invalidate(dir, name);
             }
             delete header;
         }
-        delete freeMap;
     }
     delete directory;
+    CloseDirectoryFile(dirFile);
+    journal->Complete();
+    lock->Release();
     return success;
 }
 
 /// Open a file for reading and writing.
 ///
 /// To open a file:
-/// 1. Find the location of the file's header, using the directory.
+/// 1. Find the location of the file's header, walking the path one
+///    directory at a time.
 /// 2. Bring the header into memory.
 ///
-/// * `name` is the text name of the file to be opened.
+/// Directories cannot be opened this way.
+///
+/// * `name` is the path of the file to be opened.
 OpenFile *
 FileSystem::Open(const char *name)
 {
     ASSERT(name != nullptr);
 
-    Directory *directory = new Directory(NUM_DIR_ENTRIES);
-    OpenFile  *openFile = nullptr;
-    int        sector;
-
     DEBUG('f', "Opening file %s\n", name);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector >= 0)
-        openFile = new OpenFile(sector);  // `name` was found in directory.
-    delete directory;
-    return openFile;  // Return null if not found.
+    lock->Acquire();
+    bool isDirectory;
+    int sector = Resolve(name, &isDirectory);
+    OpenFile *file = nullptr;
+    if (sector != -1 && !isDirectory)  // Otherwise `name` was not found, or
+        file = new OpenFile(sector);   // is not a file.
+    lock->Release();
+    return file;
 }
 
 /// Delete a file from the file system.
@@ -248,68 +408,430 @@ FileSystem::Open(const char *name)
 /// 3. Delete the space for its data blocks.
 /// 4. Write changes to directory, bitmap back to disk.
 ///
+/// Directories can be deleted too, as long as they are empty and are not
+/// the current directory of the running thread.
+///
+/// A file that is open somewhere leaves its directory right away, but its
+/// header and data blocks are kept until it is closed for the last time.
+///
 /// Return true if the file was deleted, false if the file was not in the
 /// file system.
 ///
-/// * `name` is the text name of the file to be removed.
+/// * `name` is the path of the file to be removed.
 bool
 FileSystem::Remove(const char *name)
 {
     ASSERT(name != nullptr);
 
+    char        last[FILE_NAME_MAX_LEN + 1];
     Directory  *directory;
-    Bitmap     *freeMap;
-    FileHeader *fileHeader;
     int         sector;
+    bool        isDirectory;
+
+    lock->Acquire();
+    int dir = FindParent(name, last);
+    if (dir == -1 || IsSpecialName(last)) {
+        lock->Release();
+        return false;
+    }
 
+    OpenFile *dirFile = OpenDirectoryFile(dir);
     directory = new Directory(NUM_DIR_ENTRIES);
-    directory->FetchFrom(directoryFile);
-    sector = directory->Find(name);
-    if (sector == -1) {
+    directory->FetchFrom(dirFile);
+    sector = directory->Find(last, &isDirectory);
+    if (sector == -1 || (isDirectory && !CanRemoveDirectory(sector))) {
        delete directory;
+       CloseDirectoryFile(dirFile);
+       lock->Release();
        return false;  // file not found
     }
-    fileHeader = new FileHeader;
-    fileHeader->FetchFrom(sector);
+    journal->Begin(DirectorySectors(directory->GetRaw()->tableSize)
+                   + FreeMapSectors());
+    directory->Remove(last);
+    nameCache->Invalidate(dir, last);
+    if (isDirectory)
+        nameCache->Invalidate(sector, PARENT_DIRECTORY_NAME);
+    directory->WriteBack(dirFile);  // Flush to disk.
+    delete directory;
+    CloseDirectoryFile(dirFile);
+
+    // Let the table of open files delete the file now, or on its last
+    // close if it is open.
+    fileTable->Acquire(sector);
+    fileTable->MarkRemoved(sector);
+    fileTable->Release(sector);
+    journal->Complete();
+    lock->Release();
+    return true;
+}
 
-    freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
+/// Give the header and data blocks of a removed file back to the free map.
+///
+/// * `hdr` is the header of the file.
+/// * `sector` is the disk sector holding `hdr`.
+void
+FileSystem::Deallocate(FileHeader *hdr, unsigned sector)
+{
+    ASSERT(hdr != nullptr);
 
-    fileHeader->Deallocate(freeMap);  // Remove data blocks.
-    freeMap->Clear(sector);           // Remove header block.
-    directory->Remove(name);
+    bool mustLock = !lock->IsHeldByCurrentThread();
+    if (mustLock) {
+        lock->Acquire();
+        journal->Begin(FreeMapSectors());
+    }
+    DEBUG('f', "Deallocating file at sector %u.\n", sector);
+    hdr->Deallocate(freeMap);  // Remove data blocks.
+    freeMap->Clear(sector);    // Remove header block.
+    journal->Forget(sector);
+    freeMap->WriteBack(freeMapFile);  // Flush to disk.
+    if (mustLock) {
+        journal->Complete();
+        lock->Release();
+    }
+}
 
-    freeMap->WriteBack(freeMapFile);      // Flush to disk.
-    directory->WriteBack(directoryFile);  // Flush to disk.
-    delete fileHeader;
+/// Give up a reference to the header of a regular file, on its close.  The
+/// last one writes the header back, or frees the file if it was removed,
+/// so the journal must have room for that.  Closes are not counted as
+/// operations, though: most write nothing, and should not make the group
+/// be committed any sooner.
+///
+/// * `sector` is the disk sector holding the header.
+void
+FileSystem::CloseFile(unsigned sector)
+{
+    bool mustLock = !lock->IsHeldByCurrentThread();
+    if (mustLock) {
+        lock->Acquire();
+        journal->Begin(CloseFootprint());
+    }
+    fileTable->Release(sector);
+    if (mustLock)
+        lock->Release();
+}
+
+/// FileSystem::HoldDirectory/DropDirectory
+///
+/// Every thread holds a reference to its current directory in the table of
+/// open files, so that `Remove` can tell that some thread is still in it.
+/// The root directory needs none: it is open all along, and never removed.
+///
+/// * `sector` is the disk sector holding the header of the directory.
+
+void
+FileSystem::HoldDirectory(unsigned sector)
+{
+    if (sector != DIRECTORY_SECTOR)
+        fileTable->Acquire(sector);
+}
+
+void
+FileSystem::DropDirectory(unsigned sector)
+{
+    if (sector != DIRECTORY_SECTOR)
+        CloseFile(sector);
+}
+
+/// A directory can only be removed if it is empty, and nobody has it open,
+/// not even as the current directory of a thread.  The caller holds the
+/// lock, so no operation has it open for a while either.
+///
+/// * `sector` is the disk sector holding the header of the directory.
+bool
+FileSystem::CanRemoveDirectory(unsigned sector)
+{
+    if (fileTable->IsOpen(sector))
+        return false;
+
+    OpenFile  *file = OpenDirectoryFile(sector);
+    Directory *directory = new Directory(NUM_DIR_ENTRIES);
+    directory->FetchFrom(file);
+    bool empty = directory->IsEmpty();
     delete directory;
-    delete freeMap;
+    CloseDirectoryFile(file);
+    return empty;
+}
+
+/// Make `path` the current directory of the running thread, the one
+/// relative paths start from (similar to UNIX `chdir`).
+///
+/// Return false if `path` does not name a directory.
+///
+/// * `path` is the path of the new current directory.
+bool
+FileSystem::ChangeDirectory(const char *path)
+{
+    ASSERT(path != nullptr);
+
+    lock->Acquire();
+    bool isDirectory;
+    int sector = Resolve(path, &isDirectory);
+    if (sector == -1 || !isDirectory) {
+        lock->Release();
+        return false;
+    }
+    DEBUG('f', "Changing directory to %s, at sector %d\n", path, sector);
+    unsigned previous = currentThread->GetCurrentDirectory();
+    HoldDirectory(sector);
+    currentThread->SetCurrentDirectory(sector);
+    lock->Release();
+    DropDirectory(previous);  // Takes the lock again, to close it.
     return true;
 }
 
-/// List all the files in the file system directory.
+/// Copy the names of the files in directory `path` into `buffer`, one per
+/// line, with a trailing `'/'` for directories.
+///
+/// Return the number of bytes used, or -1 if `path` does not name a
+/// directory.
+///
+/// * `path` is the path of the directory to list.
+/// * `buffer` is where to put the names.
+/// * `size` is the room available in `buffer`.
+int
+FileSystem::ListDirectory(const char *path, char *buffer, unsigned size)
+{
+    ASSERT(path != nullptr);
+    ASSERT(buffer != nullptr);
+
+    lock->Acquire();
+    bool isDirectory;
+    int sector = Resolve(path, &isDirectory);
+    if (sector == -1 || !isDirectory) {
+        lock->Release();
+        return -1;
+    }
+
+    OpenFile  *file = OpenDirectoryFile(sector);
+    Directory *directory = new Directory(NUM_DIR_ENTRIES);
+    directory->FetchFrom(file);
+    unsigned used = directory->List(buffer, size);
+    delete directory;
+    CloseDirectoryFile(file);
+    lock->Release();
+    return used;
+}
+
+/// Names that cannot be created nor removed.
+bool
+FileSystem::IsSpecialName(const char *name)
+{
+    return name[0] == '\0' || strcmp(name, ".") == 0
+           || strcmp(name, PARENT_DIRECTORY_NAME) == 0;
+}
+
+/// Walk `path` up to its last component, and return the sector of the
+/// directory where that component should be.  The component itself is
+/// copied into `name`, which may end up empty if the path does.
+///
+/// Paths starting with `'/'` are walked from the root directory, and any
+/// other from the current directory of the running thread.  Return -1 if
+/// some step before the last is not a directory, or if a name is too long.
+///
+/// * `path` is the path to walk.
+/// * `name` is where to leave the last component; it must have room for
+///   `FILE_NAME_MAX_LEN + 1` characters.
+int
+FileSystem::FindParent(const char *path, char *name)
+{
+    ASSERT(path != nullptr);
+    ASSERT(name != nullptr);
+
+    unsigned dir = path[0] == '/' ? DIRECTORY_SECTOR
+                                  : currentThread->GetCurrentDirectory();
+    for (;;) {
+        while (*path == '/')
+            path++;
+        const char *end = strchr(path, '/');
+        if (end == nullptr)
+            end = path + strlen(path);
+        unsigned length = end - path;
+        if (length > FILE_NAME_MAX_LEN)
+            return -1;
+        memcpy(name, path, length);
+        name[length] = '\0';
+
+        path = end;
+        while (*path == '/')
+            path++;
+        if (*path == '\0')
+            return dir;
+
+        bool isDirectory;
+        int sector = Lookup(dir, name, &isDirectory);
+        if (sector == -1 || !isDirectory)
+            return -1;
+        dir = sector;
+    }
+}
+
+/// Return the sector of the header of the file named by `path`, or -1 if
+/// there is none.
+///
+/// * `path` is the path to resolve.
+/// * `isDirectory` is set to whether the file is a directory.
+int
+FileSystem::Resolve(const char *path, bool *isDirectory)
+{
+    ASSERT(isDirectory != nullptr);
+
+    char name[FILE_NAME_MAX_LEN + 1];
+    int dir = FindParent(path, name);
+    if (dir == -1)
+        return -1;
+    if (name[0] == '\0') {  // The path names a directory, like `/`.
+        *isDirectory = true;
+        return dir;
+    }
+    return Lookup(dir, name, isDirectory);
+}
+
+/// Look up a single `name` in directory `dir`.  The name cache is tried
+/// first, so walking the same directories over and over does not read them
+/// from disk each time.
+///
+/// * `dir` is the sector of the directory to look in.
+/// * `name` is the file name to look up.
+/// * `isDirectory` is set to whether the file is a directory.
+int
+FileSystem::Lookup(unsigned dir, const char *name, bool *isDirectory)
+{
+    ASSERT(name != nullptr);
+    ASSERT(isDirectory != nullptr);
+
+    if (strcmp(name, ".") == 0) {
+        *isDirectory = true;
+        return dir;
+    }
+
+    int sector = nameCache->Find(dir, name, isDirectory);
+    if (sector != -1)
+        return sector;
+
+    OpenFile  *file = OpenDirectoryFile(dir);
+    Directory *directory = new Directory(NUM_DIR_ENTRIES);
+    directory->FetchFrom(file);
+    sector = directory->Find(name, isDirectory);
+    delete directory;
+    CloseDirectoryFile(file);
+
+    if (sector != -1)
+        nameCache->Insert(dir, name, sector, *isDirectory);
+    return sector;
+}
+
+/// The root directory is always open; any other is opened on demand, and
+/// closed by `CloseDirectoryFile`.
+///
+/// * `sector` is the sector of the directory header.
+OpenFile *
+FileSystem::OpenDirectoryFile(unsigned sector)
+{
+    return sector == DIRECTORY_SECTOR ? directoryFile
+                                      : new OpenFile(sector, true);
+}
+
+void
+FileSystem::CloseDirectoryFile(OpenFile *file)
+{
+    if (file != directoryFile)
+        delete file;
+}
+
+/// Grow a file, allocating new data blocks out of the free map if needed.
+/// Both the file header and the free map are flushed to disk once, however
+/// many sectors get allocated.
+///
+/// Return false, leaving the file untouched, if the disk is full.
+///
+/// * `hdr` is the in-memory header of an open file.
+/// * `sector` is the disk sector holding `hdr`.
+/// * `newSize` is the new length of the file.
+bool
+FileSystem::Extend(FileHeader *hdr, unsigned sector, unsigned newSize)
+{
+    ASSERT(hdr != nullptr);
+
+    // Growing a directory happens with the lock already held.
+    bool mustLock = !lock->IsHeldByCurrentThread();
+    if (mustLock) {
+        lock->Acquire();
+        journal->Begin(FileHeader::MetadataSectorsFor(newSize)
+                       + FreeMapSectors());
+    }
+    bool success = hdr->Extend(freeMap, newSize);
+    if (success) {
+        DEBUG('f', "Extended file at sector %u to %u bytes.\n",
+              sector, newSize);
+        hdr->WriteBack(sector);
+        freeMap->WriteBack(freeMapFile);
+    }
+    if (mustLock) {
+        journal->Complete();
+        lock->Release();
+    }
+    return success;
+}
+
+/// Allocate data blocks for an open file to reach `newSize` bytes, without
+/// changing its length, so that writing that far later cannot fail.  The
+/// file header and the free map are flushed to disk as in `Extend`.
+///
+/// Return false, leaving the file untouched, if the disk is full.
+///
+/// * `hdr` is the in-memory header of an open regular file.
+/// * `sector` is the disk sector holding `hdr`.
+/// * `newSize` is the length the file must be able to reach.
+bool
+FileSystem::Reserve(FileHeader *hdr, unsigned sector, unsigned newSize)
+{
+    ASSERT(hdr != nullptr);
+
+    lock->Acquire();
+    journal->Begin(FileHeader::MetadataSectorsFor(newSize) + FreeMapSectors());
+    bool success = hdr->Reserve(freeMap, newSize);
+    if (success) {
+        DEBUG('f', "Reserved room for %u bytes in file at sector %u.\n",
+              newSize, sector);
+        hdr->WriteBack(sector);
+        freeMap->WriteBack(freeMapFile);
+    }
+    journal->Complete();
+    lock->Release();
+    return success;
+}
+
+/// Commit the changes made so far, so that they survive a crash.
+void
+FileSystem::Sync()
+{
+    lock->Acquire();
+    journal->Commit();
+    lock->Release();
+}
+
+/// List all the files in the current directory.
 void
 FileSystem::List()
 {
+    lock->Acquire();
+    OpenFile  *file = OpenDirectoryFile(currentThread->GetCurrentDirectory());
     Directory *directory = new Directory(NUM_DIR_ENTRIES);
 
-    directory->FetchFrom(directoryFile);
+    directory->FetchFrom(file);
     directory->List();
     delete directory;
+    CloseDirectoryFile(file);
+    lock->Release();
 }
 
-static bool
-AddToShadowBitmap(unsigned sector, Bitmap *map)
+static void
+Touch(unsigned sector, CheckState *state)
 {
-    ASSERT(map != nullptr);
-
-    if (map->Test(sector)) {
-        DEBUG('f', "Sector %u was already marked.\n", sector);
-        return false;
-    }
-    map->Mark(sector);
-    DEBUG('f', "Marked sector %u.\n", sector);
-    return true;
+    if (sector < state->low)
+        state->low = sector;
+    if (sector > state->high)
+        state->high = sector;
 }
 
 static bool
@@ -320,22 +842,57 @@ CheckForError(bool value, const char *message)
     return !value;
 }
 
+/// Record that `sector` belongs to the file with header at `header`.
 static bool
-CheckSector(unsigned sector, Bitmap *shadowMap)
+CheckSector(unsigned sector, unsigned header, CheckState *state)
 {
-    bool error = false;
+    ASSERT(state != nullptr);
 
-    error |= CheckForError(sector < NUM_SECTORS, "Sector number too big.\n");
-    error |= CheckForError(AddToShadowBitmap(sector, shadowMap),
-                           "Sector number already used.\n");
-    return error;
+    if (sector >= state->numSectors) {
+        DEBUG('f', "Sector number %u too big.\n", sector);
+        return true;
+    }
+    if (state->owner[sector] != NO_OWNER) {
+        DEBUG('f', "Sector %u already used by file %d.\n",
+              sector, state->owner[sector]);
+        return true;
+    }
+    state->owner[sector] = header;
+    Touch(sector, state);
+    DEBUG('f', "Marked sector %u.\n", sector);
+    return false;
+}
+
+/// Forget every sector of the file with header at `header`.
+static void
+ReleaseSectors(unsigned header, CheckState *state)
+{
+    ASSERT(state != nullptr);
+
+    for (unsigned s = 0; s < state->numSectors; s++)
+        if (state->owner[s] == (int) header) {
+            state->owner[s] = NO_OWNER;
+            Touch(s, state);
+        }
+}
+
+/// Let the files listed by directory `header` be listed again.
+static void
+DetachChildren(unsigned header, CheckState *state)
+{
+    ASSERT(state != nullptr);
+
+    for (unsigned s = 0; s < state->numSectors; s++)
+        if (state->parent[s] == (int) header && s != header)
+            state->parent[s] = -1;
 }
 
 static bool
-CheckFileHeader(const RawFileHeader *rh, unsigned num, Bitmap *shadowMap)
+CheckFileHeader(const FileHeader *h, unsigned num, CheckState *state)
 {
-    ASSERT(rh != nullptr);
+    ASSERT(h != nullptr);
 
+    const RawFileHeader *rh = h->GetRaw();
     bool error = false;
 
     DEBUG('f', "Checking file header %u.  File size: %u bytes, number of sectors: %u.\n",
@@ -343,39 +900,59 @@ CheckFileHeader(const RawFileHeader *rh, unsigned num, Bitmap *shadowMap)
     error |= CheckForError(rh->numSectors >= DivRoundUp(rh->numBytes,
                                                         SECTOR_SIZE),
                            "Sector count not compatible with file size.\n");
-    error |= CheckForError(rh->numSectors < NUM_DIRECT,
+    error |= CheckForError(rh->numSectors <= MAX_FILE_SECTORS,
 		           "Too many blocks.\n");
+    if (error)
+        return error;  // Do not follow index blocks of a broken header.
+    for (unsigned i = 0; i < h->NumIndexSectors(); i++) {
+        unsigned s = h->GetIndexSector(i);
+        error |= CheckSector(s, num, state);
+    }
     for (unsigned i = 0; i < rh->numSectors; i++) {
-        unsigned s = rh->dataSectors[i];
-        error |= CheckSector(s, shadowMap);
+        unsigned s = h->ByteToSector(i * SECTOR_SIZE);
+        error |= CheckSector(s, num, state);
     }
     return error;
 }
 
+/// Compare the free map with the sectors found in use, from `from` and
+/// before `to`, a word at a time.
 static bool
-CheckBitmaps(const Bitmap *freeMap, const Bitmap *shadowMap)
+CheckBitmaps(const Bitmap *freeMap, const CheckState *state,
+             unsigned from, unsigned to)
 {
+    Bitmap *shadowMap = new Bitmap(state->numSectors);
+    for (unsigned s = from; s < to; s++)
+        if (state->owner[s] != NO_OWNER)
+            shadowMap->Mark(s);
+
     bool error = false;
-    for (unsigned i = 0; i < NUM_SECTORS; i++) {
-        DEBUG('f', "Checking sector %u. Original: %u, shadow: %u.\n",
-              i, freeMap->Test(i), shadowMap->Test(i));
-        error |= CheckForError(freeMap->Test(i) == shadowMap->Test(i),
-                               "Inconsistent bitmap.");
+    for (int s = freeMap->FindDifference(shadowMap, from, to); s != -1;
+         s = freeMap->FindDifference(shadowMap, s + 1, to)) {
+        DEBUG('f', "Inconsistent bitmap at sector %d.  Original: %u, "
+                   "shadow: %u.\n", s, freeMap->Test(s), shadowMap->Test(s));
+        error = true;
     }
+    delete shadowMap;
     return error;
 }
 
+static bool CheckFile(unsigned sector, unsigned parent, bool isDirectory,
+                      CheckState *state);
+
 static bool
-CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
+CheckDirectory(const RawDirectory *rd, unsigned sector, unsigned parent,
+               CheckState *state)
 {
     ASSERT(rd != nullptr);
-    ASSERT(shadowMap != nullptr);
+    ASSERT(state != nullptr);
 
     bool error = false;
+    bool hasParent = false;
     unsigned nameCount = 0;
-    const char *knownNames[NUM_DIR_ENTRIES];
+    const char **knownNames = new const char * [rd->tableSize];
 
-    for (unsigned i = 0; i < NUM_DIR_ENTRIES; i++) {
+    for (unsigned i = 0; i < rd->tableSize; i++) {
         DEBUG('f', "Checking direntry: %u.\n", i);
         const DirectoryEntry *e = &rd->table[i];
 
@@ -385,6 +962,14 @@ CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
                 error = true;
             }
 
+            // Lookups probe from the entry the name hashes to, and stop at
+            // the first one not in use.
+            bool reachable = true;
+            for (unsigned j = HashFileName(e->name) % rd->tableSize; j != i;
+                 j = (j + 1) % rd->tableSize)
+                reachable &= rd->table[j].inUse;
+            error |= CheckForError(reachable, "Unreachable directory entry.");
+
             // Check for repeated filenames.
             DEBUG('f', "Checking for repeated names.  Name count: %u.\n",
                   nameCount);
@@ -404,74 +989,254 @@ CheckDirectory(const RawDirectory *rd, Bitmap *shadowMap)
                 nameCount++;
             }
 
-            // Check sector.
-            error |= CheckSector(e->sector, shadowMap);
+            // The parent entry points to a directory already checked.
+            if (strcmp(e->name, PARENT_DIRECTORY_NAME) == 0) {
+                hasParent = true;
+                error |= CheckForError(e->isDirectory && e->sector == parent,
+                                       "Bad parent directory entry.");
+                continue;
+            }
+
+            // A file still owning its header, and not listed anywhere yet,
+            // was checked before and did not change since.
+            if (e->sector < state->numSectors
+                  && state->owner[e->sector] == (int) e->sector
+                  && state->parent[e->sector] == -1
+                  && state->isDirectory[e->sector] == e->isDirectory) {
+                state->parent[e->sector] = sector;
+                continue;
+            }
 
-            // Check file header.
-            FileHeader *h = new FileHeader;
-            const RawFileHeader *rh = h->GetRaw();
-            h->FetchFrom(e->sector);
-            error |= CheckFileHeader(rh, e->sector, shadowMap);
-            delete h;
+            error |= CheckFile(e->sector, sector, e->isDirectory, state);
         }
     }
+    error |= CheckForError(hasParent, "Missing parent directory entry.");
+    delete [] knownNames;
+    return error;
+}
+
+/// Check the file with header at `sector`, listed by directory `parent`,
+/// and everything below it if it is a directory.
+static bool
+CheckFile(unsigned sector, unsigned parent, bool isDirectory,
+          CheckState *state)
+{
+    ASSERT(state != nullptr);
+
+    if (CheckSector(sector, sector, state))
+        return true;
+    state->parent[sector] = parent;
+    state->isDirectory[sector] = isDirectory;
+
+    FileHeader *h = new FileHeader;
+    const RawFileHeader *rh = h->GetRaw();
+    if (!h->FetchFrom(sector)) {
+        DEBUG('f', "Broken file header at sector %u.\n", sector);
+        delete h;
+        return true;  // Do not follow anything it points to.
+    }
+    bool error = CheckFileHeader(h, sector, state);
+    if (sector == FREE_MAP_SECTOR) {
+        unsigned size = superBlock->GetFreeMapSize();
+        DEBUG('f', "  File size: %u bytes, expected %u bytes.\n"
+                   "  Number of sectors: %u, expected %u.\n",
+              rh->numBytes, size,
+              rh->numSectors, DivRoundUp(size, SECTOR_SIZE));
+        error |= CheckForError(rh->numBytes == size,
+                               "Bad bitmap header: wrong file size.\n");
+        error |= CheckForError(
+            rh->numSectors == DivRoundUp(size, SECTOR_SIZE),
+            "Bad bitmap header: wrong number of sectors.\n");
+    }
+    delete h;
+
+    if (isDirectory && !error) {
+        DEBUG('f', "Checking directory at sector %u.\n", sector);
+        OpenFile  *file = new OpenFile(sector, true);
+        Directory *dir = new Directory(NUM_DIR_ENTRIES);
+        dir->FetchFrom(file);
+        error |= CheckDirectory(dir->GetRaw(), sector, parent, state);
+        delete dir;
+        delete file;
+    }
     return error;
 }
 
+/// Check the file system from scratch.
+///
+/// Every file header is read and its sectors recorded, so that the sectors
+/// found in use can be compared with the free map.  What is found is kept
+/// for `CheckChanges`.
 bool
 FileSystem::Check()
+{
+    lock->Acquire();
+    bool ok = DoCheck();
+    lock->Release();
+    return ok;
+}
+
+bool
+FileSystem::DoCheck()
 {
     DEBUG('f', "Performing filesystem check\n");
+    CheckState *state = checkState;
     bool error = false;
 
-    Bitmap *shadowMap = new Bitmap(NUM_SECTORS);
-    shadowMap->Mark(FREE_MAP_SECTOR);
-    shadowMap->Mark(DIRECTORY_SECTOR);
+    delete journal->TakeChanges();
+    for (unsigned s = 0; s < numSectors; s++) {
+        state->owner[s] = NO_OWNER;
+        state->parent[s] = -1;
+        state->isDirectory[s] = false;
+    }
+    state->low = numSectors;
+    state->high = 0;
+    state->owner[SUPER_BLOCK_SECTOR] = SUPER_BLOCK_SECTOR;
+    state->parent[SUPER_BLOCK_SECTOR] = SUPER_BLOCK_SECTOR;
+    unsigned journalSector = superBlock->GetJournalSector();
+    for (unsigned i = 0; i < JOURNAL_SIZE; i++)
+        state->owner[journalSector + i] = journalSector;
+    state->parent[journalSector] = journalSector;
 
     DEBUG('f', "Checking bitmap's file header.\n");
-
-    FileHeader *bitH = new FileHeader;
-    const RawFileHeader *bitRH = bitH->GetRaw();
-    bitH->FetchFrom(FREE_MAP_SECTOR);
-    DEBUG('f', "  File size: %u bytes, expected %u bytes.\n"
-               "  Number of sectors: %u, expected %u.\n",
-          bitRH->numBytes, FREE_MAP_FILE_SIZE,
-          bitRH->numSectors, FREE_MAP_FILE_SIZE / SECTOR_SIZE);
-    error |= CheckForError(bitRH->numBytes == FREE_MAP_FILE_SIZE,
-                           "Bad bitmap header: wrong file size.\n");
-    error |= CheckForError(bitRH->numSectors == FREE_MAP_FILE_SIZE / SECTOR_SIZE,
-                           "Bad bitmap header: wrong number of sectors.\n");
-    error |= CheckFileHeader(bitRH, FREE_MAP_SECTOR, shadowMap);
-    delete bitH;
+    error |= CheckFile(FREE_MAP_SECTOR, FREE_MAP_SECTOR, false, state);
 
     DEBUG('f', "Checking directory.\n");
-
-    FileHeader *dirH = new FileHeader;
-    const RawFileHeader *dirRH = dirH->GetRaw();
-    dirH->FetchFrom(DIRECTORY_SECTOR);
-    error |= CheckFileHeader(dirRH, DIRECTORY_SECTOR, shadowMap);
-    delete dirH;
-
-    Bitmap *freeMap = new Bitmap(NUM_SECTORS);
-    freeMap->FetchFrom(freeMapFile);
-    Directory *dir = new Directory(NUM_DIR_ENTRIES);
-    const RawDirectory *rdir = dir->GetRaw();
-    dir->FetchFrom(directoryFile);
-    error |= CheckDirectory(rdir, shadowMap);
-    delete dir;
+    error |= CheckFile(DIRECTORY_SECTOR, DIRECTORY_SECTOR, true, state);
 
     // The two bitmaps should match.
     DEBUG('f', "Checking bitmap consistency.\n");
-    error |= CheckBitmaps(freeMap, shadowMap);
-    delete shadowMap;
-    delete freeMap;
+    Bitmap *diskMap = new Bitmap(numSectors);
+    diskMap->FetchFrom(freeMapFile);
+    error |= CheckBitmaps(diskMap, state, 0, numSectors);
+    delete diskMap;
+
+    DEBUG('f', error ? "Filesystem check failed.\n"
+                     : "Filesystem check succeeded.\n");
+    state->valid = !error;
+    return !error;
+}
 
-    DEBUG('f', error ? "Filesystem check succeeded.\n"
-                     : "Filesystem check failed.\n");
+/// Check only what changed since the last check, as recorded by the
+/// journal: headers written or freed, and directories whose entries
+/// changed.  Files listed where they were, and not written to, are taken
+/// to be as good as the last time; only the region of the free map that
+/// covers the sectors looked at is compared.
+///
+/// A full check is done if the last one failed, or there was none.
+bool
+FileSystem::CheckChanges()
+{
+    lock->Acquire();
+    CheckState *state = checkState;
+    if (!state->valid) {
+        bool ok = DoCheck();
+        lock->Release();
+        return ok;
+    }
+    DEBUG('f', "Performing incremental filesystem check\n");
+    bool error = false;
+    state->low = numSectors;
+    state->high = 0;
+
+    // Find the files owning the sectors that changed.
+    Bitmap *changed = journal->TakeChanges();
+    Bitmap *affected = new Bitmap(numSectors);
+    for (unsigned s = 0; s < numSectors; s++)
+        if (changed->Test(s)) {
+            Touch(s, state);
+            if (state->owner[s] != NO_OWNER)
+                affected->Mark(state->owner[s]);
+        }
 
+    // Bits of the free map that were written have to be compared too.
+    if (affected->Test(FREE_MAP_SECTOR)) {
+        FileHeader *h = new FileHeader;
+        h->FetchFrom(FREE_MAP_SECTOR);  // Left empty if broken.
+        unsigned mapSectors = h->GetRaw()->numSectors;
+        unsigned maxSectors
+          = DivRoundUp(superBlock->GetFreeMapSize(), SECTOR_SIZE);
+        if (mapSectors > maxSectors)
+            mapSectors = maxSectors;  // Broken, and caught below.
+        for (unsigned i = 0; i < mapSectors; i++)
+            if (changed->Test(h->ByteToSector(i * SECTOR_SIZE))) {
+                unsigned first = i * SECTOR_SIZE * BITS_IN_BYTE;
+                unsigned last = first + SECTOR_SIZE * BITS_IN_BYTE - 1;
+                if (first >= numSectors)
+                    continue;
+                Touch(first, state);
+                Touch(last < numSectors ? last : numSectors - 1, state);
+            }
+        delete h;
+    }
+    delete changed;
+
+    // Forget what they owned, and let the directories among them list
+    // their files anew.
+    for (unsigned h = 0; h < numSectors; h++)
+        if (affected->Test(h)) {
+            ReleaseSectors(h, state);
+            if (state->isDirectory[h])
+                DetachChildren(h, state);
+        }
+
+    // Check them again, starting from those whose directory did not change;
+    // the rest are reached from their directory.
+    for (unsigned h = 0; h < numSectors; h++) {
+        int parent = state->parent[h];
+        if (affected->Test(h) && parent != -1
+              && ((unsigned) parent == h || !affected->Test(parent)))
+            error |= CheckFile(h, parent, state->isDirectory[h], state);
+    }
+    delete affected;
+
+    // Files not listed anymore, and still holding sectors, are lost.
+    for (bool found = true; found;) {
+        found = false;
+        for (unsigned h = 0; h < numSectors; h++)
+            if (state->owner[h] == (int) h && state->parent[h] == -1) {
+                DEBUG('f', "File %u is not listed anywhere.\n", h);
+                ReleaseSectors(h, state);
+                if (state->isDirectory[h])
+                    DetachChildren(h, state);
+                found = true;
+            }
+    }
+
+    if (state->low <= state->high) {
+        DEBUG('f', "Checking bitmap consistency, sectors %u to %u.\n",
+              state->low, state->high);
+        Bitmap *diskMap = new Bitmap(numSectors);
+        diskMap->FetchFrom(freeMapFile);
+        error |= CheckBitmaps(diskMap, state, state->low, state->high + 1);
+        delete diskMap;
+    }
+
+    DEBUG('f', error ? "Filesystem check failed.\n"
+                     : "Filesystem check succeeded.\n");
+    state->valid = !error;
+    lock->Release();
     return !error;
 }
 
+static void
+BackgroundCheck(void *arg)
+{
+    FileSystem *fs = (FileSystem *) arg;
+    if (!fs->Check())
+        printf("File system check failed.\n");
+}
+
+/// Check the file system from a thread of its own, so that the caller can
+/// go on meanwhile.  Other operations on the file system wait until the
+/// check is over.
+void
+FileSystem::CheckInBackground()
+{
+    Thread *t = new Thread("file system check");
+    t->Fork(BackgroundCheck, this);
+}
+
 /// Print everything about the file system:
 /// * the contents of the bitmap;
 /// * the contents of the directory;
@@ -481,23 +1246,29 @@ FileSystem::Check()
 void
 FileSystem::Print()
 {
+    lock->Acquire();
     FileHeader *bitHeader = new FileHeader;
     FileHeader *dirHeader = new FileHeader;
-    Bitmap     *freeMap   = new Bitmap(NUM_SECTORS);
     Directory  *directory = new Directory(NUM_DIR_ENTRIES);
 
+    printf("--------------------------------\n");
+    superBlock->Print();
+
     printf("--------------------------------\n"
            "Bit map file header:\n\n");
-    bitHeader->FetchFrom(FREE_MAP_SECTOR);
-    bitHeader->Print();
+    if (bitHeader->FetchFrom(FREE_MAP_SECTOR))
+        bitHeader->Print();
+    else
+        printf("Broken file header.\n");
 
     printf("--------------------------------\n"
            "Directory file header:\n\n");
-    dirHeader->FetchFrom(DIRECTORY_SECTOR);
-    dirHeader->Print();
+    if (dirHeader->FetchFrom(DIRECTORY_SECTOR))
+        dirHeader->Print();
+    else
+        printf("Broken file header.\n");
 
     printf("--------------------------------\n");
-    freeMap->FetchFrom(freeMapFile);
     freeMap->Print();
 
     printf("--------------------------------\n");
@@ -507,6 +1278,6 @@ FileSystem::Print()
 
     delete bitHeader;
     delete dirHeader;
-    delete freeMap;
     delete directory;
+    lock->Release();
 }
@@ -39,6 +39,11 @@
 #include "open_file.hh"
 
 
+class Bitmap;
+struct CheckState;
+class Lock;
+class NameCache;
+
 #ifdef FILESYS_STUB  // Temporarily implement file system calls as calls to
                      // UNIX, until the real file system implementation is
                      // available.
@@ -76,9 +81,34 @@ public:
         return Unlink(name) == 0;
     }
 
+    // Directories are only supported by the real file system.
+
+    bool MakeDirectory(const char *path)
+    {
+        return false;
+    }
+
+    bool ChangeDirectory(const char *path)
+    {
+        return false;
+    }
+
+    int ListDirectory(const char *path, char *buffer, unsigned size)
+    {
+        return -1;
+    }
+
 };
 
 #else  // FILESYS
+
+/// Sectors containing the file headers for the bitmap of free sectors, and
+/// the root directory.  These file headers are placed in well-known
+/// sectors, right after the superblock, so that they can be located on
+/// boot-up.
+static const unsigned FREE_MAP_SECTOR = 1;
+static const unsigned DIRECTORY_SECTOR = 2;
+
 class FileSystem {
 public:
 
@@ -100,20 +130,88 @@ public:
     /// Delete a file (UNIX `unlink`).
     bool Remove(const char *name);
 
-    /// List all the files in the file system.
+    /// Create a directory (UNIX `mkdir`).
+    bool MakeDirectory(const char *path);
+
+    /// Change the current directory of the running thread (UNIX `chdir`).
+    bool ChangeDirectory(const char *path);
+
+    /// Copy the names in a directory into `buffer`.
+    int ListDirectory(const char *path, char *buffer, unsigned size);
+
+    /// Grow an open file, whose header `hdr` lives in `sector`, to
+    /// `newSize` bytes.
+    bool Extend(FileHeader *hdr, unsigned sector, unsigned newSize);
+
+    /// Make room in an open file, whose header `hdr` lives in `sector`, for
+    /// it to grow to `newSize` bytes.
+    bool Reserve(FileHeader *hdr, unsigned sector, unsigned newSize);
+
+    /// Free the sectors of a removed file, whose header `hdr` lives in
+    /// `sector`.
+    void Deallocate(FileHeader *hdr, unsigned sector);
+
+    /// Drop the reference of a closed regular file to its header, which
+    /// lives in `sector`.
+    void CloseFile(unsigned sector);
+
+    /// Take/drop a reference to the directory at `sector`, on behalf of a
+    /// thread that has it as its current directory.
+
+    void HoldDirectory(unsigned sector);
+    void DropDirectory(unsigned sector);
+
+    /// Make every change so far durable.
+    void Sync();
+
+    /// List all the files in the current directory.
     void List();
 
     /// Check the filesystem.
     bool Check();
 
+    /// Check what changed in the filesystem since the last check.
+    bool CheckChanges();
+
+    /// Check the filesystem from another thread.
+    void CheckInBackground();
+
     /// List all the files and their contents.
     void Print();
 
 private:
     OpenFile *freeMapFile;  ///< Bit map of free disk blocks, represented as a
                             ///< file.
+    Bitmap *freeMap;  ///< In-memory copy of the bit map, kept while Nachos
+                      ///< runs and flushed after every change.
     OpenFile *directoryFile;  ///< “Root” directory -- list of file names,
                               ///< represented as a file.
+    NameCache *nameCache;  ///< Recently looked up names; updated by every
+                           ///< operation that changes a directory.
+    unsigned numSectors;  ///< Size of the disk, from the superblock.
+    Lock *lock;  ///< Serializes operations on names and on the free map.
+    CheckState *checkState;  ///< What the last check found.
+
+    bool AddEntry(const char *path, unsigned initialSize, bool isDirectory);
+
+    bool CanRemoveDirectory(unsigned sector);
+
+    bool DoCheck();
+
+    static bool IsSpecialName(const char *name);
+
+    /// Find the directory holding the last name in `path`.
+    int FindParent(const char *path, char *name);
+
+    /// Find the header of the file named by `path`.
+    int Resolve(const char *path, bool *isDirectory);
+
+    /// Find the header of file `name` in directory `dir`.
+    int Lookup(unsigned dir, const char *name, bool *isDirectory);
+
+    OpenFile *OpenDirectoryFile(unsigned sector);
+
+    void CloseDirectoryFile(OpenFile *file);
 };
 
 #endif
@@ -9,6 +9,14 @@
 /// Perftest
 ///     A stress test for the Nachos file system read and write a really
 ///     really large file in tiny chunks (will not work on baseline system!)
+/// Metadata test
+///     Create and remove lots of small files.
+/// Directory test
+///     Open a file deep down a tree of directories, over and over.
+/// Concurrency test
+///     Read a file from many threads at once, with a writer on the side.
+/// Check test
+///     Check a populated file system, in full and after a few changes.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2018 Docentes de la Universidad Nacional de Rosario.
@@ -16,13 +24,17 @@
 /// limitation of liability and disclaimer of warranty provisions.
 
 
+#include "directory_entry.hh"
 #include "file_system.hh"
 #include "lib/utility.hh"
 #include "machine/disk.hh"
 #include "machine/statistics.hh"
+#include "threads/synch.hh"
 #include "threads/thread.hh"
 #include "threads/system.hh"
 
+#include <time.h>
+
 
 static const unsigned TRANSFER_SIZE = 10;  // Make it small, just to be
                                            // difficult.
@@ -177,3 +189,270 @@ PerformanceTest()
     }
     stats->Print();
 }
+
+
+/// Metadata test
+///
+/// Stress the allocation paths by creating and removing many small files.
+/// Every operation has to look for free sectors in the bitmap and record
+/// the result on disk.
+
+static const unsigned METADATA_ROUNDS = 100;
+static const unsigned METADATA_FILES = 20;
+
+void
+MetadataTest()
+{
+    printf("Creating and removing %u files of %u bytes:\n",
+           METADATA_ROUNDS * METADATA_FILES, SECTOR_SIZE);
+    stats->Print();
+
+    unsigned writesBefore = stats->numDiskWrites;
+    clock_t start = clock();
+    char name[FILE_NAME_MAX_LEN + 1];
+    for (unsigned r = 0; r < METADATA_ROUNDS; r++) {
+        for (unsigned i = 0; i < METADATA_FILES; i++) {
+            snprintf(name, sizeof name, "Meta%u", i);
+            if (!fileSystem->Create(name, SECTOR_SIZE)) {
+                printf("Metadata test: cannot create %s\n", name);
+                return;
+            }
+        }
+        for (unsigned i = 0; i < METADATA_FILES; i++) {
+            snprintf(name, sizeof name, "Meta%u", i);
+            if (!fileSystem->Remove(name)) {
+                printf("Metadata test: unable to remove %s\n", name);
+                return;
+            }
+        }
+    }
+    clock_t end = clock();
+
+    printf("Disk writes per operation: %.2f, host time: %.3f s\n",
+           (double) (stats->numDiskWrites - writesBefore)
+             / (2 * METADATA_ROUNDS * METADATA_FILES),
+           (double) (end - start) / CLOCKS_PER_SEC);
+    stats->Print();
+}
+
+
+/// Directory test
+///
+/// Build a chain of nested directories with a file at the bottom, and open
+/// it many times by its full path.  Once the path has been walked, the
+/// directories on the way should not be read again.
+
+static const unsigned DIRECTORY_DEPTH = 8;
+static const unsigned OPEN_COUNT = 100;
+
+void
+DirectoryTest()
+{
+    char path[PATH_NAME_MAX_LEN + 1] = "";
+    unsigned length = 0;
+
+    printf("Opening a file %u directories deep, %u times:\n",
+           DIRECTORY_DEPTH, OPEN_COUNT);
+    for (unsigned i = 0; i < DIRECTORY_DEPTH; i++) {
+        length += snprintf(&path[length], sizeof path - length, "/Dir%u", i);
+        if (!fileSystem->MakeDirectory(path)) {
+            printf("Directory test: cannot create %s\n", path);
+            return;
+        }
+    }
+    snprintf(&path[length], sizeof path - length, "/%s", FILE_NAME);
+    if (!fileSystem->Create(path, 0)) {
+        printf("Directory test: cannot create %s\n", path);
+        return;
+    }
+
+    unsigned readsBefore = stats->numDiskReads;
+    for (unsigned i = 0; i < OPEN_COUNT; i++) {
+        OpenFile *openFile = fileSystem->Open(path);
+        if (openFile == nullptr) {
+            printf("Directory test: unable to open %s\n", path);
+            return;
+        }
+        delete openFile;
+    }
+    printf("Disk reads per open: %.2f\n",
+           (double) (stats->numDiskReads - readsBefore) / OPEN_COUNT);
+
+    // Tear everything down, deepest first.
+    for (;;) {
+        if (!fileSystem->Remove(path)) {
+            printf("Directory test: unable to remove %s\n", path);
+            return;
+        }
+        char *slash = strrchr(path, '/');
+        if (slash == path)
+            break;
+        *slash = '\0';
+    }
+    if (!fileSystem->Check())
+        printf("Directory test: file system check failed\n");
+    stats->Print();
+}
+
+
+/// Concurrency test
+///
+/// Several threads read the same file while another one keeps rewriting
+/// it, each through its own `OpenFile`.  It runs twice: first relying only
+/// on the locks of the file system, then wrapping every access in a single
+/// global lock, as if the file system had no finer locking.
+
+static const unsigned CONCURRENT_READERS = 4;
+static const unsigned CONCURRENT_ROUNDS = 10;
+static const unsigned CONCURRENT_FILE_SIZE = 8 * SECTOR_SIZE;
+
+static Lock *globalLock;  // Null when testing the file system locks.
+
+static void
+ConcurrentAccess(void *arg)
+{
+    bool writer = arg != nullptr;
+    OpenFile *openFile = fileSystem->Open(FILE_NAME);
+    ASSERT(openFile != nullptr);
+
+    char buffer[SECTOR_SIZE];
+    memset(buffer, writer ? 'w' : 0, sizeof buffer);
+    for (unsigned r = 0; r < CONCURRENT_ROUNDS; r++) {
+        for (unsigned pos = 0; pos < CONCURRENT_FILE_SIZE;
+             pos += SECTOR_SIZE) {
+            if (globalLock != nullptr)
+                globalLock->Acquire();
+            int numBytes = writer
+              ? openFile->WriteAt(buffer, SECTOR_SIZE, pos)
+              : openFile->ReadAt(buffer, SECTOR_SIZE, pos);
+            if (globalLock != nullptr)
+                globalLock->Release();
+            ASSERT(numBytes == (int) SECTOR_SIZE);
+        }
+    }
+    delete openFile;
+}
+
+static void
+RunConcurrently(const char *title)
+{
+    static const char *names[CONCURRENT_READERS + 1] = {
+        "writer", "reader 1", "reader 2", "reader 3", "reader 4"
+    };
+    Thread *threads[CONCURRENT_READERS + 1];
+
+    unsigned long ticksBefore = stats->totalTicks;
+    unsigned readsBefore = stats->numDiskReads;
+    for (unsigned i = 0; i <= CONCURRENT_READERS; i++) {
+        threads[i] = new Thread(names[i], true);
+        threads[i]->Fork(ConcurrentAccess, i == 0 ? (void *) 1 : nullptr);
+    }
+    for (unsigned i = 0; i <= CONCURRENT_READERS; i++)
+        threads[i]->Join();
+    printf("%s: %lu ticks, %u disk reads\n", title,
+           (unsigned long) (stats->totalTicks - ticksBefore),
+           stats->numDiskReads - readsBefore);
+}
+
+void
+ConcurrencyTest()
+{
+    static_assert(CONCURRENT_READERS == 4, "Thread names must match.");
+
+    printf("%u readers and 1 writer on a %u byte file, %u times:\n",
+           CONCURRENT_READERS, CONCURRENT_FILE_SIZE, CONCURRENT_ROUNDS);
+    if (!fileSystem->Create(FILE_NAME, CONCURRENT_FILE_SIZE)) {
+        printf("Concurrency test: cannot create %s\n", FILE_NAME);
+        return;
+    }
+
+    globalLock = nullptr;
+    RunConcurrently("Per-file locks");
+    globalLock = new Lock("global file system lock");
+    RunConcurrently("Global lock");
+    delete globalLock;
+    globalLock = nullptr;
+
+    if (!fileSystem->Remove(FILE_NAME)) {
+        printf("Concurrency test: unable to remove %s\n", FILE_NAME);
+        return;
+    }
+    if (!fileSystem->Check())
+        printf("Concurrency test: file system check failed\n");
+    stats->Print();
+}
+
+
+/// Check test
+///
+/// Fill a few directories with files, check the whole file system, change
+/// a couple of files and check again only what changed.  Everything is
+/// removed at the end, so that the test can be run again on the same disk.
+
+static const unsigned CHECK_DIRECTORIES = 8;
+static const unsigned CHECK_FILES = 10;
+
+void
+CheckTest()
+{
+    char name[PATH_NAME_MAX_LEN + 1];
+
+    printf("Checking %u directories of %u files:\n",
+           CHECK_DIRECTORIES, CHECK_FILES);
+    for (unsigned i = 0; i < CHECK_DIRECTORIES; i++) {
+        snprintf(name, sizeof name, "Check%u", i);
+        if (!fileSystem->MakeDirectory(name)) {
+            printf("Check test: cannot create %s\n", name);
+            return;
+        }
+        for (unsigned j = 0; j < CHECK_FILES; j++) {
+            snprintf(name, sizeof name, "Check%u/File%u", i, j);
+            if (!fileSystem->Create(name, SECTOR_SIZE)) {
+                printf("Check test: cannot create %s\n", name);
+                return;
+            }
+        }
+    }
+
+    unsigned readsBefore = stats->numDiskReads;
+    bool ok = fileSystem->Check();
+    printf("Full check: %s, %u disk reads\n", ok ? "passed" : "failed",
+           stats->numDiskReads - readsBefore);
+
+    snprintf(name, sizeof name, "Check0/File0");
+    fileSystem->Remove(name);
+    snprintf(name, sizeof name, "Check1/New");
+    fileSystem->Create(name, 2 * SECTOR_SIZE);
+    readsBefore = stats->numDiskReads;
+    ok = fileSystem->CheckChanges();
+    printf("Incremental check: %s, %u disk reads\n",
+           ok ? "passed" : "failed", stats->numDiskReads - readsBefore);
+
+    readsBefore = stats->numDiskReads;
+    ok = fileSystem->CheckChanges();
+    printf("Check with no changes: %s, %u disk reads\n",
+           ok ? "passed" : "failed", stats->numDiskReads - readsBefore);
+
+    snprintf(name, sizeof name, "Check1/New");
+    if (!fileSystem->Remove(name)) {
+        printf("Check test: unable to remove %s\n", name);
+        return;
+    }
+    for (unsigned i = 0; i < CHECK_DIRECTORIES; i++) {
+        for (unsigned j = i == 0 ? 1 : 0; j < CHECK_FILES; j++) {
+            snprintf(name, sizeof name, "Check%u/File%u", i, j);
+            if (!fileSystem->Remove(name)) {
+                printf("Check test: unable to remove %s\n", name);
+                return;
+            }
+        }
+        snprintf(name, sizeof name, "Check%u", i);
+        if (!fileSystem->Remove(name)) {
+            printf("Check test: unable to remove %s\n", name);
+            return;
+        }
+    }
+    if (!fileSystem->Check())
+        printf("Check test: file system check failed\n");
+    stats->Print();
+}
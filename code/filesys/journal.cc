@@ -0,0 +1,281 @@
+/// Routines to manage the metadata journal.
+///
+/// A commit writes, in this order:
+/// 1. the pending sectors, to the log;
+/// 2. the map of their homes;
+/// 3. the log header, with the number of sectors -- the commit point;
+/// 4. the pending sectors, to their homes;
+/// 5. the log header again, saying the log is empty.
+///
+/// A crash before 3 loses the group; a crash after it has the group
+/// replayed at the next mount.  Step 5 keeps old groups from being
+/// replayed over sectors reused since.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "journal.hh"
+#include "lib/bitmap.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+/// Operations committed together, at most.
+static const unsigned JOURNAL_GROUP_SIZE = 64;
+
+Journal::Journal(bool format)
+{
+    lock = new Lock("journal");
+    numSectors = superBlock->GetNumSectors();
+    firstSector = superBlock->GetJournalSector();
+    slots = new int [numSectors];
+    for (unsigned i = 0; i < numSectors; i++)
+        slots[i] = -1;
+    numPending = 0;
+    numOperations = 0;
+    sequence = 0;
+    changed = new Bitmap(numSectors);
+
+    if (format) {
+        RawJournalHeader header;
+        memset(&header, 0, sizeof header);
+        header.magic = JOURNAL_MAGIC;
+        synchDisk->WriteSector(firstSector, (char *) &header);
+    } else
+        Replay();
+}
+
+Journal::~Journal()
+{
+    Commit();
+    delete changed;
+    delete [] slots;
+    delete lock;
+}
+
+/// A pending sector is copied with the lock held, as a time slice may end
+/// in the middle and a commit reuse the slot.  The disk is read without
+/// it: a sector that is not pending is up to date at home.
+///
+/// * `sector` is the disk sector to read.
+/// * `data` is the buffer to hold its contents.
+void
+Journal::ReadSector(unsigned sector, char *data)
+{
+    ASSERT(sector < numSectors);
+    ASSERT(data != nullptr);
+
+    lock->Acquire();
+    bool logged = slots[sector] != -1;
+    if (logged)
+        memcpy(data, pending[slots[sector]], SECTOR_SIZE);
+    lock->Release();
+    if (!logged)
+        synchDisk->ReadSector(sector, data);
+}
+
+/// The operation made room for the sector when it began.
+///
+/// * `sector` is the disk sector to write.
+/// * `data` is the new contents of the sector.
+void
+Journal::WriteMetadata(unsigned sector, const char *data)
+{
+    ASSERT(sector < numSectors);
+    ASSERT(data != nullptr);
+
+    lock->Acquire();
+    changed->Mark(sector);
+    if (slots[sector] == -1) {
+        ASSERT(numPending < JOURNAL_CAPACITY);
+        slots[sector] = numPending;
+        homes[numPending++] = sector;
+    }
+    memcpy(pending[slots[sector]], data, SECTOR_SIZE);
+    lock->Release();
+}
+
+/// * `sector` is the disk sector to write.
+/// * `data` is the new contents of the sector.
+void
+Journal::WriteData(unsigned sector, const char *data)
+{
+    ASSERT(sector < numSectors);
+    ASSERT(data != nullptr);
+
+    lock->Acquire();
+    bool logged = slots[sector] != -1;
+    if (logged)
+        memcpy(pending[slots[sector]], data, SECTOR_SIZE);
+    lock->Release();
+    if (!logged)
+        synchDisk->WriteSector(sector, data);
+}
+
+/// The last slot is moved into the one left empty.
+///
+/// * `sector` is the disk sector freed.
+void
+Journal::Forget(unsigned sector)
+{
+    ASSERT(sector < numSectors);
+
+    lock->Acquire();
+    changed->Mark(sector);
+    int slot = slots[sector];
+    if (slot != -1) {
+        unsigned last = --numPending;
+        if ((unsigned) slot != last) {
+            homes[slot] = homes[last];
+            slots[homes[slot]] = slot;
+            memcpy(pending[slot], pending[last], SECTOR_SIZE);
+        }
+        slots[sector] = -1;
+    }
+    lock->Release();
+}
+
+Bitmap *
+Journal::TakeChanges()
+{
+    lock->Acquire();
+    Bitmap *result = changed;
+    changed = new Bitmap(numSectors);
+    lock->Release();
+    return result;
+}
+
+/// * `count` is the most sectors the operation may write, whether they are
+///   pending already or not.
+void
+Journal::Begin(unsigned count)
+{
+    ASSERT(count <= JOURNAL_CAPACITY);
+
+    lock->Acquire();
+    if (numPending + count > JOURNAL_CAPACITY)
+        DoCommit();
+    lock->Release();
+}
+
+void
+Journal::Complete()
+{
+    lock->Acquire();
+    numOperations++;
+    if (numOperations >= JOURNAL_GROUP_SIZE)
+        DoCommit();
+    lock->Release();
+}
+
+void
+Journal::Commit()
+{
+    lock->Acquire();
+    DoCommit();
+    lock->Release();
+}
+
+/// The caller must hold `lock`.
+void
+Journal::DoCommit()
+{
+    numOperations = 0;
+    if (numPending == 0)
+        return;
+
+    DEBUG('f', "Committing %u sectors to the journal.\n", numPending);
+    sequence++;
+    for (unsigned i = 0; i < numPending; i++)
+        synchDisk->WriteSector(firstSector + 1 + JOURNAL_MAP_SECTORS + i,
+                               pending[i]);
+
+    RawJournalMap map;
+    memset(&map, 0, sizeof map);
+    memcpy(map.homes, homes, numPending * sizeof (unsigned));
+    unsigned mapSectors
+      = DivRoundUp(numPending * (unsigned) sizeof (unsigned), SECTOR_SIZE);
+    for (unsigned i = 0; i < mapSectors; i++)
+        synchDisk->WriteSector(firstSector + 1 + i,
+                               (char *) &map + i * SECTOR_SIZE);
+
+    RawJournalHeader header;
+    memset(&header, 0, sizeof header);
+    header.magic = JOURNAL_MAGIC;
+    header.sequence = sequence;
+    header.numSectors = numPending;
+    header.checksum = Checksum(homes, pending[0], numPending, sequence);
+    synchDisk->WriteSector(firstSector, (char *) &header);
+
+    for (unsigned i = 0; i < numPending; i++) {
+        synchDisk->WriteSector(homes[i], pending[i]);
+        slots[homes[i]] = -1;
+    }
+    numPending = 0;
+
+    header.numSectors = 0;
+    header.checksum = 0;
+    synchDisk->WriteSector(firstSector, (char *) &header);
+}
+
+void
+Journal::Replay()
+{
+    RawJournalHeader header;
+    synchDisk->ReadSector(firstSector, (char *) &header);
+    if (header.magic != JOURNAL_MAGIC) {
+        DEBUG('f', "No journal found; the disk should be formatted.\n");
+        return;
+    }
+    sequence = header.sequence;
+    if (header.numSectors == 0)
+        return;
+    if (header.numSectors > JOURNAL_CAPACITY) {
+        DEBUG('f', "Bad journal header, ignoring it.\n");
+        return;
+    }
+
+    // Nothing is pending yet, so `pending` can hold the log.
+    RawJournalMap map;
+    for (unsigned i = 0; i < JOURNAL_MAP_SECTORS; i++)
+        synchDisk->ReadSector(firstSector + 1 + i,
+                              (char *) &map + i * SECTOR_SIZE);
+    for (unsigned i = 0; i < header.numSectors; i++)
+        synchDisk->ReadSector(firstSector + 1 + JOURNAL_MAP_SECTORS + i,
+                              pending[i]);
+    if (Checksum(map.homes, pending[0], header.numSectors, sequence)
+          != header.checksum) {
+        DEBUG('f', "Journal checksum mismatch, ignoring it.\n");
+        return;
+    }
+
+    DEBUG('f', "Replaying %u sectors of commit %u.\n",
+          header.numSectors, sequence);
+    for (unsigned i = 0; i < header.numSectors; i++) {
+        ASSERT(map.homes[i] < firstSector);
+        synchDisk->WriteSector(map.homes[i], pending[i]);
+    }
+    header.numSectors = 0;
+    header.checksum = 0;
+    synchDisk->WriteSector(firstSector, (char *) &header);
+}
+
+unsigned
+Journal::Checksum(const unsigned *homes, const char *sectors,
+                  unsigned numSectors, unsigned sequence)
+{
+    ASSERT(homes != nullptr);
+    ASSERT(sectors != nullptr);
+
+    unsigned sum = sequence;
+    for (unsigned i = 0; i < numSectors; i++)
+        sum = (sum << 1 | sum >> 31) ^ homes[i];
+    const unsigned *words = (const unsigned *) sectors;
+    unsigned numWords = numSectors * SECTOR_SIZE / sizeof (unsigned);
+    for (unsigned i = 0; i < numWords; i++)
+        sum = (sum << 1 | sum >> 31) ^ words[i];
+    return sum;
+}
@@ -0,0 +1,115 @@
+/// Data structures to keep the file system metadata consistent across
+/// crashes.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_JOURNAL__HH
+#define NACHOS_FILESYS_JOURNAL__HH
+
+
+#include "raw_journal.hh"
+
+
+class Bitmap;
+class Lock;
+
+/// The following class implements a write-ahead journal for metadata: file
+/// headers, index blocks, directories and the free map.
+///
+/// Metadata sectors are not written in place right away.  They are kept in
+/// memory, where later changes to the same sector are absorbed, until a
+/// whole group of file system operations is done.  Then the group is
+/// committed: every sector goes first to the log at the end of the disk,
+/// then the log header is written (this is the point where the group
+/// becomes durable), and only then are the sectors copied to their homes.
+/// If Nachos stops in the middle, the log is replayed when the disk is
+/// mounted again, so each group is applied either whole or not at all, and
+/// the disk never needs to be checked and repaired.
+///
+/// Each operation says up front how many sectors it may write, and the
+/// group is committed first if they might not fit, so that an operation is
+/// never split between two commits.
+///
+/// The price is that the last group may be lost.  Callers wanting changes
+/// on disk at some point can commit explicitly.
+///
+/// The contents of regular files are written in place, and are not
+/// protected; unless the sector is waiting in the journal, as happens when
+/// it has just been freed by a directory, because replaying the old
+/// contents would then overwrite the new ones.
+///
+/// Every read of the file system goes through the journal too, so that it
+/// sees the sectors that are not home yet.
+///
+/// The journal also remembers which sectors were written as metadata or
+/// freed, so that the file system check can look only at those.
+class Journal {
+public:
+
+    /// Open the journal, replaying whatever was committed and not yet put
+    /// in place, or create an empty one if `format` is true.
+    Journal(bool format);
+
+    /// Commit whatever is pending and close the journal.
+    ~Journal();
+
+    /// Read `sector` into `data`, from the journal if it is pending there.
+    void ReadSector(unsigned sector, char *data);
+
+    /// Write metadata `data` to `sector`, as part of the current group.
+    void WriteMetadata(unsigned sector, const char *data);
+
+    /// Write regular file `data` to `sector`.
+    void WriteData(unsigned sector, const char *data);
+
+    /// Drop `sector`, which has just been freed, from the current group:
+    /// there is no point in writing it anymore.
+    void Forget(unsigned sector);
+
+    /// Note the start of a file system operation that writes at most
+    /// `count` sectors of metadata, committing the group first if they
+    /// might not fit in it.
+    void Begin(unsigned count);
+
+    /// Note the end of a file system operation, and commit the group if it
+    /// is big enough.  Must be called between operations, never inside one.
+    void Complete();
+
+    /// Commit the current group right away.
+    void Commit();
+
+    /// Return the sectors written as metadata or freed since the last call,
+    /// and start recording anew.  The caller must delete the result.
+    Bitmap *TakeChanges();
+
+private:
+    void DoCommit();
+
+    void Replay();
+
+    static unsigned Checksum(const unsigned *homes, const char *sectors,
+                             unsigned numSectors, unsigned sequence);
+
+    Lock *lock;  ///< Protects the pending sectors.
+
+    unsigned numSectors;  ///< Size of the file system.
+    unsigned firstSector;  ///< Where the journal starts.
+
+    /// Slot in `pending` for each sector of the disk, or -1 if the sector is
+    /// not waiting in the journal.
+    int *slots;
+
+    unsigned homes[JOURNAL_CAPACITY];  ///< Sector of each slot.
+    char pending[JOURNAL_CAPACITY][SECTOR_SIZE];
+    unsigned numPending;
+
+    unsigned numOperations;  ///< Operations done since the last commit.
+    unsigned sequence;  ///< Number of the last commit.
+
+    Bitmap *changed;  ///< Sectors changed since the last `TakeChanges`.
+};
+
+
+#endif
@@ -0,0 +1,100 @@
+/// Routines to manage the cache of file names.
+///
+/// Entries are kept in the same format as the directory, so that names are
+/// compared the same way in both places.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "name_cache.hh"
+#include "lib/utility.hh"
+
+
+NameCache::NameCache()
+{
+    for (unsigned i = 0; i < NAME_CACHE_SETS; i++) {
+        for (unsigned j = 0; j < NAME_CACHE_WAYS; j++)
+            table[i][j].entry.inUse = false;
+        victim[i] = 0;
+    }
+}
+
+unsigned
+NameCache::SetFor(unsigned dir, const char *name) const
+{
+    return (HashFileName(name) ^ dir * 2654435761u) % NAME_CACHE_SETS;
+}
+
+const NameCache::CacheEntry *
+NameCache::Lookup(unsigned dir, const char *name) const
+{
+    const CacheEntry *set = table[SetFor(dir, name)];
+    for (unsigned j = 0; j < NAME_CACHE_WAYS; j++)
+        if (set[j].entry.inUse && set[j].dir == dir
+              && !strncmp(set[j].entry.name, name, FILE_NAME_MAX_LEN))
+            return &set[j];
+    return nullptr;
+}
+
+NameCache::CacheEntry *
+NameCache::Lookup(unsigned dir, const char *name)
+{
+    const NameCache *self = this;
+    return const_cast<CacheEntry *>(self->Lookup(dir, name));
+}
+
+/// * `dir` is the sector of the directory to look in.
+/// * `name` is the file name to look up.
+/// * `isDirectory`, if not null, is set to whether the entry found is a
+///   directory.
+int
+NameCache::Find(unsigned dir, const char *name, bool *isDirectory) const
+{
+    ASSERT(name != nullptr);
+
+    const CacheEntry *c = Lookup(dir, name);
+    if (c == nullptr)
+        return -1;
+    DEBUG('f', "Name cache hit for %s in directory %u.\n", name, dir);
+    if (isDirectory != nullptr)
+        *isDirectory = c->entry.isDirectory;
+    return c->entry.sector;
+}
+
+/// * `dir` is the sector of the directory holding the file.
+/// * `name` is the file name to remember.
+/// * `sector` is the disk sector containing the file's header.
+/// * `isDirectory` tells whether the file is a directory.
+void
+NameCache::Insert(unsigned dir, const char *name, unsigned sector,
+                  bool isDirectory)
+{
+    ASSERT(name != nullptr);
+
+    CacheEntry *c = Lookup(dir, name);
+    if (c == nullptr) {
+        unsigned s = SetFor(dir, name);
+        c = &table[s][victim[s]];
+        victim[s] = (victim[s] + 1) % NAME_CACHE_WAYS;
+    }
+    c->dir = dir;
+    c->entry.inUse = true;
+    c->entry.isDirectory = isDirectory;
+    strncpy(c->entry.name, name, FILE_NAME_MAX_LEN);
+    c->entry.name[FILE_NAME_MAX_LEN] = '\0';
+    c->entry.sector = sector;
+}
+
+/// * `dir` is the sector of the directory holding the file.
+/// * `name` is the file name to forget.
+void
+NameCache::Invalidate(unsigned dir, const char *name)
+{
+    ASSERT(name != nullptr);
+
+    CacheEntry *c = Lookup(dir, name);
+    if (c != nullptr)
+        c->entry.inUse = false;
+}
@@ -0,0 +1,66 @@
+/// Data structures to remember where the headers of recently used files
+/// are, for every step of a path.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_NAMECACHE__HH
+#define NACHOS_FILESYS_NAMECACHE__HH
+
+
+#include "directory_entry.hh"
+
+
+/// Number of sets in the cache, and of names each set can hold.
+static const unsigned NAME_CACHE_SETS = 64;
+static const unsigned NAME_CACHE_WAYS = 4;
+
+/// The following class maps a directory and a file name in it to the
+/// sector of the file's header, so that looking up a name that was used
+/// recently needs no disk access.  Directories are identified by the sector
+/// of their own header.
+///
+/// The cache is set associative: each name can only live in the set it
+/// hashes to, and when the set is full, the oldest name in it is evicted.
+/// Only names that exist are cached, so the file system must invalidate a
+/// name whenever the directory entry for it changes.
+class NameCache {
+public:
+
+    /// Initialize an empty cache.
+    NameCache();
+
+    /// Return the sector of the header of file `name` in directory `dir`,
+    /// or -1 if the name is not cached.
+    int Find(unsigned dir, const char *name,
+             bool *isDirectory = nullptr) const;
+
+    /// Remember the entry for file `name` in directory `dir`.
+    void Insert(unsigned dir, const char *name, unsigned sector,
+                bool isDirectory);
+
+    /// Forget about file `name` in directory `dir`, if cached.
+    void Invalidate(unsigned dir, const char *name);
+
+private:
+    struct CacheEntry {
+        unsigned dir;  ///< Directory holding the entry.
+        DirectoryEntry entry;
+    };
+
+    CacheEntry table[NAME_CACHE_SETS][NAME_CACHE_WAYS];
+
+    /// Next way to evict in each set.
+    unsigned victim[NAME_CACHE_SETS];
+
+    /// Return the set where `name` is cached, if anywhere.
+    unsigned SetFor(unsigned dir, const char *name) const;
+
+    /// Return the entry for `name` in `dir`, or null if not cached.
+    CacheEntry *Lookup(unsigned dir, const char *name);
+    const CacheEntry *Lookup(unsigned dir, const char *name) const;
+};
+
+
+#endif
@@ -3,7 +3,20 @@
 /// (in Nachos, by deleting the `OpenFile` data structure).
 ///
 /// Also as in UNIX, for convenience, we keep the file header in memory while
-/// the file is open.
+/// the file is open.  There is a single copy of it, kept by the table of
+/// open files and shared by every `OpenFile` for the same file; each of
+/// them has its own seek position, though.
+///
+/// Writing past the end of the file makes it grow.  New sectors come from
+/// the file system in batches; when a write fits in sectors that are already
+/// reserved, only the in-memory length changes, and the header is written
+/// back when the file is closed for the last time.
+///
+/// Small writes at the implicit position are gathered in a buffer of each
+/// `OpenFile`, so that a program writing a few bytes at a time does not
+/// read and write a sector for each of them.  The buffer goes to the file
+/// in whole sectors when it fills up, and whatever is left when the file is
+/// closed, flushed, read, or written or sought elsewhere.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
@@ -16,21 +29,36 @@
 #include "threads/system.hh"
 
 
+/// Size of the buffer for small writes.  Writes this big or bigger go
+/// straight to the file.
+static const unsigned WRITE_BUFFER_SIZE = 4 * SECTOR_SIZE;
+
 /// Open a Nachos file for reading and writing.  Bring the file header into
-/// memory while the file is open.
+/// memory while the file is open, unless it is open already.
 ///
 /// * `sector` is the location on disk of the file header for this file.
-OpenFile::OpenFile(int sector)
+/// * `isMetadata` tells whether the file is a directory or the free map.
+OpenFile::OpenFile(int sector, bool isMetadata)
 {
-    hdr = new FileHeader;
-    hdr->FetchFrom(sector);
+    hdr = fileTable->Acquire(sector);
+    rwLock = fileTable->GetLock(sector);
+    hdrSector = sector;
     seekPosition = 0;
+    metadata = isMetadata;
+    writeBuffer = nullptr;
+    bufferStart = 0;
+    bufferCount = 0;
 }
 
 /// Close a Nachos file, de-allocating any in-memory data structures.
 OpenFile::~OpenFile()
 {
-    delete hdr;
+    Flush();
+    delete [] writeBuffer;
+    if (metadata)
+        fileTable->Release(hdrSector);  // Part of the operation at hand.
+    else
+        fileSystem->CloseFile(hdrSector);
 }
 
 /// Change the current location within the open file -- the point at which
@@ -40,6 +68,8 @@ OpenFile::~OpenFile()
 void
 OpenFile::Seek(unsigned position)
 {
+    if (position != bufferStart + bufferCount)
+        Flush();
     seekPosition = position;
 }
 
@@ -72,9 +102,76 @@ OpenFile::Write(const char *from, unsigned numBytes)
     ASSERT(from != nullptr);
     ASSERT(numBytes > 0);
 
-    int result = WriteAt(from, numBytes, seekPosition);
-    seekPosition += result;
-    return result;
+    if (metadata || numBytes >= WRITE_BUFFER_SIZE) {
+        int result = WriteAt(from, numBytes, seekPosition);
+        seekPosition += result;
+        return result;
+    }
+
+    // Room for the bytes is made now, while the writer can still be told
+    // that the disk is full, so that flushing them later cannot fail.
+    if (!Reserve(seekPosition + numBytes)) {
+        unsigned room = hdr->ReservedLength();
+        if (room <= seekPosition)
+            return 0;
+        numBytes = room - seekPosition;
+    }
+
+    if (writeBuffer == nullptr)
+        writeBuffer = new char [WRITE_BUFFER_SIZE];
+    if (bufferCount == 0)
+        bufferStart = seekPosition;
+    ASSERT(bufferStart + bufferCount == seekPosition);
+
+    for (unsigned done = 0; done < numBytes;) {
+        unsigned count = WRITE_BUFFER_SIZE - bufferCount;
+        if (count > numBytes - done)
+            count = numBytes - done;
+        memcpy(&writeBuffer[bufferCount], &from[done], count);
+        bufferCount += count;
+        done += count;
+        if (bufferCount == WRITE_BUFFER_SIZE)
+            FlushSectors();
+    }
+    seekPosition += numBytes;
+    return numBytes;
+}
+
+/// `Write` made room for the buffered bytes already, so they all fit.
+void
+OpenFile::Flush()
+{
+    if (bufferCount == 0)
+        return;
+    DEBUG('f', "Flushing %u bytes written at %u.\n", bufferCount, bufferStart);
+    rwLock->AcquireWrite();
+    unsigned numWritten = DoWriteAt(writeBuffer, bufferCount, bufferStart);
+    rwLock->ReleaseWrite();
+    ASSERT(numWritten == bufferCount);
+    bufferCount = 0;
+}
+
+/// The buffer starts wherever the first small write did, but after this
+/// it starts at a sector boundary, so that later flushes need not read
+/// anything.
+void
+OpenFile::FlushSectors()
+{
+    unsigned end = bufferStart + bufferCount;
+    unsigned boundary = DivRoundDown(end, SECTOR_SIZE) * SECTOR_SIZE;
+    if (boundary <= bufferStart) {
+        Flush();
+        return;
+    }
+
+    unsigned count = boundary - bufferStart;
+    rwLock->AcquireWrite();
+    unsigned numWritten = DoWriteAt(writeBuffer, count, bufferStart);
+    rwLock->ReleaseWrite();
+    ASSERT(numWritten == count);
+    memmove(writeBuffer, &writeBuffer[count], end - boundary);
+    bufferStart = boundary;
+    bufferCount = end - boundary;
 }
 
 /// OpenFile::ReadAt/WriteAt
@@ -83,13 +180,41 @@ OpenFile::Write(const char *from, unsigned numBytes)
 /// number of bytes actually written or read, but has no side effects (except
 /// that `Write` modifies the file, of course).
 ///
+/// Readers share the lock of the file, writers hold it alone; the work is
+/// done by `DoReadAt`/`DoWriteAt`.
+
+int
+OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
+{
+    Flush();
+    rwLock->AcquireRead();
+    int result = DoReadAt(into, numBytes, position);
+    rwLock->ReleaseRead();
+    return result;
+}
+
+int
+OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
+{
+    Flush();
+    rwLock->AcquireWrite();
+    int result = DoWriteAt(from, numBytes, position);
+    rwLock->ReleaseWrite();
+    return result;
+}
+
+/// OpenFile::DoReadAt/DoWriteAt
+///
+/// Same as above, with the lock of the file already held.
+///
 /// There is no guarantee the request starts or ends on an even disk sector
 /// boundary; however the disk only knows how to read/write a whole disk
 /// sector at a time.  Thus:
 ///
 /// For ReadAt:
-///     We read in all of the full or partial sectors that are part of the
-///     request, but we only copy the part we are interested in.
+///     We read full sectors straight into the caller's buffer.  Partial
+///     sectors, at most the first and the last, are read into a buffer of
+///     our own, and we only copy the part we are interested in.
 /// For WriteAt:
 ///     We must first read in any sectors that will be partially written, so
 ///     that we do not overwrite the unmodified portion.  We then copy in the
@@ -103,14 +228,13 @@ OpenFile::Write(const char *from, unsigned numBytes)
 ///   read/written.
 
 int
-OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
+OpenFile::DoReadAt(char *into, unsigned numBytes, unsigned position)
 {
     ASSERT(into != nullptr);
     ASSERT(numBytes > 0);
 
     unsigned fileLength = hdr->FileLength();
-    unsigned firstSector, lastSector, numSectors;
-    char *buf;
+    unsigned firstSector, lastSector;
 
     if (position >= fileLength)
         return 0;  // Check request.
@@ -121,68 +245,128 @@ OpenFile::ReadAt(char *into, unsigned numBytes, unsigned position)
 
     firstSector = DivRoundDown(position, SECTOR_SIZE);
     lastSector = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
-    numSectors = 1 + lastSector - firstSector;
-
-    // Read in all the full and partial sectors that we need.
-    buf = new char [numSectors * SECTOR_SIZE];
-    for (unsigned i = firstSector; i <= lastSector; i++)
-        synchDisk->ReadSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                              &buf[(i - firstSector) * SECTOR_SIZE]);
 
-    // Copy the part we want.
-    memcpy(into, &buf[position - firstSector * SECTOR_SIZE], numBytes);
-    delete [] buf;
+    char *to = into;
+    for (unsigned i = firstSector; i <= lastSector; i++) {
+        unsigned sector = hdr->ByteToSector(i * SECTOR_SIZE);
+        unsigned start = i == firstSector ? position % SECTOR_SIZE : 0;
+        unsigned end = i == lastSector
+                       ? position + numBytes - i * SECTOR_SIZE : SECTOR_SIZE;
+        if (start == 0 && end == SECTOR_SIZE)
+            journal->ReadSector(sector, to);
+        else {
+            char buf[SECTOR_SIZE];
+            journal->ReadSector(sector, buf);
+            memcpy(to, &buf[start], end - start);
+        }
+        to += end - start;
+    }
     return numBytes;
 }
 
 int
-OpenFile::WriteAt(const char *from, unsigned numBytes, unsigned position)
+OpenFile::DoWriteAt(const char *from, unsigned numBytes, unsigned position)
 {
     ASSERT(from != nullptr);
     ASSERT(numBytes > 0);
 
     unsigned fileLength = hdr->FileLength();
-    unsigned firstSector, lastSector, numSectors;
+    unsigned start, firstSector, lastSector, numSectors;
     bool firstAligned, lastAligned;
     char *buf;
 
-    if (position >= fileLength)
-        return 0;  // Check request.
-    if (position + numBytes > fileLength)
+    if (position + numBytes > fileLength && !Extend(position + numBytes)) {
+        if (position >= fileLength)
+            return 0;  // No room to grow.
         numBytes = fileLength - position;
-    DEBUG('f', "Writing %u bytes at %u, from file of length %u.\n",
+    }
+    DEBUG('f', "Writing %u bytes at %u, to file of length %u.\n",
           numBytes, position, fileLength);
 
-    firstSector = DivRoundDown(position, SECTOR_SIZE);
+    // Writing past the end leaves a hole between the old end of the file
+    // and `position`; it is filled with zeros as part of this same write.
+    start = position < fileLength ? position : fileLength;
+
+    firstSector = DivRoundDown(start, SECTOR_SIZE);
     lastSector  = DivRoundDown(position + numBytes - 1, SECTOR_SIZE);
     numSectors  = 1 + lastSector - firstSector;
 
     buf = new char [numSectors * SECTOR_SIZE];
 
-    firstAligned = position == firstSector * SECTOR_SIZE;
+    firstAligned = start == firstSector * SECTOR_SIZE;
     lastAligned  = position + numBytes == (lastSector + 1) * SECTOR_SIZE;
 
     // Read in first and last sector, if they are to be partially modified.
+    // Sectors that were past the old end of the file hold nothing worth
+    // keeping.  Reads stop at the end of the file, so the last sector is
+    // cleared first: whatever is past the end goes to disk as zeros.
+    memset(&buf[(numSectors - 1) * SECTOR_SIZE], 0, SECTOR_SIZE);
     if (!firstAligned)
-        ReadAt(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
-    if (!lastAligned && (firstSector != lastSector || firstAligned))
-        ReadAt(&buf[(lastSector - firstSector) * SECTOR_SIZE],
+        DoReadAt(buf, SECTOR_SIZE, firstSector * SECTOR_SIZE);
+    if (!lastAligned && (firstSector != lastSector || firstAligned)
+          && lastSector * SECTOR_SIZE < fileLength)
+        DoReadAt(&buf[(lastSector - firstSector) * SECTOR_SIZE],
                SECTOR_SIZE, lastSector * SECTOR_SIZE);
 
     // Copy in the bytes we want to change.
+    memset(&buf[start - firstSector * SECTOR_SIZE], 0, position - start);
     memcpy(&buf[position - firstSector * SECTOR_SIZE], from, numBytes);
 
     // Write modified sectors back.
-    for (unsigned i = firstSector; i <= lastSector; i++)
-        synchDisk->WriteSector(hdr->ByteToSector(i * SECTOR_SIZE),
-                               &buf[(i - firstSector) * SECTOR_SIZE]);
+    for (unsigned i = firstSector; i <= lastSector; i++) {
+        unsigned    sector = hdr->ByteToSector(i * SECTOR_SIZE);
+        const char *data = &buf[(i - firstSector) * SECTOR_SIZE];
+        if (metadata)
+            journal->WriteMetadata(sector, data);
+        else
+            journal->WriteData(sector, data);
+    }
     delete [] buf;
     return numBytes;
 }
 
-/// Return the number of bytes in the file.
+/// Grow the file to `newLength` bytes.  If the sectors already reserved for
+/// the file are enough, only the in-memory header changes; otherwise the
+/// file system allocates a new batch and writes back the header and the
+/// free map.  Return false if the disk is full.
+///
+/// * `newLength` is the new length of the file.
+bool
+OpenFile::Extend(unsigned newLength)
+{
+    if (hdr->ExtendInPlace(newLength)) {
+        fileTable->MarkDirty(hdrSector);
+        return true;
+    }
+    return fileSystem->Extend(hdr, hdrSector, newLength);
+}
+
+/// Make sure the file has data sectors for `newLength` bytes, so that a
+/// later write up to there cannot run out of space.  Return false if the
+/// disk is full.
+///
+/// * `newLength` is the length the file must be able to reach.
+bool
+OpenFile::Reserve(unsigned newLength)
+{
+    // Sectors are never taken from an open file, so once there is room
+    // there is no need to look again with the lock held.
+    if (newLength <= hdr->ReservedLength())
+        return true;
+    rwLock->AcquireWrite();
+    bool success = newLength <= hdr->ReservedLength()
+                   || fileSystem->Reserve(hdr, hdrSector, newLength);
+    rwLock->ReleaseWrite();
+    return success;
+}
+
+/// Return the number of bytes in the file, counting those still waiting in
+/// the write buffer.
 unsigned
 OpenFile::Length() const
 {
-    return hdr->FileLength();
+    unsigned length = hdr->FileLength();
+    if (bufferCount > 0 && bufferStart + bufferCount > length)
+        length = bufferStart + bufferCount;
+    return length;
 }
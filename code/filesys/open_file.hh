@@ -73,6 +73,8 @@ public:
         return numWritten;
     }
 
+    void Flush() {}  // UNIX does the buffering.
+
     unsigned Length() const
     {
         Lseek(file, 0, 2);
@@ -86,12 +88,15 @@ private:
 
 #else // FILESYS
 class FileHeader;
+class ReadWriteLock;
 
 class OpenFile {
 public:
 
-    /// Open a file whose header is located at `sector` on the disk.
-    OpenFile(int sector);
+    /// Open a file whose header is located at `sector` on the disk.  The
+    /// contents of `metadata` files, directories and the free map, are
+    /// written through the journal.
+    OpenFile(int sector, bool metadata = false);
 
     /// Close the file.
     ~OpenFile();
@@ -101,6 +106,11 @@ public:
 
     /// Read/write bytes from the file, starting at the implicit position.
     /// Return the # actually read/written, and increment position in file.
+    ///
+    /// Small writes following each other are gathered in a buffer, and
+    /// only reach the file, and other `OpenFile`s for it, on `Flush`.  Room
+    /// for them is allocated right away, so a full disk shows up as a
+    /// short write.
 
     int Read(char *into, unsigned numBytes);
     int Write(const char *from, unsigned numBytes);
@@ -110,13 +120,38 @@ public:
     int ReadAt(char *into, unsigned numBytes, unsigned position);
     int WriteAt(const char *from, unsigned numBytes, unsigned position);
 
+    /// Write whatever `Write` left in the buffer.  Done as well when the
+    /// file is closed, and on a `Seek` elsewhere.
+    void Flush();
+
     // Return the number of bytes in the file (this interface is simpler than
     // the UNIX idiom -- `lseek` to end of file, `tell`, `lseek` back).
     unsigned Length() const;
 
   private:
-    FileHeader *hdr;  ///< Header for this file.
+    FileHeader *hdr;  ///< Header for this file, shared with every other
+                      ///< `OpenFile` for it.
+    unsigned hdrSector;  ///< Disk sector holding the header.
+    ReadWriteLock *rwLock;  ///< Lock for the file, also shared.
     unsigned seekPosition;  ///< Current position within the file.
+    bool metadata;  ///< Is the file part of the file system structure?
+
+    char *writeBuffer;  ///< Small writes not yet passed to `WriteAt`, or
+                        ///< null until the first one.
+    unsigned bufferStart;  ///< Position in the file of `writeBuffer`.
+    unsigned bufferCount;  ///< Bytes in `writeBuffer`.
+
+    /// Write the whole sectors in the buffer, and keep the rest.
+    void FlushSectors();
+
+    int DoReadAt(char *into, unsigned numBytes, unsigned position);
+    int DoWriteAt(const char *from, unsigned numBytes, unsigned position);
+
+    /// Grow the file so that it is `newLength` bytes long.
+    bool Extend(unsigned newLength);
+
+    /// Allocate room for the file to grow to `newLength` bytes.
+    bool Reserve(unsigned newLength);
 };
 
 #endif
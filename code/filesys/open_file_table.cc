@@ -0,0 +1,136 @@
+/// Routines to manage the table of open files.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "open_file_table.hh"
+#include "file_header.hh"
+#include "threads/system.hh"
+
+
+OpenFileTable::OpenFileTable()
+{
+    numEntries = superBlock->GetNumSectors();
+    entries = new Entry * [numEntries];
+    for (unsigned i = 0; i < numEntries; i++)
+        entries[i] = nullptr;
+    lock = new Lock("open file table");
+}
+
+OpenFileTable::~OpenFileTable()
+{
+    for (unsigned i = 0; i < numEntries; i++)
+        ASSERT(entries[i] == nullptr);
+    delete [] entries;
+    delete lock;
+}
+
+/// The header is only read from disk if the file was not already open.
+/// Only the file system check copes with broken headers; anywhere else, one
+/// is fatal.
+///
+/// * `sector` is the location on disk of the file header.
+FileHeader *
+OpenFileTable::Acquire(unsigned sector)
+{
+    ASSERT(sector < numEntries);
+
+    lock->Acquire();
+    Entry *e = entries[sector];
+    if (e == nullptr) {
+        e = new Entry;
+        e->hdr = new FileHeader;
+        bool valid = e->hdr->FetchFrom(sector);
+        if (!valid)
+            DEBUG('f', "Broken file header at sector %u; the disk should "
+                       "be checked.\n", sector);
+        ASSERT(valid);
+        e->rwLock = new ReadWriteLock("file lock");
+        e->refCount = 0;
+        e->dirty = false;
+        e->removed = false;
+        entries[sector] = e;
+    }
+    e->refCount++;
+    DEBUG('f', "Header at sector %u acquired, %u references.\n",
+          sector, e->refCount);
+    lock->Release();
+    return e->hdr;
+}
+
+/// When the last reference goes, the header is written back if it changed,
+/// or, if the file was removed meanwhile, the file is deleted for good.
+/// The latter is done once out of the table, as the file system has locks
+/// of its own to take.
+///
+/// * `sector` is the location on disk of the file header.
+void
+OpenFileTable::Release(unsigned sector)
+{
+    ASSERT(sector < numEntries);
+
+    lock->Acquire();
+    Entry *e = entries[sector];
+    ASSERT(e != nullptr);
+    ASSERT(e->refCount > 0);
+
+    e->refCount--;
+    DEBUG('f', "Header at sector %u released, %u references.\n",
+          sector, e->refCount);
+    if (e->refCount > 0) {
+        lock->Release();
+        return;
+    }
+
+    if (!e->removed && e->dirty)
+        e->hdr->WriteBack(sector);
+    entries[sector] = nullptr;
+    lock->Release();
+
+    if (e->removed)
+        fileSystem->Deallocate(e->hdr, sector);
+    delete e->rwLock;
+    delete e->hdr;
+    delete e;
+}
+
+bool
+OpenFileTable::IsOpen(unsigned sector) const
+{
+    ASSERT(sector < numEntries);
+
+    return entries[sector] != nullptr;
+}
+
+ReadWriteLock *
+OpenFileTable::GetLock(unsigned sector) const
+{
+    ASSERT(sector < numEntries);
+    ASSERT(entries[sector] != nullptr);
+
+    return entries[sector]->rwLock;
+}
+
+/// Only called by writers of the file, which hold a reference to it and
+/// its lock.
+void
+OpenFileTable::MarkDirty(unsigned sector)
+{
+    ASSERT(sector < numEntries);
+    ASSERT(entries[sector] != nullptr);
+
+    entries[sector]->dirty = true;
+}
+
+void
+OpenFileTable::MarkRemoved(unsigned sector)
+{
+    ASSERT(sector < numEntries);
+
+    lock->Acquire();
+    ASSERT(entries[sector] != nullptr);
+    entries[sector]->removed = true;
+    lock->Release();
+}
@@ -0,0 +1,77 @@
+/// Data structures to share file headers among all the open instances of a
+/// file.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_OPENFILETABLE__HH
+#define NACHOS_FILESYS_OPENFILETABLE__HH
+
+
+#include "machine/disk.hh"
+
+
+class FileHeader;
+class Lock;
+class ReadWriteLock;
+
+/// The following class keeps, for every file that is open, a single copy of
+/// its header in memory, however many times the file is open.
+///
+/// Files are identified by the sector of their header.  Each `OpenFile`
+/// takes a reference to the header when created and drops it when deleted;
+/// the header is read from disk by the first reference, and written back,
+/// only if it changed, when the last one is dropped.
+///
+/// Every open file also has a reader-writer lock, so that any number of
+/// threads can read it at the same time, while writes are exclusive.
+///
+/// A file removed while open keeps its sectors until it is closed for the
+/// last time.
+class OpenFileTable {
+public:
+
+    /// Initialize an empty table.
+    OpenFileTable();
+
+    /// De-allocate the table.  Every file must be closed by now.
+    ~OpenFileTable();
+
+    /// Return the header stored at `sector`, and take a reference to it.
+    FileHeader *Acquire(unsigned sector);
+
+    /// Drop a reference to the header stored at `sector`.
+    void Release(unsigned sector);
+
+    /// Is anybody holding a reference to the header at `sector`?
+    bool IsOpen(unsigned sector) const;
+
+    /// Return the lock for the file with header at `sector`.  The caller
+    /// must hold a reference to it.
+    ReadWriteLock *GetLock(unsigned sector) const;
+
+    /// Note that the in-memory header at `sector` differs from the disk.
+    void MarkDirty(unsigned sector);
+
+    /// Let the file with header at `sector` be deleted on its last close.
+    void MarkRemoved(unsigned sector);
+
+private:
+    struct Entry {
+        FileHeader *hdr;
+        ReadWriteLock *rwLock;  ///< Lock for the contents of the file.
+        unsigned refCount;  ///< Number of `OpenFile`s using `hdr`.
+        bool dirty;  ///< Does `hdr` need to be written back?
+        bool removed;  ///< Is the file gone from its directory?
+    };
+
+    /// Entries indexed by header sector; null for files that are not open.
+    Entry **entries;
+    unsigned numEntries;
+
+    Lock *lock;  ///< Protects `entries` and reference counts.
+};
+
+
+#endif
@@ -10,16 +10,40 @@
 #include "machine/disk.hh"
 
 
+/// Number of data sectors addressed directly from the header, after leaving
+/// room for the size fields and the two index block pointers.
 static const unsigned NUM_DIRECT
-  = (SECTOR_SIZE - 2 * sizeof (int)) / sizeof (int);
-const unsigned MAX_FILE_SIZE = NUM_DIRECT * SECTOR_SIZE;
+  = (SECTOR_SIZE - 4 * sizeof (int)) / sizeof (int);
+
+/// Number of sector numbers that fit in an index block.
+static const unsigned NUM_INDIRECT = SECTOR_SIZE / sizeof (int);
+
+/// Maximum number of data sectors: direct, single indirect and double
+/// indirect.
+static const unsigned MAX_FILE_SECTORS
+  = NUM_DIRECT + NUM_INDIRECT + NUM_INDIRECT * NUM_INDIRECT;
+const unsigned MAX_FILE_SIZE = MAX_FILE_SECTORS * SECTOR_SIZE;
 
 struct RawFileHeader {
     unsigned numBytes;  ///< Number of bytes in the file.
     unsigned numSectors;  ///< Number of data sectors in the file.
     unsigned dataSectors[NUM_DIRECT];  ///< Disk sector numbers for each data
                                        ///< block in the file.
+    unsigned indirectSector;  ///< Index block holding the next
+                              ///< `NUM_INDIRECT` data sectors.
+    unsigned doubleIndirectSector;  ///< Index block pointing to up to
+                                    ///< `NUM_INDIRECT` more index blocks.
 };
 
+/// An index block: one sector filled with sector numbers.
+struct RawIndirectBlock {
+    unsigned dataSectors[NUM_INDIRECT];
+};
+
+static_assert(sizeof (RawFileHeader) == SECTOR_SIZE,
+              "File header must fill exactly one sector.");
+static_assert(sizeof (RawIndirectBlock) == SECTOR_SIZE,
+              "Index block must fill exactly one sector.");
+
 
 #endif
@@ -0,0 +1,49 @@
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_RAWJOURNAL__HH
+#define NACHOS_FILESYS_RAWJOURNAL__HH
+
+
+#include "machine/disk.hh"
+
+
+/// The journal takes the last eight tracks of the disk (cf. `SuperBlock`).
+/// Its first sector is the header, followed by the map of where logged
+/// sectors belong, and then by the logged sectors themselves.
+///
+/// A single operation has to fit in one commit, and the biggest one adds a
+/// file to a directory that doubles its table to `MAX_DIR_ENTRIES` entries,
+/// rewriting all of it.
+static const unsigned JOURNAL_SIZE = 8 * SECTORS_PER_TRACK;
+static const unsigned JOURNAL_MAP_SECTORS = 8;
+
+/// Maximum number of sectors carried by a single commit.
+static const unsigned JOURNAL_CAPACITY = JOURNAL_SIZE - 1 - JOURNAL_MAP_SECTORS;
+
+static const unsigned JOURNAL_MAGIC = 0x4C4E524A;  // “JRNL”.
+
+struct RawJournalHeader {
+    unsigned magic;  ///< `JOURNAL_MAGIC` on a formatted disk.
+    unsigned sequence;  ///< Number of the last commit.
+    unsigned numSectors;  ///< Sectors logged by the last commit, or 0 if
+                          ///< they are all back in place.
+    unsigned checksum;  ///< Of the logged sectors and their locations.
+    char padding[SECTOR_SIZE - 4 * sizeof (unsigned)];
+};
+
+/// Home location of each logged sector, in log order.
+struct RawJournalMap {
+    unsigned homes[JOURNAL_MAP_SECTORS * SECTOR_SIZE / sizeof (unsigned)];
+};
+
+static_assert(sizeof (RawJournalHeader) == SECTOR_SIZE,
+              "Journal header must fill exactly one sector.");
+static_assert(sizeof (RawJournalMap) == JOURNAL_MAP_SECTORS * SECTOR_SIZE,
+              "Journal map must fill exactly its sectors.");
+static_assert(JOURNAL_CAPACITY <= sizeof (RawJournalMap) / sizeof (unsigned),
+              "Journal map must fit every logged sector.");
+
+
+#endif
@@ -0,0 +1,32 @@
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_RAWSUPERBLOCK__HH
+#define NACHOS_FILESYS_RAWSUPERBLOCK__HH
+
+
+#include "machine/disk.hh"
+
+
+/// The superblock takes the first sector of the disk.
+static const unsigned SUPER_BLOCK_SECTOR = 0;
+
+static const unsigned SUPER_BLOCK_MAGIC = 0x53484346;  // “FCHS”.
+
+struct RawSuperBlock {
+    unsigned magic;  ///< `SUPER_BLOCK_MAGIC` on a formatted disk.
+    unsigned sectorSize;  ///< Bytes per sector.
+    unsigned sectorsPerTrack;
+    unsigned numSectors;  ///< Sectors used by the file system.
+    unsigned freeMapSize;  ///< Bytes in the free map file.
+    unsigned journalSector;  ///< First sector of the journal.
+    unsigned journalSize;  ///< Number of sectors of the journal.
+    char padding[SECTOR_SIZE - 7 * sizeof (unsigned)];
+};
+
+static_assert(sizeof (RawSuperBlock) == SECTOR_SIZE,
+              "Superblock must fill exactly one sector.");
+
+
+#endif
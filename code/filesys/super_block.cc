@@ -0,0 +1,106 @@
+/// Routines to manage the superblock.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "super_block.hh"
+#include "raw_file_header.hh"
+#include "raw_journal.hh"
+#include "lib/bitmap.hh"
+#include "threads/system.hh"
+
+#include <string.h>
+
+
+/// The superblock is written straight to the disk: it only changes when
+/// formatting, before there is a journal.
+///
+/// * `format` -- should we describe a new file system?
+SuperBlock::SuperBlock(bool format)
+{
+    if (format) {
+        Describe(&raw, synchDisk->GetNumSectors());
+        synchDisk->WriteSector(SUPER_BLOCK_SECTOR, (char *) &raw);
+    } else {
+        synchDisk->ReadSector(SUPER_BLOCK_SECTOR, (char *) &raw);
+        if (raw.magic != SUPER_BLOCK_MAGIC)
+            DEBUG('f', "No superblock found; the disk should be "
+                       "formatted.\n");
+        ASSERT(raw.magic == SUPER_BLOCK_MAGIC);
+        if (raw.sectorSize != SECTOR_SIZE)
+            DEBUG('f', "The disk has sectors of %u bytes, but Nachos was "
+                       "built for %u.\n", raw.sectorSize, SECTOR_SIZE);
+        ASSERT(raw.sectorSize == SECTOR_SIZE);
+        ASSERT(raw.sectorsPerTrack == SECTORS_PER_TRACK);
+        ASSERT(raw.numSectors <= synchDisk->GetNumSectors());
+        if (raw.journalSize != JOURNAL_SIZE)
+            DEBUG('f', "The disk has a journal of %u sectors, but Nachos was "
+                       "built for %u.\n", raw.journalSize, JOURNAL_SIZE);
+        ASSERT(raw.journalSize == JOURNAL_SIZE);
+        ASSERT(raw.journalSector + raw.journalSize <= raw.numSectors);
+    }
+    DEBUG('f', "File system of %u sectors of %u bytes.\n",
+          raw.numSectors, raw.sectorSize);
+}
+
+/// The journal takes the last sectors.  The free map is a whole number of
+/// words, as that is how bitmaps are read and written.
+///
+/// * `raw` is the superblock to fill.
+/// * `numSectors` is the size of the file system.
+void
+SuperBlock::Describe(RawSuperBlock *raw, unsigned numSectors)
+{
+    ASSERT(raw != nullptr);
+    ASSERT(numSectors > JOURNAL_SIZE);
+
+    memset(raw, 0, sizeof *raw);
+    raw->magic = SUPER_BLOCK_MAGIC;
+    raw->sectorSize = SECTOR_SIZE;
+    raw->sectorsPerTrack = SECTORS_PER_TRACK;
+    raw->numSectors = numSectors;
+    raw->freeMapSize = DivRoundUp(numSectors, BITS_IN_WORD)
+                       * (unsigned) sizeof (unsigned);
+    raw->journalSector = numSectors - JOURNAL_SIZE;
+    raw->journalSize = JOURNAL_SIZE;
+    ASSERT(raw->freeMapSize <= MAX_FILE_SIZE);
+}
+
+unsigned
+SuperBlock::GetNumSectors() const
+{
+    return raw.numSectors;
+}
+
+unsigned
+SuperBlock::GetFreeMapSize() const
+{
+    return raw.freeMapSize;
+}
+
+unsigned
+SuperBlock::GetJournalSector() const
+{
+    return raw.journalSector;
+}
+
+const RawSuperBlock *
+SuperBlock::GetRaw() const
+{
+    return &raw;
+}
+
+void
+SuperBlock::Print() const
+{
+    printf("Superblock contents.\n"
+           "    Sector size: %u bytes\n"
+           "    Sectors per track: %u\n"
+           "    Number of sectors: %u\n"
+           "    Free map size: %u bytes\n"
+           "    Journal: %u sectors from sector %u\n",
+           raw.sectorSize, raw.sectorsPerTrack, raw.numSectors,
+           raw.freeMapSize, raw.journalSize, raw.journalSector);
+}
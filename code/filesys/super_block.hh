@@ -0,0 +1,51 @@
+/// Data structures to describe the layout of the file system on disk.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_FILESYS_SUPERBLOCK__HH
+#define NACHOS_FILESYS_SUPERBLOCK__HH
+
+
+#include "raw_super_block.hh"
+
+
+/// The following class keeps the geometry of the file system: how big the
+/// sectors are, how many of them there are, and where the structures whose
+/// place depends on that are.  It is written to the first sector of the
+/// disk when formatting, and read back when mounting, so that a disk keeps
+/// the size it was formatted with.
+///
+/// Everything sized by the disk (the free map, the journal, the table of
+/// open files) takes its size from here.
+class SuperBlock {
+public:
+
+    /// Read the superblock of the disk, or write a new one, for a file
+    /// system filling the whole disk, if `format` is true.
+    SuperBlock(bool format);
+
+    /// Fill `raw` with the layout of a file system of `numSectors`.
+    static void Describe(RawSuperBlock *raw, unsigned numSectors);
+
+    /// Return the number of sectors of the file system.
+    unsigned GetNumSectors() const;
+
+    /// Return the size of the free map file, in bytes.
+    unsigned GetFreeMapSize() const;
+
+    /// Return the first sector of the journal.
+    unsigned GetJournalSector() const;
+
+    const RawSuperBlock *GetRaw() const;
+
+    /// Print the contents of the superblock.
+    void Print() const;
+
+private:
+    RawSuperBlock raw;
+};
+
+
+#endif
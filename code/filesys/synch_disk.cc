@@ -14,6 +14,7 @@
 
 
 #include "synch_disk.hh"
+#include "threads/system.hh"
 
 
 /// Disk interrupt handler.  Need this to be a C routine, because C++ cannot
@@ -31,11 +32,15 @@ DiskRequestDone(void *arg)
 ///
 /// * `name` is a UNIX file name to be used as storage for the disk data
 ///   (usually, `DISK`).
-SynchDisk::SynchDisk(const char *name)
+/// * `numTracks`, `mapped` and `syncOnClose` tell how big the disk is and
+///   how to access that file (cf. `Disk`).
+SynchDisk::SynchDisk(const char *name, unsigned numTracks,
+                     bool mapped, bool syncOnClose)
 {
     semaphore = new Semaphore("synch disk", 0);
     lock = new Lock("synch disk lock");
-    disk = new Disk(name, DiskRequestDone, this);
+    disk = new Disk(name, numTracks, DiskRequestDone, this,
+                    mapped, syncOnClose);
 }
 
 /// De-allocate data structures needed for the synchronous disk abstraction.
@@ -58,6 +63,7 @@ SynchDisk::ReadSector(int sectorNumber, char *data)
 
     lock->Acquire();  // Only one disk I/O at a time.
     disk->ReadRequest(sectorNumber, data);
+    scheduler->BlockedOnIO();
     semaphore->P();   // Wait for interrupt.
     lock->Release();
 }
@@ -74,10 +80,17 @@ SynchDisk::WriteSector(int sectorNumber, const char *data)
 
     lock->Acquire();  // only one disk I/O at a time
     disk->WriteRequest(sectorNumber, data);
+    scheduler->BlockedOnIO();
     semaphore->P();   // wait for interrupt
     lock->Release();
 }
 
+unsigned
+SynchDisk::GetNumSectors() const
+{
+    return disk->GetNumSectors();
+}
+
 /// Disk interrupt handler.  Wake up any thread waiting for the disk
 /// request to finish.
 void
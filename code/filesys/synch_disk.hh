@@ -27,7 +27,8 @@ class SynchDisk {
 public:
 
     /// Initialize a synchronous disk, by initializing the raw Disk.
-    SynchDisk(const char *name);
+    SynchDisk(const char *name, unsigned numTracks = 0,
+              bool mapped = false, bool syncOnClose = false);
 
     /// De-allocate the synch disk data.
     ~SynchDisk();
@@ -39,6 +40,9 @@ public:
     void ReadSector(int sectorNumber, char *data);
     void WriteSector(int sectorNumber, const char *data);
 
+    /// Return the total number of sectors of the disk.
+    unsigned GetNumSectors() const;
+
     /// Called by the disk device interrupt handler, to signal that the
     /// current disk operation is complete.
     void RequestDone();
@@ -1,6 +1,11 @@
 /// Routines to manage a bitmap -- an array of bits each of which can be
 /// either on or off.  Represented as an array of integers.
 ///
+/// `Find` and the counting of clear bits work on whole words with the
+/// compiler's bit scanning builtins, which map to single instructions on
+/// most hosts.  Bits past `numBits` in the last word are always kept clear
+/// and never handed out.
+///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
 /// All rights reserved.  See `copyright.h` for copyright notice and
@@ -8,6 +13,7 @@
 
 
 #include "bitmap.hh"
+#include "machine/disk.hh"
 
 
 /// Initialize a bitmap with `nitems` bits, so that every bit is clear.  It
@@ -21,8 +27,14 @@ Bitmap::Bitmap(unsigned nitems)
     numBits  = nitems;
     numWords = DivRoundUp(numBits, BITS_IN_WORD);
     map      = new unsigned [numWords];
-    for (unsigned i = 0; i < numBits; i++)
-        Clear(i);
+    for (unsigned i = 0; i < numWords; i++)
+        map[i] = 0;
+    numClear = numBits;
+    nextFree = 0;
+
+    // Nothing of this is on disk yet.
+    dirtyLow  = 0;
+    dirtyHigh = numWords - 1;
 }
 
 /// De-allocate a bitmap.
@@ -38,7 +50,14 @@ void
 Bitmap::Mark(unsigned which)
 {
     ASSERT(which < numBits);
-    map[which / BITS_IN_WORD] |= 1 << which % BITS_IN_WORD;
+
+    unsigned w = which / BITS_IN_WORD;
+    unsigned mask = 1U << which % BITS_IN_WORD;
+    if (map[w] & mask)
+        return;
+    map[w] |= mask;
+    numClear--;
+    MarkDirty(w);
 }
 
 /// Clear the “nth” bit in a bitmap.
@@ -48,7 +67,16 @@ void
 Bitmap::Clear(unsigned which)
 {
     ASSERT(which < numBits);
-    map[which / BITS_IN_WORD] &= ~(1 << which % BITS_IN_WORD);
+
+    unsigned w = which / BITS_IN_WORD;
+    unsigned mask = 1U << which % BITS_IN_WORD;
+    if (!(map[w] & mask))
+        return;
+    map[w] &= ~mask;
+    numClear++;
+    if (w < nextFree)
+        nextFree = w;
+    MarkDirty(w);
 }
 
 /// Return true if the “nth” bit is set.
@@ -58,21 +86,32 @@ bool
 Bitmap::Test(unsigned which) const
 {
     ASSERT(which < numBits);
-    return map[which / BITS_IN_WORD] & 1 << which % BITS_IN_WORD;
+    return map[which / BITS_IN_WORD] & 1U << which % BITS_IN_WORD;
 }
 
 /// Return the number of the first bit which is clear.  As a side effect, set
 /// the bit (mark it as in use).  (In other words, find and allocate a bit.)
 ///
+/// Full words are skipped at once, starting from `nextFree`, and the first
+/// clear bit of a word is found with a single bit scan.
+///
 /// If no bits are clear, return -1.
 int
 Bitmap::Find()
 {
-    for (unsigned i = 0; i < numBits; i++)
-        if (!Test(i)) {
-            Mark(i);
-            return i;
-        }
+    if (numClear == 0)
+        return -1;
+
+    for (unsigned w = nextFree; w < numWords; w++) {
+        if (map[w] == ~0U)
+            continue;
+        nextFree = w;
+        unsigned which = w * BITS_IN_WORD + __builtin_ctz(~map[w]);
+        if (which >= numBits)
+            break;  // Only padding left.
+        Mark(which);
+        return which;
+    }
     return -1;
 }
 
@@ -81,12 +120,43 @@ Bitmap::Find()
 unsigned
 Bitmap::CountClear() const
 {
-    unsigned count = 0;
+    return numClear;
+}
 
-    for (unsigned i = 0; i < numBits; i++)
-        if (!Test(i))
-            count++;
-    return count;
+/// Words are compared whole, and the first differing bit of a word is found
+/// with a single bit scan.
+///
+/// * `other` is a bitmap of the same size.
+/// * `from` is the first bit to compare.
+/// * `to` is one past the last bit to compare.
+int
+Bitmap::FindDifference(const Bitmap *other, unsigned from, unsigned to) const
+{
+    ASSERT(other != nullptr);
+    ASSERT(other->numBits == numBits);
+    ASSERT(to <= numBits);
+
+    if (from >= to)
+        return -1;
+    unsigned w = from / BITS_IN_WORD;
+    unsigned diff = (map[w] ^ other->map[w]) & ~0U << from % BITS_IN_WORD;
+    for (;;) {
+        if (diff != 0) {
+            unsigned which = w * BITS_IN_WORD + __builtin_ctz(diff);
+            return which < to ? (int) which : -1;
+        }
+        if (++w >= DivRoundUp(to, BITS_IN_WORD))
+            return -1;
+        diff = map[w] ^ other->map[w];
+    }
+}
+
+/// Return true if some bit was set or cleared since the bitmap was last
+/// fetched from or written back to disk.
+bool
+Bitmap::IsDirty() const
+{
+    return dirtyLow <= dirtyHigh;
 }
 
 /// Print the contents of the bitmap, for debugging.
@@ -113,16 +183,51 @@ Bitmap::FetchFrom(OpenFile *file)
 {
     ASSERT(file != nullptr);
     file->ReadAt((char *) map, numWords * sizeof (unsigned), 0);
+
+    if (numBits % BITS_IN_WORD != 0)
+        map[numWords - 1] &= (1U << numBits % BITS_IN_WORD) - 1;
+    numClear = numBits;
+    for (unsigned i = 0; i < numWords; i++)
+        numClear -= __builtin_popcount(map[i]);
+    nextFree  = 0;
+    dirtyLow  = numWords;
+    dirtyHigh = 0;
 }
 
 /// Store the contents of a bitmap to a Nachos file.
 ///
+/// Only the changed words are written, widened to whole sectors so that the
+/// file does not need to read anything back first.
+///
 /// Note: this is not needed until the *FILESYS* assignment.
 ///
 /// * `file` is the place to write the bitmap to.
 void
-Bitmap::WriteBack(OpenFile *file) const
+Bitmap::WriteBack(OpenFile *file)
 {
     ASSERT(file != nullptr);
-    file->WriteAt((char *) map, numWords * sizeof (unsigned), 0);
+
+    if (!IsDirty())
+        return;
+
+    unsigned size  = numWords * sizeof (unsigned);
+    unsigned first = DivRoundDown(dirtyLow * (unsigned) sizeof (unsigned),
+                                  SECTOR_SIZE) * SECTOR_SIZE;
+    unsigned last  = DivRoundUp((dirtyHigh + 1) * (unsigned) sizeof (unsigned),
+                                SECTOR_SIZE) * SECTOR_SIZE;
+    if (last > size)
+        last = size;
+    file->WriteAt((char *) map + first, last - first, first);
+
+    dirtyLow  = numWords;
+    dirtyHigh = 0;
+}
+
+void
+Bitmap::MarkDirty(unsigned w)
+{
+    if (w < dirtyLow)
+        dirtyLow = w;
+    if (w > dirtyHigh)
+        dirtyHigh = w;
 }
@@ -3,7 +3,9 @@
 /// vector.
 ///
 /// The bitmap is represented as an array of unsigned integers, on which we
-/// do modulo arithmetic to find the bit we are interested in.
+/// do modulo arithmetic to find the bit we are interested in.  Searches
+/// look at a whole word at a time, and the number of clear bits is kept up
+/// to date so that it can be queried in constant time.
 ///
 /// The data structure is parameterized with with the number of bits being
 /// managed.
@@ -64,6 +66,15 @@ public:
     /// Return the number of clear bits.
     unsigned CountClear() const;
 
+    /// Return the index of the first bit, from `from` and before `to`, that
+    /// differs from the same bit in `other`.
+    ///
+    /// If all of them are equal, return -1.
+    int FindDifference(const Bitmap *other, unsigned from, unsigned to) const;
+
+    /// Has any bit changed since the last `FetchFrom`/`WriteBack`?
+    bool IsDirty() const;
+
     /// Print contents of bitmap.
     void Print() const;
 
@@ -73,11 +84,12 @@ public:
     /// need to read and write the bitmap to a file.
     void FetchFrom(OpenFile *file);
 
-    /// Write contents to disk.
+    /// Write contents to disk.  Only the sectors holding changed bits are
+    /// written.
     ///
     /// Note: this is not needed until the *FILESYS* assignment, when we will
     /// need to read and write the bitmap to a file.
-    void WriteBack(OpenFile *file) const;
+    void WriteBack(OpenFile *file);
 
 private:
 
@@ -91,6 +103,21 @@ private:
     /// Bit storage.
     unsigned *map;
 
+    /// Number of clear bits.
+    unsigned numClear;
+
+    /// Every word before this one is known to be full, so `Find` can start
+    /// looking here.
+    unsigned nextFree;
+
+    /// Range of words changed since the bitmap was last read or written;
+    /// empty when `dirtyLow > dirtyHigh`.
+    unsigned dirtyLow;
+    unsigned dirtyHigh;
+
+    /// Record that word `w` changed.
+    void MarkDirty(unsigned w);
+
 };
 
 
@@ -0,0 +1,192 @@
+/// Doubly linked lists whose links live inside the items.
+///
+/// Unlike `List`, putting an item on a list allocates nothing: the item
+/// carries a `ListLink` for each list it may be on at the same time, and
+/// the list only points to those.  Items are removed in constant time,
+/// wherever they are.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_INTRUSIVELIST__HH
+#define NACHOS_LIB_INTRUSIVELIST__HH
+
+
+#include "utility.hh"
+
+#include <stddef.h>
+
+
+/// Place of an item on an `IntrusiveList`.
+class ListLink {
+public:
+
+    ListLink()
+    {
+        prev = next = nullptr;
+    }
+
+    /// Is the item on a list?
+    bool IsLinked() const
+    {
+        return next != nullptr;
+    }
+
+private:
+
+    ListLink *prev;
+    ListLink *next;
+
+    template <class T, ListLink T::*link>
+    friend class IntrusiveList;
+};
+
+/// A list of items of type `T`, linked through their member `link`.
+///
+/// An item can only be on one list through the same member at a time.
+template <class T, ListLink T::*link>
+class IntrusiveList {
+public:
+
+    IntrusiveList();
+
+    /// The items still on the list are left alone.
+    ~IntrusiveList();
+
+    bool IsEmpty() const;
+
+    /// First item, or null if the list is empty.
+    T *Head() const;
+
+    /// Item after `item`, or null if it is the last one.
+    T *Next(const T *item) const;
+
+    /// Put `item` at the end of the list.
+    void Append(T *item);
+
+    /// Put `item` at the beginning of the list.
+    void Prepend(T *item);
+
+    /// Put `item` just before `before`, or at the end if it is null.
+    void InsertBefore(T *item, T *before);
+
+    /// Take the first item off the list, or return null if it is empty.
+    T *Pop();
+
+    /// Take `item`, which must be on the list, off it.
+    void Remove(T *item);
+
+private:
+
+    static T *ItemOf(const ListLink *l);
+
+    /// Links to the first and last items; an empty list links to itself.
+    ListLink head;
+};
+
+
+template <class T, ListLink T::*link>
+IntrusiveList<T, link>::IntrusiveList()
+{
+    head.prev = head.next = &head;
+}
+
+template <class T, ListLink T::*link>
+IntrusiveList<T, link>::~IntrusiveList()
+{
+    while (!IsEmpty())
+        Pop();
+}
+
+/// The item holding `l`, found by the offset of `link` in `T`.
+template <class T, ListLink T::*link>
+T *
+IntrusiveList<T, link>::ItemOf(const ListLink *l)
+{
+    // Any address serves to measure how far `link` is from the start of a
+    // `T`; the compiler folds it into a constant.
+    const T *probe = (const T *) l;
+    ptrdiff_t offset = (const char *) &(probe->*link) - (const char *) probe;
+    return (T *) ((const char *) l - offset);
+}
+
+template <class T, ListLink T::*link>
+bool
+IntrusiveList<T, link>::IsEmpty() const
+{
+    return head.next == &head;
+}
+
+template <class T, ListLink T::*link>
+T *
+IntrusiveList<T, link>::Head() const
+{
+    return IsEmpty() ? nullptr : ItemOf(head.next);
+}
+
+template <class T, ListLink T::*link>
+T *
+IntrusiveList<T, link>::Next(const T *item) const
+{
+    ASSERT(item != nullptr);
+
+    const ListLink *l = (item->*link).next;
+    return l == &head ? nullptr : ItemOf(l);
+}
+
+template <class T, ListLink T::*link>
+void
+IntrusiveList<T, link>::Append(T *item)
+{
+    InsertBefore(item, nullptr);
+}
+
+template <class T, ListLink T::*link>
+void
+IntrusiveList<T, link>::Prepend(T *item)
+{
+    InsertBefore(item, Head());
+}
+
+template <class T, ListLink T::*link>
+void
+IntrusiveList<T, link>::InsertBefore(T *item, T *before)
+{
+    ASSERT(item != nullptr);
+
+    ListLink *l = &(item->*link);
+    ASSERT(!l->IsLinked());
+    ListLink *next = before == nullptr ? &head : &(before->*link);
+    l->next = next;
+    l->prev = next->prev;
+    next->prev->next = l;
+    next->prev = l;
+}
+
+template <class T, ListLink T::*link>
+T *
+IntrusiveList<T, link>::Pop()
+{
+    if (IsEmpty())
+        return nullptr;
+    T *item = ItemOf(head.next);
+    Remove(item);
+    return item;
+}
+
+template <class T, ListLink T::*link>
+void
+IntrusiveList<T, link>::Remove(T *item)
+{
+    ASSERT(item != nullptr);
+
+    ListLink *l = &(item->*link);
+    ASSERT(l->IsLinked());
+    l->prev->next = l->next;
+    l->next->prev = l->prev;
+    l->prev = l->next = nullptr;
+}
+
+
+#endif
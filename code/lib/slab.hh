@@ -0,0 +1,108 @@
+/// Allocation of many small objects of the same type.
+///
+/// Objects are carved out of blocks that are requested to the host a few at
+/// a time, and freed objects are kept for the next allocation, so that
+/// allocating and freeing them over and over never reaches the host
+/// allocator.  Blocks are only given back when the slab is destroyed.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_LIB_SLAB__HH
+#define NACHOS_LIB_SLAB__HH
+
+
+#include "utility.hh"
+
+
+/// Room for objects of type `T`, `BLOCK_OBJECTS` of them per block.
+///
+/// It hands out raw memory: it is meant to back a class' own `operator new`
+/// and `operator delete`.
+template <class T, unsigned BLOCK_OBJECTS = 64>
+class Slab {
+public:
+
+    Slab();
+
+    /// Free every block, whether its objects were freed or not.
+    ~Slab();
+
+    /// Return room for one object.
+    void *Allocate();
+
+    /// Give back room returned by `Allocate`.
+    void Free(void *object);
+
+private:
+
+    /// Room for an object; it holds the next free one while it is free.
+    union Slot {
+        Slot *nextFree;
+        alignas (T) char object[sizeof (T)];
+    };
+
+    /// Blocks are chained through their first slot, which is never handed
+    /// out.
+    void Grow();
+
+    Slot *blocks;
+    Slot *free;
+};
+
+
+template <class T, unsigned BLOCK_OBJECTS>
+Slab<T, BLOCK_OBJECTS>::Slab()
+{
+    blocks = nullptr;
+    free   = nullptr;
+}
+
+template <class T, unsigned BLOCK_OBJECTS>
+Slab<T, BLOCK_OBJECTS>::~Slab()
+{
+    while (blocks != nullptr) {
+        Slot *next = blocks->nextFree;
+        delete [] blocks;
+        blocks = next;
+    }
+}
+
+template <class T, unsigned BLOCK_OBJECTS>
+void
+Slab<T, BLOCK_OBJECTS>::Grow()
+{
+    Slot *block = new Slot [BLOCK_OBJECTS + 1];
+    block->nextFree = blocks;
+    blocks = block;
+    for (unsigned i = BLOCK_OBJECTS; i > 0; i--) {
+        block[i].nextFree = free;
+        free = &block[i];
+    }
+}
+
+template <class T, unsigned BLOCK_OBJECTS>
+void *
+Slab<T, BLOCK_OBJECTS>::Allocate()
+{
+    if (free == nullptr)
+        Grow();
+    Slot *slot = free;
+    free = slot->nextFree;
+    return slot->object;
+}
+
+template <class T, unsigned BLOCK_OBJECTS>
+void
+Slab<T, BLOCK_OBJECTS>::Free(void *object)
+{
+    if (object == nullptr)
+        return;
+    Slot *slot = (Slot *) object;
+    slot->nextFree = free;
+    free = slot;
+}
+
+
+#endif
@@ -8,65 +8,123 @@
 #define NACHOS_LIB_TABLE__HH
 
 
-#include "list.hh"
+#include "bitmap.hh"
+#include "utility.hh"
 
+#include <string.h>
 
+
+/// Keys are handed out by the table, starting from 0.  Keys of removed
+/// items are given again, most recently freed first, before the table
+/// grows.  Every operation takes constant time, except for `Add` when the
+/// table has to double its size.
 template <class T>
 class Table {
 public:
-    static const unsigned SIZE = 20;
+    /// Number of items the table has room for before growing.
+    static const unsigned INITIAL_SIZE = 20;
 
     Table();
 
+    ~Table();
+
+    /// Add `item` and return its key.
     int Add(T item);
 
+    /// Return the item with key `i`, or `T()` if there is none.
     T Get(int i) const;
 
     bool HasKey(int i) const;
 
     bool IsEmpty() const;
 
+    /// Remove the item with key `i`, and return it, or `T()` if there is
+    /// none.
     T Remove(int i);
 
 private:
+    void Grow();
+
     /// Data items.
-    T data[SIZE];
+    T *data;
+
+    /// Number of items `data` has room for.
+    unsigned size;
+
+    /// Keys handed out so far; the others are all greater.
+    unsigned current;
 
-    /// Current greatest index for a new item.
-    int current;
+    /// Bit `i` is set if key `i` is in use.
+    unsigned *valid;
 
-    /// A list to store indexes of items that have been freed and are not
-    /// among those with greatest numbers, so it is not possible to modify
-    /// `current`.  In other words, this keeps track of external
-    /// fragmentation.
-    List<int> freed;
+    /// Keys that have been freed, to be handed out again, with the last one
+    /// freed on top.
+    int *freed;
+    unsigned numFreed;
 };
 
 
 template <class T>
 Table<T>::Table()
 {
+    size = INITIAL_SIZE;
+    data = new T [size];
     current = 0;
+    valid = new unsigned [DivRoundUp(size, BITS_IN_WORD)]();
+    freed = new int [size];
+    numFreed = 0;
 }
 
+template <class T>
+Table<T>::~Table()
+{
+    delete [] data;
+    delete [] valid;
+    delete [] freed;
+}
+
+template <class T>
+void
+Table<T>::Grow()
+{
+    unsigned newSize = 2 * size;
+
+    T *newData = new T [newSize];
+    for (unsigned i = 0; i < current; i++)
+        newData[i] = data[i];
+    delete [] data;
+    data = newData;
+
+    unsigned numWords = DivRoundUp(size, BITS_IN_WORD);
+    unsigned *newValid = new unsigned [DivRoundUp(newSize, BITS_IN_WORD)]();
+    memcpy(newValid, valid, numWords * sizeof *valid);
+    delete [] valid;
+    valid = newValid;
+
+    // Only keys below `current` can be freed, so there is room for all.
+    int *newFreed = new int [newSize];
+    memcpy(newFreed, freed, numFreed * sizeof *freed);
+    delete [] freed;
+    freed = newFreed;
+
+    size = newSize;
+}
 
 template <class T>
 int
 Table<T>::Add(T item)
 {
-    int i;
-
-    if (!freed.IsEmpty()) {
-        i = freed.Pop();
-        data[i] = item;
-        return i;
-    } else if (current < static_cast<int>(SIZE)) {
+    unsigned i;
+    if (numFreed > 0)
+        i = freed[--numFreed];
+    else {
+        if (current == size)
+            Grow();
         i = current++;
-        data[i] = item;
-        return i;
-    } else {
-        return -1;
     }
+    data[i] = item;
+    valid[i / BITS_IN_WORD] |= 1U << i % BITS_IN_WORD;
+    return i;
 }
 
 template <class T>
@@ -75,10 +133,8 @@ Table<T>::Get(int i) const
 {
     ASSERT(i >= 0);
 
-    if (freed.Has(i) || i >= current) {
+    if (!HasKey(i))
         return T();
-    }
-
     return data[i];
 }
 
@@ -88,14 +144,15 @@ Table<T>::HasKey(int i) const
 {
     ASSERT(i >= 0);
 
-    return !(freed.Has(i) || i >= current);
+    return (unsigned) i < current
+           && (valid[i / BITS_IN_WORD] >> i % BITS_IN_WORD & 1) != 0;
 }
 
 template <class T>
 bool
 Table<T>::IsEmpty() const
 {
-    return current == 0;
+    return numFreed == current;
 }
 
 template <class T>
@@ -104,20 +161,11 @@ Table<T>::Remove(int i)
 {
     ASSERT(i >= 0);
 
-    if (!HasKey(i)) {
+    if (!HasKey(i))
         return T();
-    }
 
-    if (i == current - 1) {
-        current--;
-        for (int j = current - 1; j >= 0 && !HasKey(j); j--) {
-            ASSERT(freed.Has(j));
-            freed.SortedPop(&j);
-            current--;
-        }
-    } else {
-        freed.SortedInsert(i, i);
-    }
+    valid[i / BITS_IN_WORD] &= ~(1U << i % BITS_IN_WORD);
+    freed[numFreed++] = i;
     return data[i];
 }
 
@@ -24,8 +24,6 @@
 static const unsigned MAGIC_NUMBER = 0x456789AB;
 static const unsigned MAGIC_SIZE = sizeof (int);
 
-static const unsigned DISK_SIZE = MAGIC_SIZE + NUM_SECTORS * SECTOR_SIZE;
-
 /// dummy procedure because we cannot take a pointer of a member function
 static void
 DiskDone(void *arg)
@@ -39,16 +37,23 @@ DiskDone(void *arg)
 /// treat it as Nachos disk storage.
 //
 /// * `name` is the text name of the file simulating the Nachos disk.
+/// * `numTracks` is the size of the disk, or 0 to keep the size of an
+///   existing file; a smaller file is grown.
 /// * `callWhenDone` is an interrupt handler to be called when disk
 ///   read/write request completes.
 /// * `callArg` is an argument to pass the interrupt handler.
-Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
+/// * `mapped` tells whether to map the file into memory.
+/// * `syncOnClose` tells whether to sync the mapped file when done.
+Disk::Disk(const char *name, unsigned numTracks,
+           VoidFunctionPtr callWhenDone, void *callArg,
+           bool mapped, bool syncOnClose)
 {
     ASSERT(name != nullptr);
     ASSERT(callWhenDone != nullptr);
 
     int magicNum;
     int tmp = 0;
+    unsigned fileSize = 0;
 
     DEBUG('d', "Initializing the disk, 0x%X 0x%X\n", callWhenDone, callArg);
     handler    = callWhenDone;
@@ -60,22 +65,44 @@ Disk::Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg)
     if (fileno >= 0) {  // File exists, check magic number.
         Read(fileno, (char *) &magicNum, MAGIC_SIZE);
         ASSERT(magicNum == MAGIC_NUMBER);
+        Lseek(fileno, 0, SEEK_END);
+        fileSize = Tell(fileno);
     } else {            // File does not exist, create it.
         fileno = OpenForWrite(name);
         magicNum = MAGIC_NUMBER;
         WriteFile(fileno, (char *) &magicNum, MAGIC_SIZE);
           // Write magic number.
+        if (numTracks == 0)
+            numTracks = NUM_TRACKS;
+    }
 
+    if (numTracks == 0)
+        numSectors = (fileSize - MAGIC_SIZE) / SECTOR_SIZE;
+    else
+        numSectors = numTracks * SECTORS_PER_TRACK;
+    ASSERT(numSectors > 0);
+    diskSize = MAGIC_SIZE + numSectors * SECTOR_SIZE;
+    if (fileSize < diskSize) {
         // Need to write at end of file, so that reads will not return EOF.
-        Lseek(fileno, DISK_SIZE - sizeof (int), 0);
+        Lseek(fileno, diskSize - sizeof (int), 0);
         WriteFile(fileno, (char *) &tmp, sizeof (int));
     }
+    DEBUG('d', "The disk has %u sectors of %u bytes.\n",
+          numSectors, SECTOR_SIZE);
+
+    mapping = mapped ? MapFile(fileno, diskSize) : nullptr;
+    syncMapping = syncOnClose;
     active = false;
 }
 
 /// Clean up disk simulation, by closing the UNIX file representing the disk.
 Disk::~Disk()
 {
+    if (mapping != nullptr) {
+        if (syncMapping)
+            SyncMappedFile(mapping, diskSize);
+        UnmapFile(mapping, diskSize);
+    }
     Close(fileno);
 }
 
@@ -118,11 +145,16 @@ Disk::ReadRequest(unsigned sectorNumber, char *data)
     int ticks = ComputeLatency(sectorNumber, false);
 
     ASSERT(!active);  // only one request at a time
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    ASSERT(sectorNumber < numSectors);
 
     DEBUG('d', "Reading from sector %u\n", sectorNumber);
-    Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    Read(fileno, data, SECTOR_SIZE);
+    if (mapping != nullptr)
+        memcpy(data, &mapping[SECTOR_SIZE * sectorNumber + MAGIC_SIZE],
+               SECTOR_SIZE);
+    else {
+        Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+        Read(fileno, data, SECTOR_SIZE);
+    }
     if (debug.IsEnabled('d'))
         PrintSector(false, sectorNumber, data);
 
@@ -140,11 +172,16 @@ Disk::WriteRequest(unsigned sectorNumber, const char *data)
     int ticks = ComputeLatency(sectorNumber, true);
 
     ASSERT(!active);
-    ASSERT(sectorNumber >= 0 && sectorNumber < NUM_SECTORS);
+    ASSERT(sectorNumber < numSectors);
 
     DEBUG('d', "Writing to sector %u\n", sectorNumber);
-    Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
-    WriteFile(fileno, data, SECTOR_SIZE);
+    if (mapping != nullptr)
+        memcpy(&mapping[SECTOR_SIZE * sectorNumber + MAGIC_SIZE], data,
+               SECTOR_SIZE);
+    else {
+        Lseek(fileno, SECTOR_SIZE * sectorNumber + MAGIC_SIZE, 0);
+        WriteFile(fileno, data, SECTOR_SIZE);
+    }
     if (debug.IsEnabled('d'))
         PrintSector(true, sectorNumber, data);
 
@@ -154,6 +191,12 @@ Disk::WriteRequest(unsigned sectorNumber, const char *data)
     interrupt->Schedule(DiskDone, this, ticks, DISK_INT);
 }
 
+unsigned
+Disk::GetNumSectors() const
+{
+    return numSectors;
+}
+
 /// Called when it is time to invoke the disk interrupt handler, to tell the
 /// Nachos kernel that the disk request is done.
 void
@@ -50,20 +50,41 @@
 ///
 /// The track buffer simulation can be disabled by compiling with
 /// `-DNOTRACKBUF`.
+///
+/// The UNIX file can also be mapped into memory, so that each request is a
+/// copy instead of a pair of system calls.  The simulated time of requests
+/// is the same either way.
+///
+/// The number of tracks is chosen when the disk is created, and kept by the
+/// size of the UNIX file.  The sector size is chosen when compiling, with
+/// `-DDISK_SECTOR_SIZE=<bytes>`, because the page size and the layout of
+/// file headers depend on it.
+
+#ifndef DISK_SECTOR_SIZE
+#define DISK_SECTOR_SIZE 128
+#endif
 
-const unsigned SECTOR_SIZE = 128;       ///< Number of bytes per disk sector.
+const unsigned SECTOR_SIZE = DISK_SECTOR_SIZE;  ///< Number of bytes per
+                                                ///< disk sector.
 const unsigned SECTORS_PER_TRACK = 32;  ///< Number of sectors per disk
                                         ///< track.
-const unsigned NUM_TRACKS = 32;         ///< Number of tracks per disk.
-const unsigned NUM_SECTORS = SECTORS_PER_TRACK * NUM_TRACKS;
-  ///< Total # of sectors per disk.
+const unsigned NUM_TRACKS = 128;        ///< Number of tracks of a new disk,
+                                        ///< unless told otherwise.
+
+static_assert(SECTOR_SIZE >= 128 && (SECTOR_SIZE & (SECTOR_SIZE - 1)) == 0,
+              "Sector size must be a power of two, of 128 bytes or more.");
 
 class Disk {
 public:
     /// Create a simulated disk.
     ///
     /// Invoke `(*callWhenDone)(callArg)` every time a request completes.
-    Disk(const char *name, VoidFunctionPtr callWhenDone, void *callArg);
+    /// The disk has `numTracks` tracks, or as many as the UNIX file holds
+    /// if 0.  If `mapped`, keep the UNIX file mapped into memory, and if
+    /// `syncOnClose` too, wait for it to reach the host disk at the end.
+    Disk(const char *name, unsigned numTracks,
+         VoidFunctionPtr callWhenDone, void *callArg,
+         bool mapped = false, bool syncOnClose = false);
     ~Disk();  // Deallocate the disk.
 
     /// Read/write an single disk sector.
@@ -82,8 +103,15 @@ public:
     ///     (seek + rotational delay + transfer)
     int ComputeLatency(unsigned newSector, bool writing);
 
+    /// Return the total number of sectors of the disk.
+    unsigned GetNumSectors() const;
+
 private:
     int fileno;  ///< UNIX file number for simulated disk.
+    unsigned numSectors;  ///< Total number of sectors of the disk.
+    unsigned diskSize;  ///< Size of the UNIX file, in bytes.
+    char *mapping;  ///< Contents of the UNIX file, if mapped into memory.
+    bool syncMapping;  ///< Should `mapping` be synced when closing?
     VoidFunctionPtr handler;  ///< Interrupt handler, to be invoked when any
                               ///< disk request finishes.
     void *handlerArg;  ///< Argument to interrupt handler.
@@ -21,6 +21,7 @@
 
 
 #include "interrupt.hh"
+#include "lib/slab.hh"
 #include "threads/system.hh"
 
 #include <limits.h>
@@ -65,13 +66,27 @@ PendingInterrupt::PendingInterrupt(VoidFunctionPtr func, void *param,
     type    = kind;
 }
 
+static Slab<PendingInterrupt> pendingSlab;
+
+void *
+PendingInterrupt::operator new(size_t size)
+{
+    ASSERT(size == sizeof (PendingInterrupt));
+    return pendingSlab.Allocate();
+}
+
+void
+PendingInterrupt::operator delete(void *p)
+{
+    pendingSlab.Free(p);
+}
+
 /// Initialize the simulation of hardware device interrupts.
 ///
 /// Interrupts start disabled, with no interrupts pending, etc.
 Interrupt::Interrupt()
 {
     level         = INT_OFF;
-    pending       = new List<PendingInterrupt *>;
     inHandler     = false;
     yieldOnReturn = false;
     status        = SYSTEM_MODE;
@@ -80,9 +95,8 @@ Interrupt::Interrupt()
 /// De-allocate the data structures needed by the interrupt simulation.
 Interrupt::~Interrupt()
 {
-    while (!pending->IsEmpty())
-        delete pending->Pop();
-    delete pending;
+    while (!pending.IsEmpty())
+        delete pending.Pop();
 }
 
 /// Change interrupts to be enabled or disabled, without advancing the
@@ -235,29 +249,41 @@ Interrupt::Halt()
 void
 Interrupt::RestartTicks()
 {
-    List<PendingInterrupt *> *oldPending = pending;
-    pending = new List<PendingInterrupt *>;
-
-    PendingInterrupt *i;
-    unsigned          oldWhen = 0;
-    while ((i = oldPending->SortedPop((int *) &oldWhen)) != nullptr)
-    {
-        unsigned newWhen = oldWhen - stats->totalTicks;
-        pending->SortedInsert(i, newWhen);
+    // Every interrupt moves back by the same amount, so the list stays
+    // sorted.  Those already due stay due.
+    for (PendingInterrupt *i = pending.Head(); i != nullptr;
+           i = pending.Next(i)) {
+        unsigned oldWhen = i->when;
+        i->when = oldWhen > stats->totalTicks
+                  ? oldWhen - stats->totalTicks : 0;
         DEBUG('x', "Interrupt at time %u re-scheduled at new time %u.\n",
-              oldWhen, newWhen);
+              oldWhen, i->when);
     }
 
-    delete oldPending;
     stats->totalTicks = 0;
     stats->tickResets += 1;
 }
 #endif
 
+/// Put `toOccur` in the list of pending interrupts, which is sorted by
+/// time, after those that are to occur at the same time or earlier.
+void
+Interrupt::Insert(PendingInterrupt *toOccur)
+{
+    ASSERT(toOccur != nullptr);
+
+    PendingInterrupt *next = pending.Head();
+    while (next != nullptr && next->when <= toOccur->when)
+        next = pending.Next(next);
+    pending.InsertBefore(toOccur, next);
+}
+
 /// Arrange for the CPU to be interrupted when simulated time reaches `now +
 /// when`.
 ///
-/// Implementation: just put it on a sorted list.
+/// Implementation: just put it on a sorted list.  Interrupts are disabled
+/// meanwhile, without advancing the time, so that the preemptive scheduler
+/// cannot switch threads while the list or the slab are being updated.
 ///
 /// NOTE: the Nachos kernel should not call this routine directly.  Instead,
 /// it is only called by the hardware device simulators.
@@ -288,13 +314,15 @@ Interrupt::Schedule(VoidFunctionPtr handler, void *arg,
 #endif
 
     unsigned when = stats->totalTicks + fromNow;
+    IntStatus oldLevel = level;
+    level = INT_OFF;
     PendingInterrupt *toOccur = new PendingInterrupt(handler, arg,
                                                      when, type);
+    Insert(toOccur);
+    level = oldLevel;
 
     DEBUG('i', "Scheduling interrupt handler the %s at time = %u\n",
           INT_TYPE_NAMES[type], when);
-
-    pending->SortedInsert(toOccur, when);
 }
 
 /// Check if an interrupt is scheduled to occur, and if so, fire it off.
@@ -309,31 +337,29 @@ bool
 Interrupt::CheckIfDue(bool advanceClock)
 {
     MachineStatus old = status;
-    unsigned      when;
 
     ASSERT(level == INT_OFF);  // Interrupts need to be disabled, to invoke
                                // an interrupt handler.
     if (debug.IsEnabled('i'))
         DumpState();
-    PendingInterrupt *toOccur = pending->SortedPop((int *) &when);
+    PendingInterrupt *toOccur = pending.Head();
 
     if (toOccur == nullptr)  // No pending interrupts.
-    return false;
+        return false;
 
+    unsigned when = toOccur->when;
     if (advanceClock && when > stats->totalTicks) {  // Advance the clock.
         stats->idleTicks += (when - stats->totalTicks);
         stats->totalTicks = when;
-    } else if (when > stats->totalTicks) {  // Not time yet, put it back.
-        pending->SortedInsert(toOccur, when);
+    } else if (when > stats->totalTicks)  // Not time yet, leave it.
         return false;
-    }
 
     // Check if there is nothing more to do, and if so, quit.
     if (status == IDLE_MODE && toOccur->type == TIMER_INT
-          && pending->IsEmpty()) {
-        pending->SortedInsert(toOccur, when);
+          && pending.Next(toOccur) == nullptr)
         return false;
-    }
+
+    pending.Remove(toOccur);
 
     DEBUG('i', "Invoking interrupt handler for the %s at time %u\n",
             INT_TYPE_NAMES[toOccur->type], toOccur->when);
@@ -387,10 +413,12 @@ Interrupt::DumpState()
 {
     printf("Time: %u, interrupts %s\n",
            stats->totalTicks, INT_LEVEL_NAMES[level]);
-    if (pending->IsEmpty())
+    if (pending.IsEmpty())
         printf("No pending interrupts\n");
     else {
         printf("Pending interrupts:\n");
-        pending->Apply(PrintPending);
+        for (PendingInterrupt *i = pending.Head(); i != nullptr;
+               i = pending.Next(i))
+            PrintPending(i);
     }
 }
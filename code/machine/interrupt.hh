@@ -36,7 +36,7 @@
 #define NACHOS_MACHINE_INTERRUPT__HH
 
 
-#include "lib/list.hh"
+#include "lib/intrusive_list.hh"
 
 
 /// Interrupts can be disabled (`INT_OFF`) or enabled (`INT_ON`).
@@ -81,12 +81,18 @@ public:
     PendingInterrupt(VoidFunctionPtr func, void *param,
                      unsigned time, IntType kind);
 
+    /// Pending interrupts come and go all the time, so they are kept in a
+    /// slab rather than on the host heap.
+    static void *operator new(size_t size);
+    static void operator delete(void *p);
+
     VoidFunctionPtr handler;  ///< The function (in the hardware device
                               ///< emulator) to call when the interrupt
                               ///< occurs.
     void *arg;  ///< The argument to the function.
     unsigned when;  ///< When the interrupt is supposed to fire.
     IntType type;  ///< For debugging.
+    ListLink link;  ///< Place in the list of pending interrupts.
 };
 
 /// The following class defines the data structures for the simulation
@@ -147,8 +153,9 @@ public:
 
 private:
     IntStatus level;  ///< Are interrupts enabled or disabled?
-    List<PendingInterrupt *> *pending;  ///< The list of interrupts scheduled
-                                        ///< to occur in the future.
+    /// The list of interrupts scheduled to occur in the future, sorted by
+    /// time.
+    IntrusiveList<PendingInterrupt, &PendingInterrupt::link> pending;
     bool inHandler;  ///< True if we are running an interrupt handler.
     bool yieldOnReturn;  ///< True if we are to context switch on return from
                          ///< the interrupt handler.
@@ -156,6 +163,9 @@ private:
 
     /// These functions are internal to the interrupt simulation code.
 
+    /// Put `toOccur` in `pending`, after those that occur at the same time.
+    void Insert(PendingInterrupt *toOccur);
+
     /// Check if an interrupt is supposed to occur now.
     bool CheckIfDue(bool advanceClock);
 
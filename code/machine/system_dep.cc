@@ -196,6 +196,38 @@ Unlink(const char *name)
     return unlink(name);
 }
 
+/// Map the first `nBytes` of an open file into memory.  Changes to the
+/// memory are changes to the file, and are seen by anyone using it.
+///
+/// Abort if the mapping fails.
+char *
+MapFile(int fd, size_t nBytes)
+{
+    void *address = mmap(nullptr, nBytes, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, fd, 0);
+    ASSERT(address != MAP_FAILED);
+    return (char *) address;
+}
+
+/// Wait until the changes to a mapped file are written to the device
+/// holding it.
+void
+SyncMappedFile(char *address, size_t nBytes)
+{
+    ASSERT(address != nullptr);
+    int retVal = msync(address, nBytes, MS_SYNC);
+    ASSERT(retVal >= 0);
+}
+
+/// Remove a mapping made by `MapFile`.
+void
+UnmapFile(char *address, size_t nBytes)
+{
+    ASSERT(address != nullptr);
+    int retVal = munmap(address, nBytes);
+    ASSERT(retVal >= 0);
+}
+
 /// Open an interprocess communication (IPC) connection.
 ///
 /// For now, just open a datagram port where other Nachos (simulating
@@ -357,23 +389,27 @@ Random()
 /// Particularly useful for catching overflow beyond fixed-size thread
 /// execution stacks.
 ///
+/// The array starts at a page boundary, and takes whole pages.
+///
 /// Note: Just return the useful part!
 ///
 /// * `size` -- amount of useful space needed (in bytes).
 char *
 AllocBoundedArray(unsigned size)
 {
-    int   pgSize = getpagesize();
-    char *ptr    = new char [pgSize * 2 + size];
-
-#ifndef HOST_LINUX
-    mprotect(ptr, pgSize, 0);
-    mprotect(ptr + pgSize + size, pgSize, 0);
-#endif
+    unsigned long pgSize = getpagesize();
+    unsigned long length = DivRoundUp((unsigned long) size, pgSize) * pgSize;
+    char *ptr = (char *) mmap(nullptr, length + 2 * pgSize,
+                              PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    ASSERT(ptr != MAP_FAILED);
+
+    mprotect(ptr, pgSize, PROT_NONE);
+    mprotect(ptr + pgSize + length, pgSize, PROT_NONE);
     return ptr + pgSize;
 }
 
-/// Deallocate an array of integers, unprotecting its two boundary pages.
+/// Deallocate an array of integers, along with its two boundary pages.
 ///
 /// * `ptr` is the array to be deallocated.
 /// * `size` is the amount of useful space in the array (in bytes).
@@ -383,11 +419,7 @@ DeallocBoundedArray(const char *ptr, unsigned size)
     ASSERT(ptr != nullptr);
     ASSERT(size > 0);
 
-    int pgSize = getpagesize();
-
-#ifndef HOST_LINUX
-    mprotect(ptr - pgSize, pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
-    mprotect(ptr + size,   pgSize, PROT_READ | PROT_WRITE | PROT_EXEC);
-#endif
-    delete [] (ptr - pgSize);
+    unsigned long pgSize = getpagesize();
+    unsigned long length = DivRoundUp((unsigned long) size, pgSize) * pgSize;
+    munmap((char *) ptr - pgSize, length + 2 * pgSize);
 }
@@ -44,6 +44,16 @@ extern void Close(int fd);
 
 extern bool Unlink(const char *name);
 
+/// Memory mapped files: `mmap`/`msync`/`munmap`, and check for error.
+///
+/// For simulating the disk without a system call per sector.
+
+extern char *MapFile(int fd, size_t nBytes);
+
+extern void SyncMappedFile(char *address, size_t nBytes);
+
+extern void UnmapFile(char *address, size_t nBytes);
+
 /// Interprocess communication operations, for simulating the network.
 
 extern int OpenSocket();
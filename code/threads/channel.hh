@@ -0,0 +1,201 @@
+/// Bounded channels, for passing messages between threads.
+///
+/// Unlike a `Port`, where every `Send` waits for a `Receive`, a channel
+/// holds up to a given number of messages, so that a sender only waits
+/// when the channel is full and a receiver only when it is empty.  A
+/// receiver can also take every message waiting at once, so that a
+/// producer and a consumer do not need a context switch per message.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_CHANNEL__HH
+#define NACHOS_THREADS_CHANNEL__HH
+
+
+#include "synch.hh"
+
+
+/// A channel for messages of type `T`, delivered in the order they were
+/// sent.
+template <class T>
+class Channel {
+public:
+
+    /// Initialize a channel with room for `capacity` messages.
+    Channel(const char *debugName, unsigned capacity);
+
+    /// Messages still in the channel are lost.
+    ~Channel();
+
+    const char *GetName() const;
+
+    /// Put `message` in the channel, waiting while it is full.
+    void Send(T message);
+
+    /// Put `message` in the channel, unless it is full.
+    ///
+    /// Returns whether it was sent.
+    bool TrySend(T message);
+
+    /// Take the oldest message, waiting while the channel is empty.
+    T Receive();
+
+    /// Take the oldest message into `*message`, unless the channel is
+    /// empty.
+    ///
+    /// Returns whether there was one.
+    bool TryReceive(T *message);
+
+    /// Take up to `max` messages into `messages`, oldest first, waiting
+    /// while the channel is empty.
+    ///
+    /// Returns how many were taken, at least one.
+    unsigned ReceiveBatch(T *messages, unsigned max);
+
+private:
+
+    /// Put and take messages, and wake up a thread that may be waiting for
+    /// it; the lock must be held.
+    void Put(T message);
+    T Take();
+
+    const char *name;
+
+    /// Messages, in a circular buffer: `count` of them starting from
+    /// `first`.
+    T *buffer;
+    unsigned capacity;
+    unsigned first;
+    unsigned count;
+
+    Lock *lock;
+    Condition *notFull;
+    Condition *notEmpty;
+};
+
+
+template <class T>
+Channel<T>::Channel(const char *debugName, unsigned _capacity)
+{
+    ASSERT(_capacity > 0);
+
+    name     = debugName;
+    buffer   = new T [_capacity];
+    capacity = _capacity;
+    first    = 0;
+    count    = 0;
+    lock     = new Lock(debugName);
+    notFull  = new Condition(debugName, lock);
+    notEmpty = new Condition(debugName, lock);
+}
+
+template <class T>
+Channel<T>::~Channel()
+{
+    delete notFull;
+    delete notEmpty;
+    delete lock;
+    delete [] buffer;
+}
+
+template <class T>
+const char *
+Channel<T>::GetName() const
+{
+    return name;
+}
+
+template <class T>
+void
+Channel<T>::Put(T message)
+{
+    ASSERT(count < capacity);
+
+    buffer[(first + count) % capacity] = message;
+    count++;
+    notEmpty->Signal();
+}
+
+template <class T>
+T
+Channel<T>::Take()
+{
+    ASSERT(count > 0);
+
+    T message = buffer[first];
+    first = (first + 1) % capacity;
+    count--;
+    notFull->Signal();
+    return message;
+}
+
+template <class T>
+void
+Channel<T>::Send(T message)
+{
+    lock->Acquire();
+    while (count == capacity)
+        notFull->Wait();
+    Put(message);
+    lock->Release();
+}
+
+template <class T>
+bool
+Channel<T>::TrySend(T message)
+{
+    lock->Acquire();
+    bool sent = count < capacity;
+    if (sent)
+        Put(message);
+    lock->Release();
+    return sent;
+}
+
+template <class T>
+T
+Channel<T>::Receive()
+{
+    lock->Acquire();
+    while (count == 0)
+        notEmpty->Wait();
+    T message = Take();
+    lock->Release();
+    return message;
+}
+
+template <class T>
+bool
+Channel<T>::TryReceive(T *message)
+{
+    ASSERT(message != nullptr);
+
+    lock->Acquire();
+    bool received = count > 0;
+    if (received)
+        *message = Take();
+    lock->Release();
+    return received;
+}
+
+template <class T>
+unsigned
+Channel<T>::ReceiveBatch(T *messages, unsigned max)
+{
+    ASSERT(messages != nullptr);
+    ASSERT(max > 0);
+
+    lock->Acquire();
+    while (count == 0)
+        notEmpty->Wait();
+    unsigned taken = 0;
+    while (taken < max && count > 0)
+        messages[taken++] = Take();
+    lock->Release();
+    return taken;
+}
+
+
+#endif
@@ -3,6 +3,8 @@
 
 const int NUM_QUEUES = 64;
 const int MIN_PRIORITY = 0;
+const unsigned DEFAULT_TICKETS = 100;
+const unsigned MAX_TICKETS = 1 << 16;  // Keeps strides from reaching 0.
 const int NUM_FILE_DESCRIPTORS = 16;
 const int MAX_READ_SIZE = 1024*1024;
 const int MAX_WRITE_SIZE = 1024*1024;
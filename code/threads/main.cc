@@ -10,10 +10,13 @@
 /// Usage
 /// =====
 ///
-///     nachos [-d <debugflags>] [-p] [-rs <random seed #>] [-z]
-///            [-s] [-x <nachos file>] [-tc <consoleIn> <consoleOut>]
-///            [-f] [-cp <unix file> <nachos file>] [-pr <nachos file>]
-///            [-rm <nachos file>] [-ls] [-D] [-tf]
+///     nachos [-d <debugflags>] [-p [<time slice>]] [-rs <random seed #>]
+///            [-mlfq] [-stride] [-z] [-ts] [-tcr] [-tbw] [-tpt] [-tch]
+///            [-tj] [-tst] [-tpi] [-s] [-x <nachos file>] [-f]
+///            [-tc <consoleIn> <consoleOut>] [-dt <number of tracks>]
+///            [-dm] [-dms] [-cp <unix file> <nachos file>] [-pr <nachos file>]
+///            [-rm <nachos file>] [-md <nachos dir>] [-cd <nachos dir>]
+///            [-ls] [-D] [-ck] [-tf] [-tfm] [-tfd] [-tfc] [-tfk]
 ///            [-n <network reliability>] [-id <machine id>]
 ///            [-tn <other machine id>]
 ///
@@ -22,9 +25,23 @@
 ///
 /// * `-d`  -- causes certain debugging messages to be printed (cf.
 ///   `utility.hh`).
-/// * `-p`  -- enables preemptive multitasking for kernel threads.
+/// * `-p`  -- enables preemptive multitasking for kernel threads, with a
+///   time slice of the given number of microseconds of host CPU time
+///   (1000 by default).
 /// * `-rs` -- causes `Yield` to occur at random (but repeatable) spots.
+/// * `-mlfq` -- adjusts thread priorities by multi-level feedback, instead
+///   of keeping them fixed.
+/// * `-stride` -- shares the CPU among threads of the same priority in
+///   proportion to their tickets, instead of in turns.
 /// * `-z`  -- prints version and copyright information, and exits.
+/// * `-ts` -- measures the cost of a context switch.
+/// * `-tcr` -- measures the cost of creating and deleting a thread.
+/// * `-tbw` -- measures the cost of blocking and waking a thread.
+/// * `-tpt` -- measures the cost of sending a message through a port.
+/// * `-tch` -- measures the cost of sending a message through a channel.
+/// * `-tj` -- spawns and joins thousands of threads.
+/// * `-tst` -- shows how threads with different tickets share the CPU.
+/// * `-tpi` -- tests priority inheritance through chains of locks.
 ///
 /// *USER_PROGRAM* options
 /// ----------------------
@@ -37,12 +54,26 @@
 /// -----------------
 ///
 /// * `-f`  -- causes the physical disk to be formatted.
+/// * `-dt` -- sets the number of tracks of the disk being formatted; each
+///   track has `SECTORS_PER_TRACK` sectors.
+/// * `-dm` -- keeps the physical disk mapped into memory, which is faster
+///   for the host and takes the same simulated time.
+/// * `-dms` -- like `-dm`, and waits for the disk to reach the host's disk
+///   on exit.
 /// * `-cp` -- copies a file from UNIX to Nachos.
 /// * `-pr` -- prints a Nachos file to standard output.
 /// * `-rm` -- removes a Nachos file from the file system.
-/// * `-ls` -- lists the contents of the Nachos directory.
+/// * `-md` -- creates a Nachos directory.
+/// * `-cd` -- changes the current Nachos directory, for the options that
+///   follow.
+/// * `-ls` -- lists the contents of the current Nachos directory.
 /// * `-D`  -- prints the contents of the entire file system.
+/// * `-ck` -- checks the file system in the background.
 /// * `-tf` -- tests the performance of the Nachos file system.
+/// * `-tfm` -- tests the performance of file creation and removal.
+/// * `-tfd` -- tests the performance of path lookups.
+/// * `-tfc` -- tests concurrent accesses to a file.
+/// * `-tfk` -- tests the performance of file system checks.
 ///
 /// *NETWORK* options
 /// -----------------
@@ -72,9 +103,21 @@
 // External functions used by this file.
 
 void ThreadTest();
+void SwitchBenchmark();
+void CreateBenchmark();
+void BlockWakeBenchmark();
+void PortBenchmark();
+void ChannelBenchmark();
+void ThreadStressTest();
+void ShareTest();
+void PriorityInheritanceTest();
 void Copy(const char *unixFile, const char *nachosFile);
 void Print(const char *file);
 void PerformanceTest(void);
+void MetadataTest();
+void DirectoryTest();
+void ConcurrencyTest();
+void CheckTest();
 void StartProcess(const char *file);
 void ConsoleTest(const char *in, const char *out);
 void MailTest(int networkID);
@@ -112,6 +155,22 @@ main(int argc, char **argv)
             PrintVersion();
             return 0;
         }
+        if (!strcmp(*argv, "-ts"))           // Time context switches.
+            SwitchBenchmark();
+        if (!strcmp(*argv, "-tcr"))          // Time thread creation.
+            CreateBenchmark();
+        if (!strcmp(*argv, "-tbw"))          // Time blocking and waking.
+            BlockWakeBenchmark();
+        if (!strcmp(*argv, "-tpt"))          // Time message passing.
+            PortBenchmark();
+        if (!strcmp(*argv, "-tch"))          // Time buffered messages.
+            ChannelBenchmark();
+        if (!strcmp(*argv, "-tj"))           // Spawn and join threads.
+            ThreadStressTest();
+        if (!strcmp(*argv, "-tst"))          // Test CPU shares.
+            ShareTest();
+        if (!strcmp(*argv, "-tpi"))          // Test priority inheritance.
+            PriorityInheritanceTest();
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-x")) {          // Run a user program.
             ASSERT(argc > 1);
@@ -144,14 +203,32 @@ main(int argc, char **argv)
             ASSERT(argc > 1);
             fileSystem->Remove(*(argv + 1));
             argCount = 2;
+        } else if (!strcmp(*argv, "-md")) {  // Make Nachos directory.
+            ASSERT(argc > 1);
+            fileSystem->MakeDirectory(*(argv + 1));
+            argCount = 2;
+        } else if (!strcmp(*argv, "-cd")) {  // Change Nachos directory.
+            ASSERT(argc > 1);
+            fileSystem->ChangeDirectory(*(argv + 1));
+            argCount = 2;
         } else if (!strcmp(*argv, "-ls")) {  // List Nachos directory.
             fileSystem->List();
             printf("\n");
         } else if (!strcmp(*argv, "-D")) {   // Print entire filesystem.
             fileSystem->Print();
             printf("\n");
-        } else if (!strcmp(*argv, "-tf"))    // Performance test.
+        } else if (!strcmp(*argv, "-ck"))    // Check the file system.
+            fileSystem->CheckInBackground();
+        else if (!strcmp(*argv, "-tf"))      // Performance test.
             PerformanceTest();
+        else if (!strcmp(*argv, "-tfm"))     // Metadata test.
+            MetadataTest();
+        else if (!strcmp(*argv, "-tfd"))     // Directory test.
+            DirectoryTest();
+        else if (!strcmp(*argv, "-tfc"))     // Concurrency test.
+            ConcurrencyTest();
+        else if (!strcmp(*argv, "-tfk"))     // Check test.
+            CheckTest();
 #endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-tn")) {
@@ -164,6 +241,11 @@ main(int argc, char **argv)
 #endif // NETWORK
     }
 
+#ifdef FILESYS
+    fileSystem->Sync();  // Do not leave the changes above waiting in the
+                         // journal.
+#endif
+
 #ifdef THREADS
     ThreadTest();
 #endif
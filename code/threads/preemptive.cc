@@ -12,163 +12,109 @@
 #include "system.hh"
 
 // UNIX and Linux-specific headers.
-#include <unistd.h>
-#include <sys/ptrace.h>
-#include <sys/wait.h>
-#include <sys/user.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <ucontext.h>
 
 
-static void ContextSwitch();
-static void MonitorProcess(int childPid, unsigned long timeSliceLength);
-static void LetMeBeMonitored();
+static void TimeSliceHandler(int signalNumber, siginfo_t *info,
+                             void *context);
+static bool InNachosCode(const void *context);
 
-static bool inContextSwitch = false;
+static bool timerSet = false;
 
 /// Set up the preemptive scheduler.
 ///
-/// * `timeSliceLength` means how many machine instructions will last the
-///   time slice for every kernel thread.
+/// The timer counts the CPU time of Nachos itself, so that the slices do
+/// not run out while the host is busy with something else.
+///
+/// * `timeSliceLength` means how many microseconds will last the time
+///   slice for every kernel thread.
 void
 PreemptiveScheduler::SetUp(unsigned long timeSliceLength)
 {
-    int childPid = fork();
-    switch (childPid) {
-        case -1:
-            DEBUG('p',
-                  "Preemptive scheduler: unable to launch child process\n");
-            ASSERT(false);
-            break;
-
-        // Child process: original Nachos code.
-        case 0:
-            LetMeBeMonitored();
-            // Resume Nachos execution as a child process.
-            return;
-
-        // Parent process: monitor code.
-        default:
-            MonitorProcess(childPid, timeSliceLength);
+    ASSERT(timeSliceLength > 0);
+
+    struct sigaction action;
+    action.sa_sigaction = TimeSliceHandler;
+    sigemptyset(&action.sa_mask);
+    // The handler may switch to another thread, which must still be able
+    // to get the signal; and it must not break host calls in the middle.
+    action.sa_flags = SA_SIGINFO | SA_NODEFER | SA_RESTART;
+    if (sigaction(SIGVTALRM, &action, nullptr) != 0) {
+        DEBUG('p', "Preemptive scheduler: unable to set the handler\n");
+        ASSERT(false);
     }
-}
 
-void
-LetMeBeMonitored()
-{
-    // Allow the parent process to ptrace me.
-    ptrace(PTRACE_TRACEME, 0, nullptr, nullptr);
-
-    DEBUG ('p', "Preemptive scheduler: child process will be ptraced\n");
+    struct itimerval slice;
+    slice.it_interval.tv_sec = timeSliceLength / 1000000;
+    slice.it_interval.tv_usec = timeSliceLength % 1000000;
+    slice.it_value = slice.it_interval;
+    if (setitimer(ITIMER_VIRTUAL, &slice, nullptr) != 0) {
+        DEBUG('p', "Preemptive scheduler: unable to set the timer\n");
+        ASSERT(false);
+    }
+    timerSet = true;
 
-    // Raise a signal to bring back control to the parent.
-    raise(SIGUSR1);
+    DEBUG('p', "Preemptive scheduler: time slice of %lu microseconds\n",
+          timeSliceLength);
 }
 
-void
-MonitorProcess(int childPid, unsigned long timeSliceLength)
+PreemptiveScheduler::~PreemptiveScheduler()
 {
-    // Machine instruction counter.
-    long long instructionCounter = 1;
-
-    while (true) {
-
-        // Wait for child process.
-        int wait_val;
-        wait(&wait_val);
-        if (WIFEXITED(wait_val)) {
-            DEBUG('p', "Preemptive scheduler: child process terminated\n");
-            break;
-        }
-
-        // Increment instruction counter.
-        instructionCounter++;
-
-        // From time to time, insert machine code to force a context switch.
-        if (instructionCounter % timeSliceLength == 0)
-        {
-            // Get child value of `inContextSwitch`.
-            long incs = ptrace(PTRACE_PEEKDATA, childPid,
-                               (long) &inContextSwitch, nullptr);
-
-            if (incs == 0) {
-                DEBUG('p', "Preemptive scheduler: "
-                           "forcing a context switch at instruction %lld\n",
-                      instructionCounter);
-
-                struct user_regs_struct regs;
-
-                // Get child process registers.
-                ptrace(PTRACE_GETREGS,  childPid, nullptr, &regs);
-
-                // Build a call stack frame by inserting EIP/RIP on top of
-                // the stack.
-#ifdef HOST_i386
-                regs.esp = regs.esp - 4;
-                ptrace(PTRACE_POKEDATA, childPid, regs.esp, regs.eip);
-                // Force a jump to `ContextSwitch`.
-                regs.eip = (long) ContextSwitch;
-#elif defined(HOST_x86_64)
-                regs.rsp = regs.rsp - 8;
-                ptrace(PTRACE_POKEDATA, childPid, regs.rsp, regs.rip);
-                // Force a jump to ContextSwitch`.
-                regs.rip = (long long) ContextSwitch;
-#endif
-
-                // Store new register values in the child process. The child
-                // will now make a call to `ContextSwitch`.
-                ptrace(PTRACE_SETREGS, childPid, nullptr, &regs);
-            }
-        }
-
-        // Resume child execution.
-        ptrace(PTRACE_SINGLESTEP, childPid, nullptr, nullptr);
-    }
-
-    DEBUG('p', "Preemptive scheduler: Finished\n");
-    exit(0);
+    if (!timerSet)
+        return;
+    struct itimerval off = {};
+    setitimer(ITIMER_VIRTUAL, &off, nullptr);
+    signal(SIGVTALRM, SIG_DFL);
+    timerSet = false;
 }
 
-
 /// Force a context switch.
 ///
-/// This call is made asynchronously from the parent process, using `ptrace`
-/// features.
+/// Yielding here is only safe if the thread could have yielded by itself at
+/// the point where it was stopped: interrupts must be enabled, and the
+/// thread must be running the kernel's own code, not the host's libraries,
+/// whose locks and buffers the next thread may need.  A thread running a
+/// user program is also left to finish its instruction.  Otherwise, the
+/// thread yields the next time Nachos checks for interrupts.
+///
+/// When the thread is switched back in, it returns from the handler to
+/// where it was stopped.
 static void
-ContextSwitch(void)
+TimeSliceHandler(int signalNumber, siginfo_t *info, void *context)
 {
-    // Prevent register loss: save all registers.
-#ifdef HOST_i386
-    __asm__ ("pushal");
-    __asm__ ("subl $8, %esp");
-#elif defined(HOST_x86_64)
-    // Push all registers.
-    __asm__ ("push %rax; push %rbx; push %rcx; push %rdx");
-    __asm__ ("push %rsi; push %rdi; push %rsp; push %rbp");
-    __asm__ ("push %r8; push %r9; push %r10; push %r11; "
-             "push %r12; push %r13; push %r14; push %r15");
-    __asm__ ("sub $16, %rsp");
-#endif
-
-    inContextSwitch = true;
-
-    // Make a context switch if interrupts are enabled.
-    if (interrupt->GetLevel() == INT_ON) {
-        inContextSwitch = false;
+    if (interrupt->GetLevel() == INT_ON
+          && interrupt->GetStatus() == SYSTEM_MODE
+          && InNachosCode(context)) {
+        DEBUG('p', "Preemptive scheduler: forcing a context switch\n");
+        int savedErrno = errno;
         currentThread->Yield();
-    } else {
+        errno = savedErrno;
+    } else
         interrupt->YieldOnReturn();
-        inContextSwitch = false;
-    }
+}
+
+/// Bounds of the program's own code, set by the linker.
+extern "C" const char __executable_start[], etext[];
 
-    // Restore old register values.
+/// Tell whether the thread was stopped by the signal in the code of Nachos
+/// itself, rather than in a shared library.
+///
+/// * `context` is the context of the thread when it was stopped.
+static bool
+InNachosCode(const void *context)
+{
+    const mcontext_t *machineContext
+      = &((const ucontext_t *) context)->uc_mcontext;
 #ifdef HOST_i386
-    __asm__ ("addl $8, %esp");
-    __asm__ ("popal");
+    const char *pc = (const char *) machineContext->gregs[REG_EIP];
 #elif defined(HOST_x86_64)
-    __asm__ ("add $16, %rsp");
-    // Pop all registers.
-    __asm__ ("pop %r15; pop %r14; pop %r13; pop %r12; "
-             "pop %r11; pop %r10; pop %r9; pop %r8");
-    __asm__ ("pop %rbp; pop %rsp; pop %rdi; pop %rsi");
-    __asm__ ("pop %rdx; pop %rcx; pop %rbx; pop %rax");
+    const char *pc = (const char *) machineContext->gregs[REG_RIP];
+#else
+    const char *pc = nullptr;  // Do not know where to look: never yield.
+    (void) machineContext;
 #endif
+    return __executable_start <= pc && pc < etext;
 }
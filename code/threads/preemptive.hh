@@ -1,6 +1,12 @@
 /// Extension to make kernel threads be periodically preempted.
 ///
-/// It only works on Linux x86 environments.
+/// A host interval timer delivers a signal every time slice.  The running
+/// thread yields from within the signal handler if it is safe to do so;
+/// otherwise it yields at the next point where Nachos checks for
+/// interrupts.
+///
+/// It only works on POSIX hosts; the handler can only yield right away on
+/// Linux x86 environments.
 ///
 /// Copyright (c) 2007      Universidad de Las Palmas de Gran Canaria.
 ///               2016-2017 Docentes de la Universidad Nacional de Rosario.
@@ -19,13 +25,13 @@ public:
     PreemptiveScheduler()
     {}
 
-    ~PreemptiveScheduler()
-    {}
+    /// Stop the timer, if it was set up.
+    ~PreemptiveScheduler();
 
     /// Set up time slicing between kernel threads.
     ///
-    /// * `timeSliceLength` is the time slice duration, measured in native
-    ///   x86 machine instructions.
+    /// * `timeSliceLength` is the time slice duration, measured in
+    ///   microseconds of host CPU time.
     void SetUp(unsigned long timeSliceLength);
 
 };
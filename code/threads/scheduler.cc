@@ -9,8 +9,9 @@
 /// needed to wait for a lock, and the lock was busy, we would end up calling
 /// `FindNextToRun`, and that would put us in an infinite loop.
 ///
-/// Very simple implementation -- no priorities, straight FIFO.  Might need
-/// to be improved in later assignments.
+/// Threads run by priority.  The priorities are either fixed, or adjusted by
+/// multi-level feedback; threads of the same priority take turns, or share
+/// the CPU by stride scheduling (cf. `SchedulingPolicy`).
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2018 Docentes de la Universidad Nacional de Rosario.
@@ -23,42 +24,130 @@
 #include "globals.hh"
 
 
-/// Initialize the list of ready but not running threads to empty.
-Scheduler::Scheduler()
+/// Every so many ticks, the feedback policy brings every thread back to its
+/// priority, so that those moved down do not starve.
+static const unsigned BOOST_INTERVAL = 50 * TIMER_TICKS;
+
+/// Pass added per tick run by a thread with one ticket.
+static const unsigned long long STRIDE_ONE = 1 << 20;
+
+static_assert(STRIDE_ONE / MAX_TICKETS > 0,
+              "every thread must advance its pass when it runs");
+
+/// Initialize the queues of ready but not running threads to empty.
+///
+/// * `_policy` tells how priorities change over time.
+Scheduler::Scheduler(SchedulingPolicy _policy)
 {
+    policy = _policy;
     for (size_t i = 0; i < NUM_QUEUES; ++i) {
-        readyList[i] = new List<Thread *>;
+        readyHead[i] = nullptr;
+        readyTail[i] = nullptr;
     }
+    readyLevels = 0;
+    runningSince = 0;
+    sliceStart = 0;
+    userTicksSince = 0;
+    globalPass = 0;
+    boostEpoch = 0;
+    nextBoost = BOOST_INTERVAL;
 }
 
-/// De-allocate the list of ready threads.
+/// The queues own nothing: threads are deleted elsewhere.
 Scheduler::~Scheduler()
 {
-    for (size_t i = 0; i < NUM_QUEUES; ++i) {
-        delete readyList[i];
-    }
 }
 
 /// Mark a thread as ready, but not running.
-/// Put it on the corresponding ready list, for later scheduling onto the CPU.
+/// Put it in its queue, for later scheduling onto the CPU.
 ///
 /// * `thread` is the thread to be put on the ready list.
-/// * `priority` is the initial priority of the thread.
 void
 Scheduler::ReadyToRun(Thread *thread)
 {
     ASSERT(thread != nullptr);
-    auto priority = thread->GetPriority();
-    ASSERT(0 <= priority && priority < NUM_QUEUES);
+
+    thread->SetStatus(READY);
+    thread->readySince = stats->totalTicks;
+    if (policy == STRIDE_SCHEDULING && thread->pass < globalPass)
+        thread->pass = globalPass;
+    Enqueue(thread);
+}
+
+/// Under stride scheduling, threads are kept by pass within each queue,
+/// after those with the same pass; otherwise they go last.
+void
+Scheduler::Enqueue(Thread *thread)
+{
+    unsigned priority = QueueFor(thread);
+    ASSERT(priority < NUM_QUEUES);
 
     DEBUG('t', "Putting thread %s on ready list, with priority %u\n",
         thread->GetName(), priority);
 
-    thread->SetStatus(READY);
-    readyList[priority]->Append(thread);
+    if (policy == STRIDE_SCHEDULING && readyTail[priority] != nullptr
+          && readyTail[priority]->pass > thread->pass) {
+        Thread **link = &readyHead[priority];
+        while ((*link)->pass <= thread->pass)
+            link = &(*link)->nextReady;
+        thread->nextReady = *link;
+        *link = thread;  // Not last, so the queue was not empty.
+        return;
+    }
+
+    thread->nextReady = nullptr;
+    if (readyTail[priority] == nullptr)
+        readyHead[priority] = thread;
+    else
+        readyTail[priority]->nextReady = thread;
+    readyTail[priority] = thread;
+    readyLevels |= (uint64_t) 1 << priority;
 }
 
-/// Return the next thread to be scheduled onto the CPU.
+/// The thread is looked for in the queue it was put in, which has not
+/// changed since: its priority can only change through `Reprioritize`.
+void
+Scheduler::Dequeue(Thread *thread)
+{
+    ASSERT(thread != nullptr);
+
+    unsigned priority = QueueFor(thread);
+    Thread *previous = nullptr;
+    Thread **link = &readyHead[priority];
+    while (*link != thread) {
+        ASSERT(*link != nullptr);
+        previous = *link;
+        link = &previous->nextReady;
+    }
+    *link = thread->nextReady;
+    if (readyTail[priority] == thread)
+        readyTail[priority] = previous;
+    if (readyHead[priority] == nullptr)
+        readyLevels &= ~((uint64_t) 1 << priority);
+    thread->nextReady = nullptr;
+}
+
+/// The thread's effective priority (cf. `Lock`).  Under the feedback
+/// policy, minus the queues it has been moved down, forgetting those if
+/// there has been a boost since.
+unsigned
+Scheduler::QueueFor(Thread *thread)
+{
+    unsigned priority = thread->effectivePriority;
+    if (policy == STRICT_PRIORITY)
+        return priority;
+
+    if (thread->boostEpoch != boostEpoch) {
+        thread->demotion = 0;
+        thread->sliceUsed = 0;
+        thread->boostEpoch = boostEpoch;
+    }
+    return thread->demotion < priority ? priority - thread->demotion
+                                       : MIN_PRIORITY;
+}
+
+/// Return the next thread to be scheduled onto the CPU: the first one in
+/// the highest priority queue that is not empty.
 ///
 /// If there are no ready threads, return null.
 ///
@@ -66,12 +155,18 @@ Scheduler::ReadyToRun(Thread *thread)
 Thread *
 Scheduler::FindNextToRun()
 {
-    for (size_t i = NUM_QUEUES - 1; i < NUM_QUEUES; --i) {
-        if (not readyList[i]->IsEmpty()) {
-            return readyList[i]->Pop();
-        }
+    if (readyLevels == 0)
+        return nullptr;
+
+    unsigned priority = 63 - __builtin_clzll(readyLevels);
+    Thread *thread = readyHead[priority];
+    readyHead[priority] = thread->nextReady;
+    if (readyHead[priority] == nullptr) {
+        readyTail[priority] = nullptr;
+        readyLevels &= ~((uint64_t) 1 << priority);
     }
-    return nullptr;
+    thread->nextReady = nullptr;
+    return thread;
 }
 
 /// Dispatch the CPU to `nextThread`.
@@ -103,6 +198,11 @@ Scheduler::Run(Thread *nextThread)
     oldThread->CheckOverflow();  // Check if the old thread had an undetected
                                  // stack overflow.
 
+    Account(oldThread);
+    nextThread->waitTicks += stats->totalTicks - nextThread->readySince;
+    if (nextThread->pass > globalPass)
+        globalPass = nextThread->pass;
+
     currentThread = nextThread;  // Switch to the next thread.
     currentThread->SetStatus(RUNNING);  // `nextThread` is now running.
 
@@ -136,27 +236,159 @@ Scheduler::Run(Thread *nextThread)
 #endif
 }
 
-/// Print the scheduler state -- in other words, the contents of the ready
-/// list.
+/// Give the CPU to the first ready thread, if any, and put the running one
+/// back in its queue.
 ///
-/// For debugging.
-static void
-ThreadPrint(Thread *t)
+/// Under stride scheduling the running thread is charged and queued first,
+/// and keeps the CPU if it still comes first.  Otherwise it gives way even
+/// to threads of lower priority.
+void
+Scheduler::Yield()
+{
+    if (policy == STRIDE_SCHEDULING) {
+        Account(currentThread);
+        ReadyToRun(currentThread);
+        Thread *nextThread = FindNextToRun();
+        if (nextThread == currentThread)
+            currentThread->SetStatus(RUNNING);
+        else
+            Run(nextThread);
+        return;
+    }
+
+    Thread *nextThread = FindNextToRun();
+    if (nextThread != nullptr) {
+        ReadyToRun(currentThread);
+        Run(nextThread);
+    }
+}
+
+/// Charge `thread`, which is running, for the ticks since it was last
+/// charged.
+void
+Scheduler::Account(Thread *thread)
+{
+    unsigned now = stats->totalTicks;
+    unsigned userTicks = stats->userTicks - userTicksSince;
+    thread->runTicks += now - runningSince;
+    thread->sliceUsed += now - sliceStart;
+    thread->userTicks += userTicks;
+    if (policy == STRIDE_SCHEDULING) {
+        unsigned charged = now - runningSince;
+#ifdef USER_PROGRAM
+        if (thread->space != nullptr)
+            charged = userTicks;
+#endif
+        thread->pass += charged * (STRIDE_ONE / thread->tickets);
+    }
+    runningSince = sliceStart = now;
+    userTicksSince = stats->userTicks;
+}
+
+/// Under the feedback policy, move the running thread down a queue once it
+/// has had the CPU for a whole time slice at its current queue, counting
+/// every turn, and boost everyone when it is time.  The thread is queued at
+/// its new place when it yields on return from the interrupt.
+void
+Scheduler::TimerTick()
 {
-    ASSERT(t != nullptr);
-    t->Print();
+    if (policy != FEEDBACK_PRIORITY)
+        return;
+
+    unsigned now = stats->totalTicks;
+    QueueFor(currentThread);  // Bring it up to date with the boosts.
+    currentThread->sliceUsed += now - sliceStart;
+    sliceStart = now;
+    if (currentThread->sliceUsed >= TIMER_TICKS) {
+        if (currentThread->demotion < NUM_QUEUES - 1)
+            currentThread->demotion++;
+        currentThread->sliceUsed = 0;
+        DEBUG('t', "Thread \"%s\" used up its time slice, now %u below "
+                   "its priority\n",
+              currentThread->GetName(), currentThread->demotion);
+    }
+    if (now >= nextBoost) {
+        Boost();
+        nextBoost = now + BOOST_INTERVAL;
+    }
+}
+
+/// Under the feedback policy, move the running thread up a queue, up to its
+/// priority: it is giving up the CPU before its time slice is over.
+void
+Scheduler::BlockedOnIO()
+{
+    if (policy != FEEDBACK_PRIORITY)
+        return;
+
+    QueueFor(currentThread);  // Bring it up to date with the boosts.
+    if (currentThread->demotion > 0) {
+        currentThread->demotion--;
+        currentThread->sliceUsed = 0;
+    }
 }
 
+/// A ready thread goes last in its new queue.
+void
+Scheduler::Reprioritize(Thread *thread, unsigned priority)
+{
+    ASSERT(thread != nullptr);
+    ASSERT(priority < NUM_QUEUES);
+
+    DEBUG('t', "Thread \"%s\" now runs at priority %u\n",
+          thread->GetName(), priority);
+
+    if (thread->status != READY) {
+        thread->effectivePriority = priority;
+        return;
+    }
+    Dequeue(thread);
+    thread->effectivePriority = priority;
+    Enqueue(thread);
+}
+
+/// Threads not in a queue are brought up to date when they are next
+/// queued; those in a queue are moved right away, highest first, so that
+/// they keep their order.
+void
+Scheduler::Boost()
+{
+    DEBUG('t', "Boosting every thread back to its priority\n");
+
+    boostEpoch++;
+    Thread *ready = nullptr;
+    Thread **last = &ready;
+    for (size_t i = NUM_QUEUES; i-- > 0; ) {
+        if (readyHead[i] == nullptr)
+            continue;
+        *last = readyHead[i];
+        last = &readyTail[i]->nextReady;
+        readyHead[i] = nullptr;
+        readyTail[i] = nullptr;
+    }
+    readyLevels = 0;
+    while (ready != nullptr) {
+        Thread *thread = ready;
+        ready = thread->nextReady;
+        Enqueue(thread);
+    }
+}
+
+/// Print the scheduler state -- in other words, the contents of the ready
+/// queues.
+///
+/// For debugging.
 void
 Scheduler::Print()
 {
     printf("Ready list contents:\n");
     for (size_t i = 0; i < NUM_QUEUES; ++i) {
         printf("Queue [%zu]: ", i);
-        if (readyList[i]->IsEmpty()) {
+        if (readyHead[i] == nullptr) {
             printf("empty.\n");
         } else {
-            readyList[i]->Apply(ThreadPrint);
+            for (Thread *t = readyHead[i]; t != nullptr; t = t->nextReady)
+                t->Print();
             puts("");
         }
     }
@@ -1,6 +1,6 @@
 /// Data structures for the thread dispatcher and scheduler.
 ///
-/// Primarily, the list of threads that are ready to run.
+/// Primarily, the queues of threads that are ready to run.
 ///
 /// Copyright (c) 1992-1993 The Regents of the University of California.
 ///               2016-2018 Docentes de la Universidad Nacional de Rosario.
@@ -12,7 +12,27 @@
 
 
 #include "thread.hh"
-#include "lib/list.hh"
+
+#include <stdint.h>
+
+/// How the scheduler treats the priorities of threads.
+enum SchedulingPolicy {
+    /// Every thread runs at the priority it is given.
+    STRICT_PRIORITY,
+
+    /// Multi-level feedback: a thread that uses up a whole time slice, over
+    /// one or more turns, goes down one queue, one that waits for a device
+    /// goes back up one, and every `BOOST_INTERVAL` ticks all of them go
+    /// back to their priority.
+    /// Threads never run above the priority they are given.
+    FEEDBACK_PRIORITY,
+
+    /// Stride scheduling: threads of the same priority share the CPU in
+    /// proportion to their tickets, instead of taking turns.  User programs
+    /// are charged the ticks spent in user mode; kernel threads, every tick
+    /// they run.
+    STRIDE_SCHEDULING
+};
 
 /// The following class defines the scheduler/dispatcher abstraction --
 /// the data structures and operations needed to keep track of which
@@ -20,10 +40,10 @@
 class Scheduler {
 public:
 
-    /// Initialize list of ready threads.
-    Scheduler();
+    /// Initialize the queues of ready threads, to be served following
+    /// `policy`.
+    Scheduler(SchedulingPolicy policy = STRICT_PRIORITY);
 
-    /// De-allocate ready list.
     ~Scheduler();
 
     /// Thread can be dispatched.
@@ -35,16 +55,68 @@ public:
     /// Cause `nextThread` to start running.
     void Run(Thread *nextThread);
 
+    /// Let another thread run, on behalf of `Thread::Yield`.
+    void Yield();
+
+    /// Called on every timer interrupt, on behalf of the running thread.
+    void TimerTick();
+
+    /// The running thread is about to wait for a device.
+    void BlockedOnIO();
+
+    /// Make `thread` run at `priority`, moving it to its new queue if it is
+    /// ready.
+    void Reprioritize(Thread *thread, unsigned priority);
+
     // Print contents of ready list.
     void Print();
 
 private:
 
-    // List of queues of threads that are ready to run, but not running.
-    // 0 is the lowest priority
-    List<Thread*> *readyList[NUM_QUEUES];
+    /// Charge the running thread for its time.
+    void Account(Thread *thread);
+
+    /// Queue where `thread` goes, following the policy.
+    unsigned QueueFor(Thread *thread);
+
+    void Enqueue(Thread *thread);
+
+    /// Take `thread`, which is ready, out of its queue.
+    void Dequeue(Thread *thread);
+
+    /// Bring every thread back to its priority.
+    void Boost();
+
+    SchedulingPolicy policy;
+
+    /// Queues of threads that are ready to run, but not running, one per
+    /// priority, 0 being the lowest.  Threads are linked through
+    /// `Thread::nextReady`, so that queueing allocates nothing.
+    Thread *readyHead[NUM_QUEUES];
+    Thread *readyTail[NUM_QUEUES];
+
+    /// Bit `i` is set when queue `i` is not empty, so that the highest
+    /// priority with a ready thread is found in one step.
+    uint64_t readyLevels;
+
+    /// When the running thread got the CPU, and since when its time has not
+    /// been charged to `Thread::sliceUsed`.
+    unsigned runningSince;
+    unsigned sliceStart;
+    unsigned userTicksSince;  ///< `stats->userTicks` when it got the CPU.
+
+    /// Under stride scheduling, pass of the last thread to get the CPU.
+    /// Threads waking up start no lower, so that sleeping earns no credit.
+    unsigned long long globalPass;
+
+    /// Number of boosts so far.  Threads not seen since the last one are
+    /// brought up to date when next queued.
+    unsigned boostEpoch;
+    unsigned nextBoost;  ///< When the next boost is due.
 
 };
 
+static_assert(NUM_QUEUES <= 64, "Every priority needs a bit in a word.");
+
 
 #endif
@@ -0,0 +1,98 @@
+/// Routines to keep execution stacks for reuse.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+
+#include "stack_pool.hh"
+#include "system.hh"
+#include "machine/system_dep.hh"
+
+
+StackPool::StackPool()
+{
+    for (unsigned i = 0; i < NUM_STACK_CLASSES; i++) {
+        free[i] = nullptr;
+        numFree[i] = 0;
+    }
+}
+
+StackPool::~StackPool()
+{
+    for (unsigned i = 0; i < NUM_STACK_CLASSES; i++) {
+        unsigned size = MIN_STACK_SIZE << i;
+        while (free[i] != nullptr) {
+            HostMemoryAddress *stack = free[i];
+            free[i] = (HostMemoryAddress *) *stack;
+            DeallocBoundedArray((char *) stack, size * sizeof *stack);
+        }
+    }
+}
+
+unsigned
+StackPool::RoundSize(unsigned size)
+{
+    return MIN_STACK_SIZE << ClassOf(size);
+}
+
+unsigned
+StackPool::ClassOf(unsigned size)
+{
+    unsigned i = 0;
+    while ((MIN_STACK_SIZE << i) < size)
+        i++;
+    ASSERT(i < NUM_STACK_CLASSES);
+    return i;
+}
+
+/// The stack is not cleared: the thread sets up its own frame, and only
+/// relies on the fencepost, which it writes itself.
+///
+/// `Thread::Fork` calls this with interrupts enabled, so they are disabled
+/// while the free list is changed, or two threads could pop the same stack.
+///
+/// * `size` is the size of the stack, in words.
+HostMemoryAddress *
+StackPool::Take(unsigned size)
+{
+    ASSERT(size == RoundSize(size));
+
+    unsigned i = ClassOf(size);
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    HostMemoryAddress *stack = free[i];
+    if (stack != nullptr) {
+        free[i] = (HostMemoryAddress *) *stack;
+        numFree[i]--;
+    }
+    interrupt->SetLevel(oldLevel);
+
+    if (stack == nullptr)
+        stack = (HostMemoryAddress *) AllocBoundedArray(size * sizeof *stack);
+    return stack;
+}
+
+/// Stacks beyond `STACK_POOL_LIMIT` of the same size are freed.  Like
+/// `Take`, it keeps interrupts disabled while it changes the free list.
+///
+/// * `stack` is the stack, which no thread may be running on.
+/// * `size` is its size, in words.
+void
+StackPool::GiveBack(HostMemoryAddress *stack, unsigned size)
+{
+    ASSERT(stack != nullptr);
+    ASSERT(size == RoundSize(size));
+
+    unsigned i = ClassOf(size);
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    bool kept = numFree[i] < STACK_POOL_LIMIT;
+    if (kept) {
+        *stack = (HostMemoryAddress) free[i];
+        free[i] = stack;
+        numFree[i]++;
+    }
+    interrupt->SetLevel(oldLevel);
+
+    if (!kept)
+        DeallocBoundedArray((char *) stack, size * sizeof *stack);
+}
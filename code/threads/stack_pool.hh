@@ -0,0 +1,58 @@
+/// Execution stacks for threads, recycled.
+///
+/// Every stack comes from `AllocBoundedArray`, so it keeps whatever guard
+/// pages the host gives it.  Stacks given back are kept for the next thread
+/// that needs one of the same size, instead of being freed, so that forking
+/// and finishing threads does not go to the host allocator every time.
+///
+/// Copyright (c) 2018 Docentes de la Universidad Nacional de Rosario.
+/// All rights reserved.  See `copyright.h` for copyright notice and
+/// limitation of liability and disclaimer of warranty provisions.
+
+#ifndef NACHOS_THREADS_STACKPOOL__HH
+#define NACHOS_THREADS_STACKPOOL__HH
+
+
+#include "lib/utility.hh"
+
+
+/// Smallest stack size, in words.  Sizes are rounded up to a power of two
+/// times this.
+const unsigned MIN_STACK_SIZE = 1024;
+
+/// Number of different stack sizes.
+const unsigned NUM_STACK_CLASSES = 8;
+
+/// Stacks of each size kept for reuse, at most.
+const unsigned STACK_POOL_LIMIT = 32;
+
+class StackPool {
+public:
+
+    StackPool();
+
+    /// Free every stack kept.
+    ~StackPool();
+
+    /// Size actually used for a stack of at least `size` words.
+    static unsigned RoundSize(unsigned size);
+
+    /// Return a stack of `size` words, as given by `RoundSize`.
+    HostMemoryAddress *Take(unsigned size);
+
+    /// Give back `stack`, of `size` words, for reuse.
+    void GiveBack(HostMemoryAddress *stack, unsigned size);
+
+private:
+
+    static unsigned ClassOf(unsigned size);
+
+    /// Stacks kept, by size.  Each free stack holds the next one in its
+    /// first word.
+    HostMemoryAddress *free[NUM_STACK_CLASSES];
+    unsigned numFree[NUM_STACK_CLASSES];
+
+};
+
+
+#endif
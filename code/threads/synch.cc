@@ -22,7 +22,6 @@
 /// limitation of liability and disclaimer of warranty provisions.
 
 
-#include <algorithm>
 #include "synch.hh"
 #include "system.hh"
 
@@ -35,7 +34,6 @@ Semaphore::Semaphore(const char *debugName, int initialValue)
 {
     name  = debugName;
     value = initialValue;
-    queue = new List<Thread *>;
 }
 
 /// De-allocate semaphore, when no longer needed.
@@ -43,7 +41,7 @@ Semaphore::Semaphore(const char *debugName, int initialValue)
 /// Assume no one is still waiting on the semaphore!
 Semaphore::~Semaphore()
 {
-    delete queue;
+    ASSERT(queue.IsEmpty());
 }
 
 const char *
@@ -66,7 +64,7 @@ Semaphore::P()
       // Disable interrupts.
 
     while (value == 0) {  // Semaphore not available.
-        queue->Append(currentThread);  // So go to sleep.
+        queue.Append(currentThread);  // So go to sleep.
         currentThread->Sleep();
     }
     value--;  // Semaphore available, consume its value.
@@ -84,7 +82,7 @@ Semaphore::V()
 {
     IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
 
-    Thread *thread = queue->Pop();
+    Thread *thread = queue.Pop();
     if (thread != nullptr)
         // Make thread ready, consuming the `V` immediately.
         scheduler->ReadyToRun(thread);
@@ -98,19 +96,16 @@ Semaphore::V()
 /// Note -- without a correct implementation of `Condition::Wait`, the test
 /// case in the network assignment will not work!
 
-Lock::Lock(const char *debugName, unsigned _priority)
+Lock::Lock(const char *debugName)
 {
     name = debugName;
     ownerThread = nullptr;
-    priority = _priority;
-    old_priority = nullptr;
-    lockSemaphore = new Semaphore(debugName, 1);
+    nextHeld = nullptr;
 }
 
 Lock::~Lock()
 {
-    delete lockSemaphore;
-    delete old_priority;
+    ASSERT(ownerThread == nullptr);
 }
 
 const char *
@@ -119,34 +114,103 @@ Lock::GetName() const
     return name;
 }
 
+/// Wait until the lock is free, lending our priority to the holder
+/// meanwhile, and take it.
+///
+/// A woken thread may find the lock taken again by one that got the CPU
+/// first; it then waits ahead of the others of its priority.
 void
 Lock::Acquire()
 {
-    ASSERT(not IsHeldByCurrentThread());
+    ASSERT(!IsHeldByCurrentThread());
 
-    priority = std::max(priority, ::currentThread->GetPriority());
-    if( ownerThread and priority > ownerThread->GetPriority() ){
-        if( not old_priority )
-          old_priority = new unsigned {ownerThread->GetPriority()};
-        ownerThread->SetPriority(priority);
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    bool woken = false;
+    while (ownerThread != nullptr) {
+        currentThread->waitingOn = this;
+        AddWaiter(currentThread, woken);
+        UpdatePriority(ownerThread);
+        currentThread->Sleep();
+        woken = true;
     }
-
-    lockSemaphore->P();
-    ownerThread = ::currentThread;
+    Hold(currentThread);
+    interrupt->SetLevel(oldLevel);
 }
 
+/// Free the lock, wake up the first waiter, if any, and give up whatever
+/// priority was lent through the lock.
+///
+/// The lock is not handed over to the waiter, so that a thread releasing
+/// and taking it again does not have to wait for every other one in turn.
+/// Like `Semaphore::V`, this does not give up the CPU.
 void
 Lock::Release()
 {
     DEBUG('c', "Current thread: %s\n", currentThread->GetName());
     ASSERT(IsHeldByCurrentThread());
-    if( old_priority ){
-        ownerThread->SetPriority( *old_priority );
-        delete old_priority;
-        old_priority = nullptr;
-    }
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Lock **link = &currentThread->locksHeld;
+    while (*link != this)
+        link = &(*link)->nextHeld;
+    *link = nextHeld;
+    nextHeld = nullptr;
     ownerThread = nullptr;
-    lockSemaphore->V();
+
+    Thread *thread = waiters.Pop();
+    if (thread != nullptr) {
+        thread->waitingOn = nullptr;
+        scheduler->ReadyToRun(thread);
+    }
+    UpdatePriority(currentThread);
+    interrupt->SetLevel(oldLevel);
+}
+
+void
+Lock::Hold(Thread *thread)
+{
+    ownerThread = thread;
+    nextHeld = thread->locksHeld;
+    thread->locksHeld = this;
+}
+
+void
+Lock::AddWaiter(Thread *thread, bool first)
+{
+    unsigned priority = thread->effectivePriority;
+    Thread *next = waiters.Head();
+    while (next != nullptr
+             && (next->effectivePriority > priority
+                   || (next->effectivePriority == priority && !first)))
+        next = waiters.Next(next);
+    waiters.InsertBefore(thread, next);
+}
+
+/// Going down a chain of locks stops as soon as a thread's priority does
+/// not change, which also ends it if the chain loops around in a deadlock.
+void
+Lock::UpdatePriority(Thread *thread)
+{
+    ASSERT(interrupt->GetLevel() == INT_OFF);
+
+    while (thread != nullptr) {
+        unsigned priority = thread->priority;
+        for (Lock *l = thread->locksHeld; l != nullptr; l = l->nextHeld) {
+            Thread *first = l->waiters.Head();
+            if (first != nullptr && first->effectivePriority > priority)
+                priority = first->effectivePriority;
+        }
+        if (priority == thread->effectivePriority)
+            return;
+        scheduler->Reprioritize(thread, priority);
+
+        Lock *lock = thread->waitingOn;
+        if (lock == nullptr)
+            return;
+        lock->waiters.Remove(thread);  // Its place in the queue changed.
+        lock->AddWaiter(thread, false);
+        thread = lock->ownerThread;
+    }
 }
 
 bool
@@ -159,17 +223,12 @@ Condition::Condition(const char *debugName, Lock *_conditionLock)
 {
     name = debugName;
     conditionLock = _conditionLock;
-    waiters = 0;
-    conditionSemaphoreS = new Semaphore(debugName, 0);
-    conditionSemaphoreX = new Semaphore(debugName, 1);
-    conditionSemaphoreH = new Semaphore(debugName, 0);
 }
 
+/// Assume no one is still waiting on the variable!
 Condition::~Condition()
 {
-    delete conditionSemaphoreS;
-    delete conditionSemaphoreX;
-    delete conditionSemaphoreH;
+    ASSERT(queue.IsEmpty());
 }
 
 const char *
@@ -178,42 +237,128 @@ Condition::GetName() const
     return name;
 }
 
+/// Release the lock, sleep until signalled, and take the lock again.
+///
+/// Interrupts stay disabled from the moment the thread is queued until it
+/// sleeps, so that a `Signal` cannot find it in the queue while it is still
+/// running.
 void
 Condition::Wait()
 {
-    conditionSemaphoreX->P();
-    waiters++;
-    conditionSemaphoreX->V();
+    ASSERT(conditionLock->IsHeldByCurrentThread());
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    queue.Append(currentThread);
     conditionLock->Release();
+    currentThread->Sleep();
+    interrupt->SetLevel(oldLevel);
 
-    conditionSemaphoreS->P();
-    conditionSemaphoreH->V();
     conditionLock->Acquire();
 }
 
+/// Make the first waiting thread ready, if any.
 void
 Condition::Signal()
 {
-    conditionSemaphoreX->P();
-    if( waiters > 0 ){
-        waiters--;
-        conditionSemaphoreS->V();
-        conditionSemaphoreH->P();
-    }
-    conditionSemaphoreX->V();
+    ASSERT(conditionLock->IsHeldByCurrentThread());
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Thread *thread = queue.Pop();
+    if (thread != nullptr)
+        scheduler->ReadyToRun(thread);
+    interrupt->SetLevel(oldLevel);
 }
 
+/// Make every waiting thread ready, in the order they came.
 void
 Condition::Broadcast()
 {
-    conditionSemaphoreX->P();
-    for(int i = 0; i < waiters; ++i)
-        conditionSemaphoreS->V();
-    while( waiters > 0 ){
-        --waiters;
-        conditionSemaphoreH->P();
-    }
-    conditionSemaphoreX->V();
+    ASSERT(conditionLock->IsHeldByCurrentThread());
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    Thread *thread;
+    while ((thread = queue.Pop()) != nullptr)
+        scheduler->ReadyToRun(thread);
+    interrupt->SetLevel(oldLevel);
+}
+
+
+ReadWriteLock::ReadWriteLock(const char *debugName)
+{
+    name = debugName;
+    lock = new Lock(debugName);
+    canRead = new Condition(debugName, lock);
+    canWrite = new Condition(debugName, lock);
+    readers = 0;
+    waitingWriters = 0;
+    writer = nullptr;
+}
+
+ReadWriteLock::~ReadWriteLock()
+{
+    delete canRead;
+    delete canWrite;
+    delete lock;
+}
+
+const char *
+ReadWriteLock::GetName() const
+{
+    return name;
+}
+
+void
+ReadWriteLock::AcquireRead()
+{
+    lock->Acquire();
+    ASSERT(writer != currentThread);
+    while (writer != nullptr || waitingWriters > 0)
+        canRead->Wait();
+    readers++;
+    lock->Release();
+}
+
+void
+ReadWriteLock::ReleaseRead()
+{
+    lock->Acquire();
+    ASSERT(readers > 0);
+    readers--;
+    if (readers == 0)
+        canWrite->Signal();
+    lock->Release();
+}
+
+void
+ReadWriteLock::AcquireWrite()
+{
+    lock->Acquire();
+    ASSERT(writer != currentThread);
+    waitingWriters++;
+    while (writer != nullptr || readers > 0)
+        canWrite->Wait();
+    waitingWriters--;
+    writer = currentThread;
+    lock->Release();
+}
+
+void
+ReadWriteLock::ReleaseWrite()
+{
+    lock->Acquire();
+    ASSERT(writer == currentThread);
+    writer = nullptr;
+    if (waitingWriters > 0)
+        canWrite->Signal();
+    else
+        canRead->Broadcast();
+    lock->Release();
+}
+
+bool
+ReadWriteLock::IsWriteHeldByCurrentThread() const
+{
+    return writer == currentThread;
 }
 
 
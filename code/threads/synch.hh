@@ -21,7 +21,7 @@
 
 
 #include "thread.hh"
-#include "lib/list.hh"
+#include "lib/intrusive_list.hh"
 
 
 /// This class defines a “semaphore”, which has a positive integer as its
@@ -63,8 +63,9 @@ private:
     /// Semaphore value, it is always `>= 0`.
     int value;
 
-    /// Queue of threads waiting on `P` because the value is zero.
-    List<Thread *> *queue;
+    /// Queue of threads waiting on `P` because the value is zero, linked
+    /// through the threads themselves.
+    IntrusiveList<Thread, &Thread::waitLink> queue;
 
 };
 
@@ -79,11 +80,17 @@ private:
 ///
 /// For convenience, nobody but the thread that holds the lock can free it.
 /// There is no operation for reading the state of the lock.
+///
+/// Threads waiting for the lock are woken by priority, and the one that
+/// holds it runs at the priority of the first of them, if that is higher
+/// than its own.  If it is waiting for another lock in turn, the priority
+/// passes on to the holder of that one, and so on down the chain, so that
+/// threads of intermediate priority cannot hold up any of them.
 class Lock {
 public:
 
     /// Constructor: set up the lock as free.
-    Lock(const char *debugName, unsigned priority=MIN_PRIORITY);
+    Lock(const char *debugName);
 
     ~Lock();
 
@@ -102,15 +109,31 @@ public:
     /// Useful for checks in `Release` and in condition variables.
     bool IsHeldByCurrentThread() const;
 
+    /// Bring the priority `thread` runs at up to date with its own and
+    /// those of the threads waiting for its locks, and pass the change on
+    /// to the holder of the lock it waits for, if any.
+    ///
+    /// Interrupts must be disabled.
+    static void UpdatePriority(Thread *thread);
+
 private:
 
+    /// Make `thread` the holder of the lock.
+    void Hold(Thread *thread);
+
+    /// Queue `thread` after the waiters of higher priority, and after
+    /// those of the same one, or before them if it goes `first`.
+    void AddWaiter(Thread *thread, bool first);
+
     /// For debugging.
     const char *name;
     Thread *ownerThread;
-    Semaphore *lockSemaphore;
-    unsigned priority;
-    unsigned *old_priority;
-    // Add other needed fields here.
+
+    /// Threads waiting for the lock, by effective priority.
+    IntrusiveList<Thread, &Thread::waitLink> waiters;
+
+    /// Next lock held by the same thread.
+    Lock *nextHeld;
 };
 
 // This class defined a “condition variable”.
@@ -145,6 +168,10 @@ private:
 // The “Mesa” style is somewhat simpler to implement, but it does not
 // guarantee that the woken thread recover the control of the lock
 // immediately.
+//
+// Waiting threads are queued on the variable itself, and `Signal` and
+// `Broadcast` move them straight to the ready queue, so neither of them
+// ever blocks the caller.
 class Condition {
 public:
 
@@ -168,12 +195,44 @@ private:
 
     const char *name;
     Lock *conditionLock;
-    Semaphore *conditionSemaphoreS;
-    Semaphore *conditionSemaphoreX;
-    Semaphore *conditionSemaphoreH;
-    int waiters;
 
-    // Other needed fields are to be added here.
+    /// Threads waiting on the variable, linked through the threads
+    /// themselves.
+    IntrusiveList<Thread, &Thread::waitLink> queue;
+};
+
+
+/// This class defines a “reader-writer lock”.
+///
+/// Any number of readers can hold the lock at the same time, but a writer
+/// holds it alone.  Writers take precedence: once a writer is waiting, new
+/// readers wait too, so that a steady flow of readers cannot starve it.
+class ReadWriteLock {
+public:
+
+    ReadWriteLock(const char *debugName);
+
+    ~ReadWriteLock();
+
+    const char *GetName() const;
+
+    void AcquireRead();
+    void ReleaseRead();
+
+    void AcquireWrite();
+    void ReleaseWrite();
+
+    /// Returns `true` if the current thread holds the lock for writing.
+    bool IsWriteHeldByCurrentThread() const;
+
+private:
+    const char *name;
+    Lock *lock;  ///< Protects the fields below.
+    Condition *canRead;
+    Condition *canWrite;
+    unsigned readers;  ///< Number of threads reading.
+    unsigned waitingWriters;  ///< Number of threads waiting to write.
+    Thread *writer;  ///< Thread writing, if any.
 };
 
 
@@ -31,7 +31,7 @@ Table<Thread*> *threadPool;
 
 // 2007, Jose Miguel Santos Espino
 PreemptiveScheduler *preemptiveScheduler = nullptr;
-const long long DEFAULT_TIME_SLICE = 50000;
+const long long DEFAULT_TIME_SLICE = 1000;  ///< Microseconds.
 
 
 
@@ -41,6 +41,9 @@ FileSystem *fileSystem;
 
 #ifdef FILESYS
 SynchDisk *synchDisk;
+SuperBlock *superBlock;
+Journal *journal;
+OpenFileTable *fileTable;
 #endif
 
 #ifdef USER_PROGRAM  // Requires either *FILESYS* or *FILESYS_STUB*.
@@ -72,8 +75,10 @@ extern void Cleanup();
 static void
 TimerInterruptHandler(void *dummy)
 {
-    if (interrupt->GetStatus() != IDLE_MODE)
+    if (interrupt->GetStatus() != IDLE_MODE) {
+        scheduler->TimerTick();
         interrupt->YieldOnReturn();
+    }
 }
 
 /// Initialize Nachos global data structures.
@@ -96,6 +101,7 @@ Initialize(int argc, char **argv)
     int argCount;
     const char *debugArgs = "";
     bool randomYield = false;
+    SchedulingPolicy policy = STRICT_PRIORITY;
 
     // 2007, Jose Miguel Santos Espino
     bool preemptiveScheduling = false;
@@ -107,6 +113,11 @@ Initialize(int argc, char **argv)
 #ifdef FILESYS_NEEDED
     bool format = false;  // Format disk.
 #endif
+#ifdef FILESYS
+    bool mapDisk = false;   // Keep the disk mapped into memory.
+    bool syncDisk = false;  // Sync the mapped disk when done.
+    unsigned numTracks = 0;  // Size of a new disk; 0 for the default.
+#endif
 #ifdef NETWORK
     double rely = 1;  // Network reliability.
     int netname = 0;  // UNIX socket name.
@@ -131,13 +142,16 @@ Initialize(int argc, char **argv)
         // 2007, Jose Miguel Santos Espino
         else if (!strcmp(*argv, "-p")) {
             preemptiveScheduling = true;
-            if (argc == 1) {
+            if (argc == 1 || atoi(*(argv + 1)) <= 0) {
                 timeSlice = DEFAULT_TIME_SLICE;
             } else {
                 timeSlice = atoi(*(argv+1));
                 argCount = 2;
             }
-        }
+        } else if (!strcmp(*argv, "-mlfq"))
+            policy = FEEDBACK_PRIORITY;
+        else if (!strcmp(*argv, "-stride"))
+            policy = STRIDE_SCHEDULING;
 #ifdef USER_PROGRAM
         if (!strcmp(*argv, "-s"))
             debugUserProg = true;
@@ -146,6 +160,18 @@ Initialize(int argc, char **argv)
         if (!strcmp(*argv, "-f"))
             format = true;
 #endif
+#ifdef FILESYS
+        if (!strcmp(*argv, "-dm"))
+            mapDisk = true;
+        else if (!strcmp(*argv, "-dms"))
+            mapDisk = syncDisk = true;
+        else if (!strcmp(*argv, "-dt")) {
+            ASSERT(argc > 1);
+            numTracks = atoi(*(argv + 1));
+            ASSERT(numTracks > 0);
+            argCount = 2;
+        }
+#endif
 #ifdef NETWORK
         if (!strcmp(*argv, "-n")) {
             ASSERT(argc > 1);
@@ -163,7 +189,7 @@ Initialize(int argc, char **argv)
     stats = new Statistics;     // Collect statistics.
     threadPool = new Table<Thread *>();
     interrupt = new Interrupt;  // Start up interrupt handling.
-    scheduler = new Scheduler;  // Initialize the ready queue.
+    scheduler = new Scheduler(policy);  // Initialize the ready queue.
     DEBUG('c', "randomYield: %d\n", randomYield);
     // if (randomYield)            // Start the timer (if needed).
     timer = new Timer(TimerInterruptHandler, 0, randomYield);
@@ -193,7 +219,13 @@ Initialize(int argc, char **argv)
 #endif
 
 #ifdef FILESYS
-    synchDisk = new SynchDisk("DISK");
+    // The size of the disk is only chosen when formatting; otherwise it is
+    // whatever the superblock says.
+    synchDisk = new SynchDisk("DISK", format ? numTracks : 0,
+                              mapDisk, syncDisk);
+    superBlock = new SuperBlock(format);
+    journal = new Journal(format);
+    fileTable = new OpenFileTable;
 #endif
 
 #ifdef FILESYS_NEEDED
@@ -229,6 +261,9 @@ Cleanup()
 #endif
 
 #ifdef FILESYS
+    delete fileTable;
+    delete journal;
+    delete superBlock;
     delete synchDisk;
 #endif
 
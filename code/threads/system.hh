@@ -52,7 +52,13 @@ extern FileSystem *fileSystem;
 
 #ifdef FILESYS
 #include "filesys/synch_disk.hh"
+#include "filesys/super_block.hh"
+#include "filesys/journal.hh"
+#include "filesys/open_file_table.hh"
 extern SynchDisk *synchDisk;
+extern SuperBlock *superBlock;  ///< Layout of the file system on disk.
+extern Journal *journal;  ///< Metadata changes not yet in place.
+extern OpenFileTable *fileTable;  ///< Headers of the files open.
 #endif
 
 #ifdef NETWORK
@@ -21,12 +21,16 @@
 #include "switch.h"
 #include "synch.hh"
 #include "system.hh"
+#include "stack_pool.hh"
 
 
 /// This is put at the top of the execution stack, for detecting stack
 /// overflows.
 const unsigned STACK_FENCEPOST = 0xDEADBEEF;
 
+/// Stacks of finished threads, for the next ones.
+static StackPool stackPool;
+
 
 static inline bool
 IsThreadStatus(ThreadStatus s)
@@ -38,19 +42,44 @@ IsThreadStatus(ThreadStatus s)
 /// `Thread::Fork`.
 ///
 /// * `threadName` is an arbitrary string, useful for debugging.
-Thread::Thread(const char *threadName, bool _canJoin, unsigned _priority)
+/// * `_stackSize` is rounded up to a size kept by the pool of stacks; the
+///   stack is only taken from it when the thread is forked.
+Thread::Thread(const char *threadName, bool _canJoin, unsigned _priority,
+               unsigned _stackSize)
 {
     pid      = threadPool->Add(this);
     name     = threadName;
     stackTop = nullptr;
     stack    = nullptr;
+    stackSize = StackPool::RoundSize(_stackSize);
     status   = JUST_CREATED;
     priority = _priority;
+    effectivePriority = _priority;
+    waitingOn = nullptr;
+    locksHeld = nullptr;
+    nextReady = nullptr;
+    demotion = 0;
+    sliceUsed = 0;
+    boostEpoch = 0;
+    runTicks = 0;
+    waitTicks = 0;
+    readySince = 0;
+    userTicks = 0;
+    tickets = DEFAULT_TICKETS;
+    pass = 0;
 #ifdef USER_PROGRAM
     space    = nullptr;
     for (int i = 0; i < NUM_FILE_DESCRIPTORS; ++i) {
         openFileTable[i] = nullptr;
     }
+#endif
+#ifdef FILESYS
+    // New threads start where their creator is.  Threads created before
+    // the file system exists can only be in the root directory.
+    currentDirectory = currentThread != nullptr
+                       ? currentThread->currentDirectory : DIRECTORY_SECTOR;
+    if (currentDirectory != DIRECTORY_SECTOR)
+        fileSystem->HoldDirectory(currentDirectory);
 #endif
     canJoin = _canJoin;
     if( canJoin )
@@ -69,7 +98,9 @@ Thread::Thread(const char *threadName, bool _canJoin, unsigned _priority)
 /// Nachos.
 Thread::~Thread()
 {
-    DEBUG('t', "Deleting thread \"%s\"\n", name);
+    DEBUG('t', "Deleting thread \"%s\", which ran %u ticks (%u of them in "
+               "user mode) and waited %u ticks ready\n",
+          name, runTicks, userTicks, waitTicks);
 
     threadPool->Remove(pid);
 #ifdef USER_PROGRAM
@@ -80,8 +111,10 @@ Thread::~Thread()
 #endif
 
     ASSERT(this != currentThread);
-    if (stack != nullptr)
-        DeallocBoundedArray((char *) stack, STACK_SIZE * sizeof *stack);
+    if (stack != nullptr) {
+        CheckOverflow();  // Do not hand a broken stack to the next thread.
+        stackPool.GiveBack(stack, stackSize);
+    }
 
     if( canJoin )
         delete portJoin;
@@ -178,6 +211,12 @@ Thread::Finish(int exit_status)
 {
     if( canJoin )
         portJoin->Send(exit_status);
+#ifdef FILESYS
+    // Done here, as the destructor runs in the scheduler, where it must not
+    // wait for the file system.
+    fileSystem->DropDirectory(currentDirectory);
+    currentDirectory = DIRECTORY_SECTOR;
+#endif
 
     interrupt->SetLevel(INT_OFF);
     ASSERT(this == currentThread);
@@ -195,7 +234,8 @@ Thread::Finish(int exit_status)
 /// If so, put the thread on the end of the ready list, so that it will
 /// eventually be re-scheduled.
 ///
-/// NOTE: returns immediately if no other thread on the ready queue.
+/// NOTE: returns immediately if no other thread on the ready queue, or if
+/// stride scheduling puts this one first (cf. `Scheduler::Yield`).
 /// Otherwise returns when the thread eventually works its way to the front
 /// of the ready list and gets re-scheduled.
 ///
@@ -214,11 +254,7 @@ Thread::Yield()
 
     DEBUG('t', "Yielding thread \"%s\"\n", GetName());
 
-    Thread *nextThread = scheduler->FindNextToRun();
-    if (nextThread != nullptr) {
-        scheduler->ReadyToRun(this);
-        scheduler->Run(nextThread);
-    }
+    scheduler->Yield();
 
     interrupt->SetLevel(oldLevel);
 }
@@ -286,11 +322,10 @@ Thread::StackAllocate(VoidFunctionPtr func, void *arg)
 {
     ASSERT(func != nullptr);
 
-    stack = (HostMemoryAddress *) AllocBoundedArray(STACK_SIZE
-                                                    * sizeof *stack);
+    stack = stackPool.Take(stackSize);
 
     // i386 & MIPS & SPARC stack works from high addresses to low addresses.
-    stackTop = stack + STACK_SIZE - 4;  // -4 to be on the safe side!
+    stackTop = stack + stackSize - 4;  // -4 to be on the safe side!
 
     // the 80386 passes the return address on the stack.  In order for
     // `SWITCH` to go to `ThreadRoot` when we switch to this thread, the
@@ -334,15 +369,6 @@ Thread::RestoreUserState()
         machine->WriteRegister(i, userRegisters[i]);
 }
 
-int
-Thread::Join()
-{
-    ASSERT(canJoin);
-    int message;
-    portJoin->Receive(&message);
-    return message;
-}
-
 OpenFileId
 Thread::AddFileDescriptor(OpenFile *of)
 {
@@ -373,23 +399,94 @@ Thread::RemoveFileDescriptor(OpenFileId fid)
   openFileTable[fid] = nullptr;
 }
 
-// Gets PID
+#endif
+
+/// Wait for the thread, created joinable, to finish, and return its exit
+/// status.
+int
+Thread::Join()
+{
+    ASSERT(canJoin);
+    int message;
+    portJoin->Receive(&message);
+    return message;
+}
+
 SpaceId
-Thread::GetPID() const {
+Thread::GetPID() const
+{
     return pid;
 }
 
-#endif
-
 unsigned
 Thread::GetPriority()
 {
     return priority;
 }
 
+/// The priority the thread runs at follows, and so do those of the threads
+/// it makes wait.
 void
 Thread::SetPriority(unsigned _priority)
 {
-  priority = _priority;
+    ASSERT(_priority < NUM_QUEUES);
+
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    priority = _priority;
+    Lock::UpdatePriority(this);
+    interrupt->SetLevel(oldLevel);
+}
+
+unsigned
+Thread::GetEffectivePriority() const
+{
+    return effectivePriority;
 }
 
+unsigned
+Thread::GetRunTicks() const
+{
+    return runTicks;
+}
+
+unsigned
+Thread::GetWaitTicks() const
+{
+    return waitTicks;
+}
+
+unsigned
+Thread::GetUserTicks() const
+{
+    return userTicks;
+}
+
+/// Takes effect the next time the thread runs.
+void
+Thread::SetTickets(unsigned _tickets)
+{
+    ASSERT(_tickets > 0);
+    ASSERT(_tickets <= MAX_TICKETS);
+    tickets = _tickets;
+}
+
+unsigned
+Thread::GetTickets() const
+{
+    return tickets;
+}
+
+
+#ifdef FILESYS
+unsigned
+Thread::GetCurrentDirectory() const
+{
+    return currentDirectory;
+}
+
+void
+Thread::SetCurrentDirectory(unsigned sector)
+{
+    currentDirectory = sector;
+}
+#endif
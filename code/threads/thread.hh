@@ -22,7 +22,8 @@
 /// small.)
 ///
 /// One thing to try if you find yourself with segmentation faults is to
-/// increase the size of thread stack -- `STACK_SIZE`.
+/// increase the size of thread stack -- `STACK_SIZE`, or the size given to
+/// the thread.
 ///
 /// In this interface, forking a thread takes two steps.  We must first
 /// allocate a data structure for it:
@@ -39,6 +40,7 @@
 #define NACHOS_THREADS_THREAD__HH
 
 
+#include "lib/intrusive_list.hh"
 #include "lib/utility.hh"
 #include "globals.hh"
 #include "userprog/syscall.h"
@@ -51,6 +53,7 @@
 
 /// Para que compile
 class Port;
+class Lock;
 
 /// CPU register state to be saved on context switch.
 ///
@@ -58,7 +61,8 @@ class Port;
 /// registers.  We allocate room for the maximum of these two architectures.
 const unsigned MACHINE_STATE_SIZE = 17;
 
-/// Size of the thread's private execution stack.
+/// Size of the thread's private execution stack, unless another one is
+/// given when creating it.
 ///
 /// In words.
 ///
@@ -100,8 +104,11 @@ private:
 
 public:
 
-    /// Initialize a `Thread`.
-    Thread(const char *debugName, bool _canJoin = false, unsigned _priority = NUM_QUEUES - 1);
+    /// Initialize a `Thread`, which will run on a stack of at least
+    /// `_stackSize` words.
+    Thread(const char *debugName, bool _canJoin = false,
+           unsigned _priority = NUM_QUEUES - 1,
+           unsigned _stackSize = STACK_SIZE);
 
     /// Deallocate a Thread.
     ///
@@ -134,10 +141,37 @@ public:
 
     int Join();
 
+    /// Key of the thread in `threadPool`; also the identifier of its
+    /// address space, if it runs a user program.
+    SpaceId GetPID() const;
+
+    /// Priority given to the thread.
     unsigned GetPriority();
 
+    /// The thread may run at a higher priority than the one it is given,
+    /// while it holds a lock that others wait for (cf. `Lock`).
     void SetPriority(unsigned priority);
 
+    /// Priority the thread runs at.
+    unsigned GetEffectivePriority() const;
+
+    /// Ticks spent running, and ready to run but waiting for the CPU.
+    unsigned GetRunTicks() const;
+    unsigned GetWaitTicks() const;
+
+    /// Ticks spent running the thread's user program.
+    unsigned GetUserTicks() const;
+
+    /// Share of the CPU under stride scheduling, relative to the other
+    /// threads of the same priority; at most `MAX_TICKETS`.
+    void SetTickets(unsigned tickets);
+    unsigned GetTickets() const;
+
+    /// Place of the thread in the queue of the semaphore, lock or condition
+    /// variable it is waiting on, if any, so that blocking allocates
+    /// nothing.
+    ListLink waitLink;
+
 private:
     // Some of the private data for this class is listed above.
 
@@ -146,6 +180,8 @@ private:
     /// Null if this is the main thread.  (If null, do not deallocate stack.)
     HostMemoryAddress *stack;
 
+    unsigned stackSize;  ///< In words.
+
     /// Ready, running or blocked.
     ThreadStatus status;
 
@@ -155,10 +191,41 @@ private:
 
     Port *portJoin;
 
+    /// Priority given to the thread, and the one it runs at: the highest
+    /// of that and those of the threads waiting for locks it holds.
     unsigned priority;
+    unsigned effectivePriority;
+
+    /// Lock the thread is waiting for, if any, and the first of the locks
+    /// it holds, chained through `Lock::nextHeld`.
+    Lock *waitingOn;
+    Lock *locksHeld;
 
     SpaceId pid;
 
+    /// Next thread in the same ready queue (cf. `Scheduler`).
+    Thread *nextReady;
+
+    /// Queues the thread has been moved below its priority by the feedback
+    /// policy, ticks it has run in its current queue, and the last boost
+    /// that has been applied to it.
+    unsigned demotion;
+    unsigned sliceUsed;
+    unsigned boostEpoch;
+
+    unsigned runTicks;
+    unsigned waitTicks;
+    unsigned readySince;  ///< When the thread was last made ready.
+    unsigned userTicks;
+
+    /// Under stride scheduling, the thread with the lowest pass runs next,
+    /// and running adds to the pass in inverse proportion to the tickets.
+    unsigned tickets;
+    unsigned long long pass;
+
+    friend class Scheduler;
+    friend class Lock;
+
     /// Allocate a stack for thread.  Used internally by `Fork`.
     void StackAllocate(VoidFunctionPtr func, void *arg);
 
@@ -191,12 +258,22 @@ public:
     // Removes a file descriptor from the table of file descriptor
     void RemoveFileDescriptor(OpenFileId);
 
-    // Gets PID
-    SpaceId GetPID() const;
-
     // User code this thread is running.
     AddressSpace *space;
 #endif
+
+#ifdef FILESYS
+private:
+
+    /// Sector of the header of the directory relative paths start from.
+    unsigned currentDirectory;
+
+public:
+
+    unsigned GetCurrentDirectory() const;
+
+    void SetCurrentDirectory(unsigned sector);
+#endif
 };
 
 /// Magical machine-dependent routines, defined in `switch.s`.
@@ -12,8 +12,11 @@
 
 
 #include "system.hh"
+#include "threads/channel.hh"
 #include "threads/synch.hh"
 
+#include <time.h>
+
 #ifdef SEMAPHORE_TEST
 Semaphore s{"<semaphore-0>", 3};
 #endif
@@ -90,3 +93,495 @@ PortTest()
     //~ printf("x = %d\n", x);
 }
 
+
+
+/// Context switch benchmark
+///
+/// Two threads at the same priority hand the CPU to each other with
+/// `Yield`, so that every round goes through the ready queue and `SWITCH`
+/// twice.
+
+static const unsigned SWITCH_ROUNDS = 1000000;
+
+static void
+SwitchPartner(void *)
+{
+    for (unsigned i = 0; i < SWITCH_ROUNDS; i++)
+        currentThread->Yield();
+}
+
+void
+SwitchBenchmark()
+{
+    printf("Switching between two threads %u times:\n", 2 * SWITCH_ROUNDS);
+
+    Thread *partner = new Thread("<switch-partner>", false,
+                                 currentThread->GetPriority());
+    partner->Fork(SwitchPartner, nullptr);
+
+    unsigned long ticksBefore = stats->totalTicks;
+    clock_t start = clock();
+    for (unsigned i = 0; i < SWITCH_ROUNDS; i++)
+        currentThread->Yield();
+    clock_t end = clock();
+
+    printf("Host time per switch: %.1f ns, ticks per switch: %.2f\n",
+           (double) (end - start) * 1e9 / CLOCKS_PER_SEC
+             / (2 * SWITCH_ROUNDS),
+           (double) (stats->totalTicks - ticksBefore) / (2 * SWITCH_ROUNDS));
+}
+
+
+/// Thread creation benchmark
+///
+/// Fork a thread that does nothing, wait for it, and let it be deleted,
+/// over and over.
+
+static const unsigned CREATE_ROUNDS = 200000;
+
+static Semaphore *createDone;
+
+static void
+CreatedThread(void *)
+{
+    createDone->V();
+}
+
+void
+CreateBenchmark()
+{
+    printf("Creating and deleting %u threads:\n", CREATE_ROUNDS);
+
+    createDone = new Semaphore("create-done", 0);
+    clock_t start = clock();
+    for (unsigned i = 0; i < CREATE_ROUNDS; i++) {
+        Thread *t = new Thread("<created>", false,
+                               currentThread->GetPriority());
+        t->Fork(CreatedThread, nullptr);
+        createDone->P();
+        currentThread->Yield();  // Let it finish, and be deleted.
+    }
+    clock_t end = clock();
+    delete createDone;
+
+    printf("Host time per thread: %.1f ns\n",
+           (double) (end - start) * 1e9 / CLOCKS_PER_SEC / CREATE_ROUNDS);
+}
+
+
+/// Block and wake benchmark
+///
+/// Two threads take turns through a pair of semaphores, so that each cycle
+/// blocks and wakes each of them once.
+
+static const unsigned BLOCK_ROUNDS = 200000;
+
+static Semaphore *ping;
+static Semaphore *pong;
+
+static void
+Ponger(void *)
+{
+    for (unsigned i = 0; i < BLOCK_ROUNDS; i++) {
+        ping->P();
+        pong->V();
+    }
+}
+
+void
+BlockWakeBenchmark()
+{
+    printf("Blocking and waking two threads %u times:\n", BLOCK_ROUNDS);
+
+    ping = new Semaphore("ping", 0);
+    pong = new Semaphore("pong", 0);
+    Thread *t = new Thread("ponger", false, currentThread->GetPriority());
+    t->Fork(Ponger, nullptr);
+    clock_t start = clock();
+    for (unsigned i = 0; i < BLOCK_ROUNDS; i++) {
+        ping->V();
+        pong->P();
+    }
+    clock_t end = clock();
+    currentThread->Yield();  // Let it finish, and be deleted.
+    delete ping;
+    delete pong;
+
+    printf("Host time per cycle: %.1f ns\n",
+           (double) (end - start) * 1e9 / CLOCKS_PER_SEC / BLOCK_ROUNDS);
+}
+
+
+/// Port benchmark
+///
+/// A thread sends messages through a `Port` to another one, which checks
+/// that they arrive in order.
+
+static const unsigned PORT_MESSAGES = 100000;
+
+static Port *benchPort;
+
+static void
+PortSender(void *)
+{
+    for (unsigned i = 0; i < PORT_MESSAGES; i++)
+        benchPort->Send(i);
+}
+
+void
+PortBenchmark()
+{
+    printf("Sending %u messages through a port:\n", PORT_MESSAGES);
+
+    benchPort = new Port("bench-port");
+    Thread *t = new Thread("sender", false, currentThread->GetPriority());
+    t->Fork(PortSender, nullptr);
+    clock_t start = clock();
+    unsigned long ticksBefore = stats->totalTicks;
+    for (unsigned i = 0; i < PORT_MESSAGES; i++) {
+        int message;
+        benchPort->Receive(&message);
+        ASSERT(message == (int) i);
+    }
+    clock_t end = clock();
+    unsigned long ticks = stats->totalTicks - ticksBefore;
+    currentThread->Yield();  // Let the sender finish, and be deleted.
+    delete benchPort;
+
+    printf("Host time per message: %.1f ns, ticks per message: %.2f\n",
+           (double) (end - start) * 1e9 / CLOCKS_PER_SEC / PORT_MESSAGES,
+           (double) ticks / PORT_MESSAGES);
+}
+
+
+/// Channel benchmark
+///
+/// The same messages as in the port benchmark go through a `Channel`
+/// instead, and the receiver takes all that are waiting at once.
+
+static const unsigned CHANNEL_CAPACITY = 64;
+
+static Channel<int> *benchChannel;
+
+static void
+ChannelSender(void *)
+{
+    for (unsigned i = 0; i < PORT_MESSAGES; i++)
+        benchChannel->Send(i);
+}
+
+void
+ChannelBenchmark()
+{
+    benchChannel = new Channel<int>("bench-channel", CHANNEL_CAPACITY);
+
+    // Without waiting, a channel takes as many messages as it has room for,
+    // and gives them back in order.
+    for (unsigned i = 0; i < CHANNEL_CAPACITY; i++)
+        ASSERT(benchChannel->TrySend(i));
+    ASSERT(!benchChannel->TrySend(CHANNEL_CAPACITY));
+    for (unsigned i = 0; i < CHANNEL_CAPACITY; i++) {
+        int message;
+        ASSERT(benchChannel->TryReceive(&message));
+        ASSERT(message == (int) i);
+    }
+    int message;
+    ASSERT(!benchChannel->TryReceive(&message));
+
+    printf("Sending %u messages through a channel of %u:\n",
+           PORT_MESSAGES, CHANNEL_CAPACITY);
+
+    Thread *t = new Thread("sender", false, currentThread->GetPriority());
+    t->Fork(ChannelSender, nullptr);
+    clock_t start = clock();
+    unsigned long ticksBefore = stats->totalTicks;
+    unsigned received = 0, batches = 0;
+    while (received < PORT_MESSAGES) {
+        int messages[CHANNEL_CAPACITY];
+        unsigned n = benchChannel->ReceiveBatch(messages, CHANNEL_CAPACITY);
+        for (unsigned i = 0; i < n; i++)
+            ASSERT(messages[i] == (int) received++);
+        batches++;
+    }
+    clock_t end = clock();
+    unsigned long ticks = stats->totalTicks - ticksBefore;
+    currentThread->Yield();  // Let the sender finish, and be deleted.
+    delete benchChannel;
+
+    printf("Host time per message: %.1f ns, ticks per message: %.2f, "
+           "messages per batch: %.1f\n",
+           (double) (end - start) * 1e9 / CLOCKS_PER_SEC / PORT_MESSAGES,
+           (double) ticks / PORT_MESSAGES, (double) received / batches);
+}
+
+
+/// Thread table stress test
+///
+/// Have thousands of threads alive at the same time, each one in
+/// `threadPool`, and then join them all.
+
+static const unsigned STRESS_THREADS = 5000;
+
+static Semaphore *stressGo;
+
+static void
+StressedThread(void *index_)
+{
+    stressGo->P();
+    currentThread->Finish((int) (HostMemoryAddress) index_);
+}
+
+void
+ThreadStressTest()
+{
+    printf("Spawning and joining %u threads:\n", STRESS_THREADS);
+
+    stressGo = new Semaphore("stress-go", 0);
+    Thread **threads = new Thread * [STRESS_THREADS];
+    clock_t start = clock();
+    for (unsigned i = 0; i < STRESS_THREADS; i++) {
+        threads[i] = new Thread("<stressed>", true,
+                                currentThread->GetPriority());
+        threads[i]->Fork(StressedThread, (void *) (HostMemoryAddress) i);
+    }
+    for (unsigned i = 0; i < STRESS_THREADS; i++)
+        ASSERT(threadPool->Get(threads[i]->GetPID()) == threads[i]);
+    for (unsigned i = 0; i < STRESS_THREADS; i++)
+        stressGo->V();
+    for (unsigned i = 0; i < STRESS_THREADS; i++)
+        ASSERT(threads[i]->Join() == (int) i);
+    clock_t end = clock();
+    currentThread->Yield();  // Let the last one be deleted.
+    delete [] threads;
+    delete stressGo;
+
+    printf("All joined, in %.1f ms.\n",
+           (double) (end - start) * 1e3 / CLOCKS_PER_SEC);
+}
+
+
+/// Share test
+///
+/// Threads with 1, 2 and 3 tickets keep the CPU busy for the same stretch
+/// of simulated time.  Under `-stride` they should run about 1/6, 2/6 and
+/// 3/6 of it; otherwise, about a third each.
+
+static const unsigned SHARE_TICKS = 200 * TIMER_TICKS;
+static const unsigned SHARE_THREADS = 3;
+
+static unsigned shareDeadline;
+static unsigned shareTicks[SHARE_THREADS];
+static Semaphore *shareDone;
+
+static void
+ShareSpinner(void *slot_)
+{
+    unsigned *slot = (unsigned *) slot_;
+    while (stats->totalTicks < shareDeadline) {
+        interrupt->SetLevel(INT_OFF);  // Let simulated time go by.
+        interrupt->SetLevel(INT_ON);
+    }
+    *slot = currentThread->GetRunTicks();  // Up to its last turn.
+    shareDone->V();
+}
+
+void
+ShareTest()
+{
+    shareDeadline = stats->totalTicks + SHARE_TICKS;
+    shareDone = new Semaphore("share-done", 0);
+    for (unsigned i = 0; i < SHARE_THREADS; i++) {
+        Thread *t = new Thread("<share-spinner>", false,
+                               currentThread->GetPriority());
+        t->SetTickets(i + 1);
+        t->Fork(ShareSpinner, &shareTicks[i]);
+    }
+    for (unsigned i = 0; i < SHARE_THREADS; i++)
+        shareDone->P();
+    delete shareDone;
+    for (unsigned i = 0; i < SHARE_THREADS; i++)
+        printf("Thread with %u tickets ran %u ticks.\n", i + 1, shareTicks[i]);
+}
+
+
+/// Priority inheritance test
+///
+/// First, threads waiting for a lock must get it by priority, even when the
+/// priority of one of them changes while it waits.
+///
+/// Then, a thread of high priority waits for the last of a chain of locks,
+/// each held by a thread of low priority that waits for the one before,
+/// while threads of intermediate priority want the CPU for a long time.
+/// The chain must run at the high priority, so that the high one only
+/// waits for the critical sections, however long the chain.  There are two
+/// hogs: a running thread gives way to any other at every timer interrupt
+/// (cf. `Scheduler::Yield`), so with only one the chain would get every
+/// other turn anyway.
+
+static const unsigned MAX_CHAIN = 4;
+static const unsigned CRITICAL_ROUNDS = 50;
+static const unsigned HOG_ROUNDS = 2000;
+static const unsigned WAITERS = 3;
+static const unsigned HOGS = 2;
+
+static const unsigned HOG_PRIORITY = 30;
+static const unsigned HIGH_PRIORITY = 50;
+
+static Lock *orderLock;
+static unsigned queued[WAITERS];
+static unsigned numQueued;
+static unsigned order[WAITERS];
+static unsigned numOrdered;
+
+static Lock *chainLocks[MAX_CHAIN];
+static unsigned chainLength;
+static unsigned highWait;
+static Semaphore *chainReady;
+static Semaphore *chainDone;
+
+/// Keep the CPU busy for `rounds` system ticks of its own.
+static void
+Spin(unsigned rounds)
+{
+    for (unsigned i = 0; i < rounds; i++) {
+        interrupt->SetLevel(INT_OFF);  // Let simulated time go by.
+        interrupt->SetLevel(INT_ON);
+    }
+}
+
+/// Waiters of the same priority get the lock in the order they queued,
+/// which a timer interrupt may make different from the order they were
+/// forked in.
+static void
+OrderedWaiter(void *index_)
+{
+    unsigned i = (unsigned) (HostMemoryAddress) index_;
+    IntStatus oldLevel = interrupt->SetLevel(INT_OFF);
+    queued[numQueued++] = i;  // Nobody can queue in between.
+    orderLock->Acquire();
+    interrupt->SetLevel(oldLevel);
+    order[numOrdered++] = i;
+    orderLock->Release();
+    chainDone->V();
+}
+
+static void
+ChainHolder(void *index_)
+{
+    unsigned i = (unsigned) (HostMemoryAddress) index_;
+    chainLocks[i]->Acquire();
+    chainReady->V();
+    if (i > 0)
+        chainLocks[i - 1]->Acquire();
+    Spin(CRITICAL_ROUNDS);
+    if (i > 0)
+        chainLocks[i - 1]->Release();
+    chainLocks[i]->Release();
+    chainDone->V();
+}
+
+static void
+Hog(void *)
+{
+    Spin(HOG_ROUNDS);
+    chainDone->V();
+}
+
+static void
+HighWaiter(void *)
+{
+    unsigned start = stats->totalTicks;
+    chainLocks[chainLength - 1]->Acquire();
+    highWait = stats->totalTicks - start;
+    chainLocks[chainLength - 1]->Release();
+    chainDone->V();
+}
+
+static void
+WaiterOrderTest()
+{
+    orderLock = new Lock("order");
+    numQueued = 0;
+    numOrdered = 0;
+
+    orderLock->Acquire();
+    Thread *waiters[WAITERS];
+    for (unsigned i = 0; i < WAITERS; i++) {
+        waiters[i] = new Thread("<ordered-waiter>", false, 5);
+        waiters[i]->Fork(OrderedWaiter, (void *) (HostMemoryAddress) i);
+    }
+    unsigned priority = currentThread->GetPriority();
+    currentThread->SetPriority(MIN_PRIORITY);
+    currentThread->Yield();  // Let all of them wait for the lock.
+    ASSERT(currentThread->GetEffectivePriority() == 5);
+
+    waiters[WAITERS - 1]->SetPriority(10);  // Now it should go first.
+    ASSERT(currentThread->GetEffectivePriority() == 10);
+    currentThread->SetPriority(priority);
+    orderLock->Release();
+    ASSERT(currentThread->GetEffectivePriority() == priority);
+
+    for (unsigned i = 0; i < WAITERS; i++)
+        chainDone->P();
+    delete orderLock;
+
+    ASSERT(numQueued == WAITERS);
+    ASSERT(order[0] == WAITERS - 1);
+    unsigned next = 1;
+    for (unsigned i = 0; i < WAITERS; i++)
+        if (queued[i] != WAITERS - 1)
+            ASSERT(order[next++] == queued[i]);
+    printf("Waiters got the lock by priority.\n");
+}
+
+/// Returns how long the high priority thread waited.
+static unsigned
+ChainTest(unsigned length)
+{
+    ASSERT(length > 0 && length <= MAX_CHAIN);
+
+    chainLength = length;
+    for (unsigned i = 0; i < length; i++) {
+        chainLocks[i] = new Lock("chain");
+        Thread *t = new Thread("<chain-holder>", false, MIN_PRIORITY + i + 1);
+        t->Fork(ChainHolder, (void *) (HostMemoryAddress) i);
+        chainReady->P();  // It holds its lock, and waits for the previous.
+    }
+    for (unsigned i = 0; i < HOGS; i++) {
+        Thread *hog = new Thread("<hog>", false, HOG_PRIORITY);
+        hog->Fork(Hog, nullptr);
+    }
+    Thread *high = new Thread("<high-waiter>", false, HIGH_PRIORITY);
+    high->Fork(HighWaiter, nullptr);
+
+    for (unsigned i = 0; i < length + HOGS + 1; i++)
+        chainDone->P();
+    for (unsigned i = 0; i < length; i++)
+        delete chainLocks[i];
+
+    unsigned critical = length * CRITICAL_ROUNDS * SYSTEM_TICK;
+    printf("Chain of %u locks: waited %u ticks, for %u ticks of critical "
+           "sections.\n", length, highWait, critical);
+    ASSERT(highWait < HOG_ROUNDS * SYSTEM_TICK);  // The hogs did not get in.
+    return highWait;
+}
+
+void
+PriorityInheritanceTest()
+{
+    chainReady = new Semaphore("chain-ready", 0);
+    chainDone = new Semaphore("chain-done", 0);
+
+    WaiterOrderTest();
+    unsigned worst = 0;
+    for (unsigned length = 1; length <= MAX_CHAIN; length++) {
+        unsigned wait = ChainTest(length);
+        if (wait > worst)
+            worst = wait;
+    }
+    printf("Worst wait of the high priority thread: %u ticks, against %u "
+           "for each hog.\n", worst, HOG_ROUNDS * SYSTEM_TICK);
+
+    delete chainReady;
+    delete chainDone;
+}
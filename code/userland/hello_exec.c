@@ -3,6 +3,6 @@
 int
 main(void)
 {
-    Exec("userland/create", 0); // second 0 argument is temporal, check it out
+    Exec("userland/create", 0, 0); // second 0 argument is temporal, check it out
     return 0;
 }
@@ -0,0 +1,20 @@
+#include "syscall.h"
+
+
+#define BUFFER_SIZE  1024
+
+int
+main(int argc, char **argv)
+{
+    static const char ERROR[] = "Not a directory.\n";
+    char buffer[BUFFER_SIZE];
+
+    int n = ListDir(argc > 1 ? argv[1] : ".", buffer, BUFFER_SIZE);
+    if (n == -1) {
+        Write(ERROR, sizeof ERROR - 1, CONSOLE_OUTPUT);
+        Exit(-1);
+    }
+    if (n > 0)
+        Write(buffer, n, CONSOLE_OUTPUT);
+    Exit(0);
+}
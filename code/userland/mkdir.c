@@ -0,0 +1,16 @@
+#include "syscall.h"
+
+
+int
+main(int argc, char **argv)
+{
+    static const char ERROR[] = "Cannot create directory.\n";
+
+    int status = 0;
+    for (int i = 1; i < argc; i++)
+        if (Mkdir(argv[i]) == -1) {
+            Write(ERROR, sizeof ERROR - 1, CONSOLE_OUTPUT);
+            status = -1;
+        }
+    Exit(status);
+}
@@ -114,14 +114,22 @@ main(void)
             continue;
         }
 
+        // The current directory belongs to the shell itself, so changing it
+        // cannot be left to another program.
+        if (argv[0][0] == 'c' && argv[0][1] == 'd' && argv[0][2] == '\0') {
+            if (argv[1] == NULL || Chdir(argv[1]) == -1)
+                WriteError("cannot change directory.", OUTPUT);
+            continue;
+        }
+
         // Comment and uncomment according to whether command line arguments
         // are given in the system call or not.
         //const SpaceId newProc = Exec(line);
 
         if (line[0] == '&') {
-            const SpaceId newProc = Exec(line + 2, argv + 1); // Ignores &\0
+            const SpaceId newProc = Exec(line + 2, argv + 1, 0); // Ignores &\0
         } else {
-            const SpaceId newProc = Exec(line, argv);
+            const SpaceId newProc = Exec(line, argv, 0);
             if (newProc != -1) {
                 Join(newProc);
             }
@@ -91,6 +91,8 @@ Create:
         j       $31
         .end    Create
 
+        .globl  Remove
+        .ent    Remove
 Remove:
         addiu   $2, $0, SC_REMOVE
         syscall
@@ -129,6 +131,38 @@ Close:
         j       $31
         .end    Close
 
+        .globl  Mkdir
+        .ent    Mkdir
+Mkdir:
+        addiu   $2, $0, SC_MKDIR
+        syscall
+        j       $31
+        .end    Mkdir
+
+        .globl  Chdir
+        .ent    Chdir
+Chdir:
+        addiu   $2, $0, SC_CHDIR
+        syscall
+        j       $31
+        .end    Chdir
+
+        .globl  ListDir
+        .ent    ListDir
+ListDir:
+        addiu   $2, $0, SC_LISTDIR
+        syscall
+        j       $31
+        .end    ListDir
+
+        .globl  Sync
+        .ent    Sync
+Sync:
+        addiu   $2, $0, SC_SYNC
+        syscall
+        j       $31
+        .end    Sync
+
 /// Dummy function to keep gcc happy.
         .globl  __main
         .ent    __main
@@ -24,7 +24,7 @@ main(void)
         buffer[--i] = '\0';
 
         if (i > 0) {
-            newProc = Exec(buffer, 0); // OS does not support this just yet
+            newProc = Exec(buffer, 0, 0); // OS does not support this just yet
             Join(newProc);
         }
     }
@@ -62,7 +62,7 @@ DefaultHandler(ExceptionType et)
 ///
 /// * `filenameAddr` virtual address where the filename string is located.
 /// * `filename` string where the filename should be loaded, it must have a
-/// size of at least FILE_NAME_MAX_LEN + 1.
+/// size of at least PATH_NAME_MAX_LEN + 1.
 ///
 /// It returns 0 if the string was read successfully.
 static int
@@ -73,9 +73,9 @@ readFilenameFromUser(int filenameAddr, char filename[])
         return 1;
     }
 
-    if (!ReadStringFromUser(filenameAddr, filename, FILE_NAME_MAX_LEN)) {
+    if (!ReadStringFromUser(filenameAddr, filename, PATH_NAME_MAX_LEN)) {
         DEBUG('c', "Error: filename string too long (maximum is %u bytes).\n",
-                FILE_NAME_MAX_LEN);
+                PATH_NAME_MAX_LEN);
         return 1;
     }
 
@@ -113,7 +113,7 @@ SyscallHandler(ExceptionType _et)
         case SC_CREATE: {
             DEBUG('c', "Syscall Create\n");
             int filenameAddr = machine->ReadRegister(4);
-            char filename[FILE_NAME_MAX_LEN + 1]{};
+            char filename[PATH_NAME_MAX_LEN + 1]{};
             if (!readFilenameFromUser(filenameAddr, filename)) {
                 DEBUG('c', "Creation requested for file `%s`.\n", filename);
                 fileSystem->Create(filename, 0);
@@ -142,17 +142,16 @@ SyscallHandler(ExceptionType _et)
                 break;
             }
 
-            char systemBuffer[size + 1]{};
-
             if (fid == CONSOLE_INPUT){
                 // Juani: is this ok?
                 // Rom: Yes, I've fixed it
                 int it;
-                for(it = 0; it < size; it++)
-                    systemBuffer[it] = globalConsole->GetChar(); // read BYTES, not chars
+                for(it = 0; it < size; it++) {
+                    char c = globalConsole->GetChar(); // read BYTES, not chars
+                    WriteBufferToUser(&c, 1, storeAddr + it);
+                }
 
                 int bytesRead = it;
-                WriteBufferToUser(systemBuffer, size, storeAddr);
                 machine->WriteRegister(2, bytesRead);
                 break;
             }
@@ -171,10 +170,9 @@ SyscallHandler(ExceptionType _et)
 
             DEBUG('c', "Reading file\n");
 
-            int bytesRead = of->Read(systemBuffer, size);
-            // IF COULDNT READ ANYTHING THEN???
-            if( bytesRead > 0 )
-                WriteBufferToUser(systemBuffer, bytesRead, storeAddr);
+            // Straight from the file to the frames of the buffer, without
+            // going through the kernel stack.
+            int bytesRead = ReadFileToUser(of, storeAddr, size);
             machine->WriteRegister(2, bytesRead);
             break;
         }
@@ -230,7 +228,7 @@ SyscallHandler(ExceptionType _et)
 
         case SC_OPEN: {
             int filenameAddr = machine->ReadRegister(4);
-            char filename[FILE_NAME_MAX_LEN + 1];
+            char filename[PATH_NAME_MAX_LEN + 1];
             if (!readFilenameFromUser(filenameAddr, filename)) {
                 DEBUG('c', "Open requested for file `%s`.\n", filename);
                 OpenFile *of = fileSystem->Open(filename);
@@ -262,6 +260,93 @@ SyscallHandler(ExceptionType _et)
             break;
         }
 
+        case SC_SYNC: {
+            int fid = machine->ReadRegister(4);
+            machine->WriteRegister(2, -1);
+            if (0 > fid || fid >= NUM_FILE_DESCRIPTORS) {
+                DEBUG('c', "Invalid file descriptor to sync.\n");
+                break;
+            }
+            OpenFile *of = currentThread->GetOpenFile(fid);
+            if (of == nullptr) {
+                DEBUG('c', "The file descriptor to sync is not open.\n");
+                break;
+            }
+            DEBUG('c', "Syncing file descriptor id %u.\n", fid);
+            of->Flush();
+#ifdef FILESYS
+            fileSystem->Sync();
+#endif
+            machine->WriteRegister(2, 0);
+            break;
+        }
+
+        case SC_REMOVE: {
+            int filenameAddr = machine->ReadRegister(4);
+            char filename[PATH_NAME_MAX_LEN + 1]{};
+            machine->WriteRegister(2, -1);
+            if (!readFilenameFromUser(filenameAddr, filename)) {
+                DEBUG('c', "Removal requested for file `%s`.\n", filename);
+                if (fileSystem->Remove(filename))
+                    machine->WriteRegister(2, 0);
+            }
+            break;
+        }
+
+        case SC_MKDIR: {
+            int filenameAddr = machine->ReadRegister(4);
+            char filename[PATH_NAME_MAX_LEN + 1]{};
+            machine->WriteRegister(2, -1);
+            if (!readFilenameFromUser(filenameAddr, filename)) {
+                DEBUG('c', "Creation requested for directory `%s`.\n", filename);
+                if (fileSystem->MakeDirectory(filename))
+                    machine->WriteRegister(2, 0);
+            }
+            break;
+        }
+
+        case SC_CHDIR: {
+            int filenameAddr = machine->ReadRegister(4);
+            char filename[PATH_NAME_MAX_LEN + 1]{};
+            machine->WriteRegister(2, -1);
+            if (!readFilenameFromUser(filenameAddr, filename)) {
+                DEBUG('c', "Change requested to directory `%s`.\n", filename);
+                if (fileSystem->ChangeDirectory(filename))
+                    machine->WriteRegister(2, 0);
+            }
+            break;
+        }
+
+        case SC_LISTDIR: {
+            int filenameAddr = machine->ReadRegister(4);
+            int storeAddr = machine->ReadRegister(5);
+            int size = machine->ReadRegister(6);
+            char filename[PATH_NAME_MAX_LEN + 1]{};
+            machine->WriteRegister(2, -1);
+
+            if (storeAddr == 0) {
+                DEBUG('c', "Error: storeAddr is null.\n");
+                break;
+            }
+
+            if (size < 0 || size > MAX_READ_SIZE) {
+                DEBUG('c', "Error: size should be reasonable.\n");
+                break;
+            }
+
+            if (readFilenameFromUser(filenameAddr, filename))
+                break;
+
+            DEBUG('c', "Listing requested for directory `%s`.\n", filename);
+            char *systemBuffer = new char [size + 1];
+            int used = fileSystem->ListDirectory(filename, systemBuffer, size);
+            if (used > 0)
+                WriteBufferToUser(systemBuffer, used, storeAddr);
+            delete [] systemBuffer;
+            machine->WriteRegister(2, used);
+            break;
+        }
+
         case SC_EXIT: {
             int exit_status = machine->ReadRegister(4);
             currentThread->Finish(exit_status);
@@ -285,8 +370,14 @@ SyscallHandler(ExceptionType _et)
         case SC_EXEC: {
 
             int filenameAddr = machine->ReadRegister(4);
+            int tickets = machine->ReadRegister(6);
+            if (tickets > (int) MAX_TICKETS) {
+                DEBUG('c', "Too many tickets: %d.\n", tickets);
+                machine->WriteRegister(2, -1);
+                break;
+            }
             char **argv = SaveArgs(machine->ReadRegister(5));
-            char filename[FILE_NAME_MAX_LEN + 1]{};
+            char filename[PATH_NAME_MAX_LEN + 1]{};
             if (readFilenameFromUser(filenameAddr, filename)) {
                 DEBUG('c', "Failed reading the file name.\n");
                 machine->WriteRegister(2, -1);
@@ -304,6 +395,8 @@ SyscallHandler(ExceptionType _et)
             DEBUG('c', "Running EXEC of file %s!\n", filename);
 
             Thread *newThread = new Thread("<executed-thread>", true, currentThread->GetPriority());
+            newThread->SetTickets(tickets > 0 ? tickets
+                                              : currentThread->GetTickets());
             AddressSpace *space = new AddressSpace(executable, newThread->GetPID());
             newThread->space = space;
 
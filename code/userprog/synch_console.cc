@@ -7,6 +7,7 @@
 
 
 #include "synch_console.hh"
+#include "threads/system.hh"
 
 SynchConsole::SynchConsole()
 {
@@ -30,6 +31,7 @@ SynchConsole::PutChar(char c)
 {
     writeLock->Acquire();
     console->PutChar(c);
+    scheduler->BlockedOnIO();
     writeDone->P();   // wait for interrupt
     writeLock->Release();
 }
@@ -38,6 +40,7 @@ char
 SynchConsole::GetChar()
 {
     readLock->Acquire();
+    scheduler->BlockedOnIO();
     readAvail->P();   // Wait for interrupt.
     auto c = console->GetChar();
     readLock->Release();
@@ -31,6 +31,10 @@
 #define SC_CLOSE   13
 #define SC_READ    14
 #define SC_WRITE   15
+#define SC_MKDIR   16
+#define SC_CHDIR   17
+#define SC_LISTDIR 18
+#define SC_SYNC    19
 
 
 #ifndef IN_ASM
@@ -58,7 +62,11 @@ typedef int SpaceId;
 
 /// Run the executable, stored in the Nachos file `name`, and return the
 /// address space identifier.
-SpaceId Exec(char *name, char **argvs);
+///
+/// `tickets` is the share of the CPU the program gets under stride
+/// scheduling, relative to the others; 0 means the same as the caller.
+/// Return -1 if given more than 65536 tickets (`MAX_TICKETS`).
+SpaceId Exec(char *name, char **argvs, int tickets);
 
 /// Only return once the the user program `id` has finished.
 ///
@@ -122,6 +130,30 @@ int Read(char *buffer, int size, OpenFileId id);
 /// Close the file, we are done reading and writing to it.
 void Close(OpenFileId id);
 
+/// Write out whatever is still buffered for the open file, and make every
+/// change to the file system so far durable.  Return 0 on success, -1 if
+/// `id` is not an open file.
+int Sync(OpenFileId id);
+
+/// Directory operations: `Mkdir`, `Chdir`, `ListDir`.
+///
+/// Every name given to the file system operations may be a path, with
+/// directory names separated by `/`.  Paths starting with `/` begin at the
+/// root directory; any other begins at the current directory, which each
+/// thread inherits from the one that created it.  An empty directory can be
+/// deleted with `Remove`.
+
+/// Create a directory named `name`.  Return 0 on success, -1 on failure.
+int Mkdir(const char *name);
+
+/// Make `name` the current directory.  Return 0 on success, -1 on failure.
+int Chdir(const char *name);
+
+/// Copy the names in directory `name` into `buffer`, one per line, with a
+/// trailing `/` for directories.  Return the number of bytes written, or -1
+/// if `name` is not a directory.
+int ListDir(const char *name, char *buffer, int size);
+
 
 #endif
 
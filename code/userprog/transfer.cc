@@ -1,4 +1,5 @@
 #include "transfer.hh"
+#include "filesys/open_file.hh"
 #include "lib/utility.hh"
 #include "threads/system.hh"
 
@@ -61,3 +62,50 @@ void WriteBufferToUser(const char *buffer, unsigned byteCount,
         userAddress++;
     }
 }
+
+/// Bring the page holding `userAddress` into memory, writable and marked as
+/// modified, and return its frame, pinned so that it is not evicted while
+/// the kernel writes to it.
+static unsigned PinUserPage(int userAddress)
+{
+    int temp;
+    while (!machine->ReadMem(userAddress, 1, &temp)) { DEBUG('y', "PinUserPageAttempt at %d\n", userAddress); };
+    while (!machine->WriteMem(userAddress, 1, temp)) { DEBUG('y', "PinUserPageAttempt at %d\n", userAddress); };
+
+    TranslationEntry *entry
+      = &currentThread->space->GetPageTable()[userAddress / PAGE_SIZE];
+    entry->dirty = true;  // The TLB copy is not written back on eviction.
+    coreMap.Pin(entry->physicalPage);
+    return entry->physicalPage;
+}
+
+/// The file is read a page at a time, right into the frame holding the
+/// page.  Whole sectors go from the disk to the frame with no copy in
+/// between (cf. `OpenFile::ReadAt`), which is every sector when the buffer
+/// and the file position are aligned alike, as pages and sectors have the
+/// same size.
+int ReadFileToUser(OpenFile *file, int userAddress, unsigned byteCount)
+{
+    ASSERT(file != nullptr);
+    ASSERT(userAddress != 0);
+
+    char *mainMemory = machine->GetMMU()->mainMemory;
+    unsigned total = 0;
+    while (total < byteCount) {
+        unsigned address = userAddress + total;
+        unsigned count = PAGE_SIZE - address % PAGE_SIZE;
+        if (count > byteCount - total)
+            count = byteCount - total;
+
+        unsigned frame = PinUserPage(address);
+        int numRead = file->Read(
+            &mainMemory[frame * PAGE_SIZE + address % PAGE_SIZE], count);
+        coreMap.Unpin(frame);
+
+        if (numRead > 0)
+            total += numRead;
+        if (numRead < (int) count)
+            break;  // End of file.
+    }
+    return total;
+}
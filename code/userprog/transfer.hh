@@ -22,5 +22,11 @@ void WriteBufferToUser(const char *buffer, unsigned byteCount,
 /// Copy a C string from host to virtual machine.
 void WriteStringToUser(const char *string, int userAddress);
 
+class OpenFile;
+
+/// Read up to `byteCount` bytes of `file` straight into virtual machine
+/// memory, and return how many were read.
+int ReadFileToUser(OpenFile *file, int userAddress, unsigned byteCount);
+
 
 #endif
@@ -9,7 +9,9 @@ CoreMap::GetFrameToSwap()
     DEBUG('k', "GetFrameToSwap\n");
     while(true) {
         DEBUG('k', "\tEvaluating victim %d : [%d %d]\n", nextVictim, core[nextVictim].accessed, core[nextVictim].modified);
-        if (core[nextVictim].modified) {
+        if (core[nextVictim].pinned) {
+            nextVictim = (nextVictim + 1) % NUM_PHYS_PAGES;
+        } else if (core[nextVictim].modified) {
             core[nextVictim].modified = false;
             nextVictim = (nextVictim + 1) % NUM_PHYS_PAGES;
         } else if (core[nextVictim].accessed) {
@@ -96,4 +98,20 @@ CoreMap::MarkModified(unsigned pfn)
     ASSERT(0 <= pfn && pfn < NUM_PHYS_PAGES);
     core[pfn].accessed = true;
     core[pfn].modified = true;
+}
+
+void
+CoreMap::Pin(unsigned pfn)
+{
+    ASSERT(0 <= pfn && pfn < NUM_PHYS_PAGES);
+    ASSERT(!core[pfn].pinned);
+    core[pfn].pinned = true;
+}
+
+void
+CoreMap::Unpin(unsigned pfn)
+{
+    ASSERT(0 <= pfn && pfn < NUM_PHYS_PAGES);
+    ASSERT(core[pfn].pinned);
+    core[pfn].pinned = false;
 }
\ No newline at end of file
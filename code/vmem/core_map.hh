@@ -9,6 +9,7 @@ struct CoreEntry {
     SpaceId id = -1;
     bool accessed = false;
     bool modified = false;
+    bool pinned = false;  ///< Is the kernel doing I/O on the frame?
 };
 
 class CoreMap {
@@ -26,6 +27,10 @@ public:
     void MarkAccessed(unsigned pfn);
 
     void MarkModified(unsigned pfn);
+    /// Keep frame `pfn` from being evicted, while the kernel transfers
+    /// data to it directly.
+    void Pin(unsigned pfn);
+    void Unpin(unsigned pfn);
 private:
     CoreEntry core[NUM_PHYS_PAGES];
     unsigned nextVictim = 0;